@@ -0,0 +1,481 @@
+//
+// Benchmark suite for GBLator.
+//
+// Microbenchmarks time single operations of one component (opcode
+// dispatch, memory accesses per region, bank switching, PPU and timer
+// steps, tile decoding, save states); macrobenchmarks time whole frames
+// of the synthetic ROMs from utils/rom_builder.h. Each benchmark is
+// calibrated to run for at least the minimum sample time, then sampled
+// repeatedly, and the median and 95th percentile of the time per
+// operation are written as JSON so results can be tracked per commit.
+// The harness has no dependencies beyond the emulator library.
+//
+// With --compare BASELINE the suite is rerun and every benchmark is
+// checked against the samples stored in an earlier JSON result. A
+// benchmark regresses when its median time per operation grew by more
+// than --threshold percent and a one-sided Mann-Whitney U test says the
+// slowdown is unlikely to be noise (p below --alpha). The exit status is
+// 2 if any benchmark regressed, so the run can gate a merge.
+
+#include "core/core.h"
+#include "cpu/cpu.h"
+#include "mmu/memory.h"
+#include "ppu/ppu.h"
+#include "utils/rom_builder.h"
+#include "utils/sample_stats.h"
+#include "utils/timer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace gblator;
+
+namespace {
+
+// Results are folded into this so the optimiser cannot drop the work
+volatile uint64_t sink;
+
+/**
+ * A benchmark body runs a number of operations and returns a value
+ * derived from them. Fixtures are captured by the closure and persist
+ * across calls.
+ */
+using Body = std::function<uint64_t(uint64_t operations)>;
+
+struct Benchmark {
+    std::string name;
+    const char* kind; ///< "micro" or "macro"
+    Body body;
+};
+
+struct Result {
+    std::string name;
+    const char* kind;
+    uint64_t operations;         ///< Operations per sample
+    std::vector<double> nsPerOp; ///< One entry per sample
+    double median;
+    double p95;
+};
+
+struct Options {
+    int repetitions = 10;
+    int minTimeMs = 20;
+    std::string filter;
+    std::string outPath;
+    std::string romDirectory;
+    std::string baselinePath;
+    double thresholdPercent = 5.0;
+    double alpha = 0.01;
+    bool list = false;
+};
+
+/** Samples of one benchmark read back from a stored result. */
+struct Baseline {
+    std::string name;
+    std::vector<double> nsPerOp;
+};
+
+// ---------------------------------------------------------------------
+// Benchmarks
+// ---------------------------------------------------------------------
+
+// Memory with an MBC1 cartridge (8 ROM banks, 32 KiB RAM) loaded and its RAM enabled
+std::shared_ptr<Memory> cartridgeMemory() {
+    auto memory = std::make_shared<Memory>();
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::BankSwitchStorm);
+    memory->loadROM(rom.data(), rom.size());
+    memory->writeByte(0x0000, 0x0A);
+    return memory;
+}
+
+void addMemoryBenchmarks(std::vector<Benchmark>& benchmarks) {
+    struct Region {
+        const char* name;
+        uint16_t base;
+        uint16_t size;
+        bool writable;
+    };
+    const Region regions[] = {
+        {"rom0", 0x0000, 0x4000, false}, {"romx", 0x4000, 0x4000, false},
+        {"vram", 0x8000, 0x2000, true},  {"eram", 0xA000, 0x2000, true},
+        {"wram", 0xC000, 0x2000, true},  {"oam", 0xFE00, 0xA0, true},
+        {"io", 0xFF00, 0x80, false},     {"hram", 0xFF80, 0x7F, true},
+    };
+    for (const Region& region : regions) {
+        auto memory = cartridgeMemory();
+        benchmarks.push_back({std::string("memory_read_") + region.name, "micro",
+                              [memory, region](uint64_t operations) {
+                                  uint64_t sum = 0;
+                                  for (uint64_t i = 0; i < operations; ++i) {
+                                      sum += memory->readByte(static_cast<uint16_t>(region.base + i % region.size));
+                                  }
+                                  return sum;
+                              }});
+        if (!region.writable) {
+            continue;
+        }
+        benchmarks.push_back({std::string("memory_write_") + region.name, "micro",
+                              [memory, region](uint64_t operations) {
+                                  for (uint64_t i = 0; i < operations; ++i) {
+                                      memory->writeByte(static_cast<uint16_t>(region.base + i % region.size),
+                                                        static_cast<uint8_t>(i));
+                                  }
+                                  return static_cast<uint64_t>(memory->readByte(region.base));
+                              }});
+    }
+    auto memory = cartridgeMemory();
+    benchmarks.push_back({"bank_switch", "micro", [memory](uint64_t operations) {
+                              uint64_t sum = 0;
+                              for (uint64_t i = 0; i < operations; ++i) {
+                                  // Select banks 1-7 in turn and read from the new bank
+                                  memory->writeByte(0x2000, static_cast<uint8_t>(1 + i % 7));
+                                  sum += memory->readByte(0x4000);
+                              }
+                              return sum;
+                          }});
+}
+
+void addComponentBenchmarks(std::vector<Benchmark>& benchmarks) {
+    {
+        // CPU and Memory only, no other component is stepped
+        struct Fixture {
+            Memory memory;
+            CPU cpu{memory};
+        };
+        auto fixture = std::make_shared<Fixture>();
+        std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::AluLoop);
+        fixture->memory.loadROM(rom.data(), rom.size());
+        fixture->cpu.reset();
+        benchmarks.push_back({"opcode_dispatch", "micro", [fixture](uint64_t operations) {
+                                  uint64_t cycles = 0;
+                                  for (uint64_t i = 0; i < operations; ++i) {
+                                      cycles += static_cast<uint64_t>(fixture->cpu.step());
+                                  }
+                                  return cycles;
+                              }});
+    }
+    {
+        struct Fixture {
+            Memory memory;
+            PPU ppu{memory};
+        };
+        auto fixture = std::make_shared<Fixture>();
+        std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::AluLoop);
+        fixture->memory.loadROM(rom.data(), rom.size());
+        fixture->ppu.reset();
+        // LCD and background on, background tiles with every colour
+        fixture->memory.writeByte(0xFF40, 0x91);
+        fixture->memory.writeByte(0xFF47, 0xE4);
+        for (uint16_t address = 0x8000; address < 0x9000; ++address) {
+            fixture->memory.writeByte(address, static_cast<uint8_t>(address * 37));
+        }
+        for (uint16_t address = 0x9800; address < 0x9C00; ++address) {
+            fixture->memory.writeByte(address, static_cast<uint8_t>(address));
+        }
+        benchmarks.push_back({"ppu_step", "micro", [fixture](uint64_t operations) {
+                                  // One machine cycle per step, as in the emulation loop
+                                  for (uint64_t i = 0; i < operations; ++i) {
+                                      fixture->ppu.step(1);
+                                  }
+                                  return fixture->ppu.frameCount();
+                              }});
+        benchmarks.push_back({"tile_decode_line", "micro", [fixture](uint64_t operations) {
+                                  // One whole scanline (456 dots) per step: decodes 160 background pixels
+                                  for (uint64_t i = 0; i < operations; ++i) {
+                                      fixture->ppu.step(114);
+                                  }
+                                  return static_cast<uint64_t>(fixture->ppu.frameBuffer()[0]);
+                              }});
+    }
+    {
+        struct Fixture {
+            Memory memory;
+            Timer timer{memory};
+        };
+        auto fixture = std::make_shared<Fixture>();
+        fixture->timer.reset();
+        fixture->memory.writeByte(0xFF07, 0x05); // Enabled, 262144 Hz
+        benchmarks.push_back({"timer_step", "micro", [fixture](uint64_t operations) {
+                                  for (uint64_t i = 0; i < operations; ++i) {
+                                      fixture->timer.step(4);
+                                  }
+                                  return static_cast<uint64_t>(fixture->memory.readByte(0xFF05));
+                              }});
+    }
+    {
+        auto gb = std::make_shared<GameBoy>();
+        std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::BankSwitchStorm);
+        gb->loadROM(rom.data(), rom.size());
+        auto state = std::make_shared<std::vector<uint8_t>>(gb->stateSize());
+        benchmarks.push_back({"save_state", "micro", [gb, state](uint64_t operations) {
+                                  uint64_t ok = 0;
+                                  for (uint64_t i = 0; i < operations; ++i) {
+                                      ok += gb->saveState(state->data(), state->size()) ? 1 : 0;
+                                  }
+                                  return ok;
+                              }});
+        benchmarks.push_back({"load_state", "micro", [gb, state](uint64_t operations) {
+                                  gb->saveState(state->data(), state->size());
+                                  uint64_t ok = 0;
+                                  for (uint64_t i = 0; i < operations; ++i) {
+                                      ok += gb->loadState(state->data(), state->size()) ? 1 : 0;
+                                  }
+                                  return ok;
+                              }});
+    }
+}
+
+void addFrameBenchmarks(std::vector<Benchmark>& benchmarks) {
+    for (int i = 0; i < static_cast<int>(SyntheticWorkload::Count); ++i) {
+        SyntheticWorkload workload = static_cast<SyntheticWorkload>(i);
+        auto gb = std::make_shared<GameBoy>();
+        std::vector<uint8_t> rom = makeSyntheticROM(workload);
+        gb->loadROM(rom.data(), rom.size());
+        benchmarks.push_back({std::string("frames_") + syntheticWorkloadName(workload), "macro",
+                              [gb](uint64_t operations) {
+                                  for (uint64_t i = 0; i < operations; ++i) {
+                                      gb->runFrame();
+                                  }
+                                  return gb->counters().frames;
+                              }});
+    }
+}
+
+// Write every synthetic ROM as DIR/<name>.gb, for running them elsewhere
+bool writeROMs(const std::string& directory) {
+    for (int i = 0; i < static_cast<int>(SyntheticWorkload::Count); ++i) {
+        SyntheticWorkload workload = static_cast<SyntheticWorkload>(i);
+        std::vector<uint8_t> rom = makeSyntheticROM(workload);
+        std::string path = directory + "/" + syntheticWorkloadName(workload) + ".gb";
+        std::ofstream file(path, std::ios::binary);
+        if (!file.write(reinterpret_cast<const char*>(rom.data()), static_cast<std::streamsize>(rom.size()))) {
+            std::cerr << "Failed to write " << path << "\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+// Harness
+// ---------------------------------------------------------------------
+
+double runSample(const Benchmark& benchmark, uint64_t operations) {
+    auto start = std::chrono::steady_clock::now();
+    sink = sink + benchmark.body(operations);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+Result measure(const Benchmark& benchmark, const Options& options) {
+    // Double the operation count until one sample takes the minimum time;
+    // this also warms up caches and the fixture
+    const double minNs = options.minTimeMs * 1e6;
+    uint64_t operations = 1;
+    double ns = runSample(benchmark, operations);
+    while (ns < minNs && operations < (uint64_t(1) << 40)) {
+        // Aim slightly past the minimum to avoid another doubling round
+        double scale = ns > 0 ? std::min(minNs * 1.2 / ns, 100.0) : 100.0;
+        operations = std::max(operations * 2, static_cast<uint64_t>(static_cast<double>(operations) * scale));
+        ns = runSample(benchmark, operations);
+    }
+    Result result{benchmark.name, benchmark.kind, operations, {}, 0, 0};
+    for (int i = 0; i < options.repetitions; ++i) {
+        result.nsPerOp.push_back(runSample(benchmark, operations) / static_cast<double>(operations));
+    }
+    std::vector<double> sorted = result.nsPerOp;
+    std::sort(sorted.begin(), sorted.end());
+    result.median = nearestRankPercentile(sorted, 0.5);
+    result.p95 = nearestRankPercentile(sorted, 0.95);
+    return result;
+}
+
+void writeJson(const std::vector<Result>& results, const Options& options, std::ostream& out) {
+    out << "{\n  \"repetitions\": " << options.repetitions << ",\n  \"min_time_ms\": " << options.minTimeMs
+        << ",\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << r.name << "\", \"kind\": \"" << r.kind
+            << "\", \"operations\": " << r.operations << ", \"ns_per_op_median\": " << r.median
+            << ", \"ns_per_op_p95\": " << r.p95 << ", \"ops_per_sec_median\": " << 1e9 / r.median
+            << ", \"samples\": [";
+        for (size_t j = 0; j < r.nsPerOp.size(); ++j) {
+            out << (j == 0 ? "" : ", ") << r.nsPerOp[j];
+        }
+        out << "]}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+// ---------------------------------------------------------------------
+// Baseline comparison
+// ---------------------------------------------------------------------
+
+// Read the name and samples of every benchmark from JSON written by
+// writeJson(); other fields and formatting are ignored
+bool readBaseline(const std::string& path, std::vector<Baseline>& baselines) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const std::string nameKey = "\"name\": \"";
+    const std::string samplesKey = "\"samples\": [";
+    size_t pos = 0;
+    while ((pos = text.find(nameKey, pos)) != std::string::npos) {
+        pos += nameKey.size();
+        size_t end = text.find('"', pos);
+        size_t samples = text.find(samplesKey, pos);
+        if (end == std::string::npos || samples == std::string::npos) {
+            return false;
+        }
+        Baseline baseline;
+        baseline.name = text.substr(pos, end - pos);
+        const char* cursor = text.c_str() + samples + samplesKey.size();
+        for (;;) {
+            while (*cursor == ' ' || *cursor == ',' || *cursor == '\n') {
+                ++cursor;
+            }
+            if (*cursor == ']' || *cursor == '\0') {
+                break;
+            }
+            char* next = nullptr;
+            double value = std::strtod(cursor, &next);
+            if (next == cursor) {
+                return false;
+            }
+            baseline.nsPerOp.push_back(value);
+            cursor = next;
+        }
+        if (!baseline.nsPerOp.empty()) {
+            baselines.push_back(std::move(baseline));
+        }
+        pos = static_cast<size_t>(cursor - text.c_str());
+    }
+    return !baselines.empty();
+}
+
+// Compare every result that has a baseline and print one line per
+// benchmark; returns the number of regressions
+int compareResults(const std::vector<Result>& results, const std::vector<Baseline>& baselines,
+                   const Options& options, std::ostream& out) {
+    int regressions = 0;
+    for (const Result& result : results) {
+        auto it = std::find_if(baselines.begin(), baselines.end(),
+                               [&](const Baseline& b) { return b.name == result.name; });
+        if (it == baselines.end()) {
+            out << result.name << ": no baseline\n";
+            continue;
+        }
+        SampleComparison c = compareSamples(it->nsPerOp, result.nsPerOp, options.thresholdPercent, options.alpha);
+        if (c.verdict == SampleVerdict::Regression) {
+            ++regressions;
+        }
+        out << result.name << ": " << c.baselineMedian << " -> " << c.currentMedian << " ns/op ("
+            << (c.changePercent >= 0 ? "+" : "") << c.changePercent << "%, p=" << c.pValue << ") "
+            << sampleVerdictName(c.verdict) << "\n";
+    }
+    out << regressions << " regression(s) beyond " << options.thresholdPercent << "% at alpha "
+        << options.alpha << "\n";
+    return regressions;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " [--filter SUBSTRING] [--repetitions N] [--min-time-ms N]\n"
+              << "           [--out FILE] [--list] [--write-roms DIR]\n"
+              << "           [--compare BASELINE] [--threshold PERCENT] [--alpha P]\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--filter") == 0 && hasValue) {
+            options.filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--repetitions") == 0 && hasValue) {
+            options.repetitions = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--min-time-ms") == 0 && hasValue) {
+            options.minTimeMs = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--out") == 0 && hasValue) {
+            options.outPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--write-roms") == 0 && hasValue) {
+            options.romDirectory = argv[++i];
+        } else if (std::strcmp(argv[i], "--compare") == 0 && hasValue) {
+            options.baselinePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--threshold") == 0 && hasValue) {
+            options.thresholdPercent = std::max(0.0, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--alpha") == 0 && hasValue) {
+            options.alpha = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--list") == 0) {
+            options.list = true;
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!options.romDirectory.empty()) {
+        return writeROMs(options.romDirectory) ? 0 : 1;
+    }
+
+    std::vector<Baseline> baselines;
+    if (!options.baselinePath.empty() && !readBaseline(options.baselinePath, baselines)) {
+        std::cerr << "Failed to read baseline " << options.baselinePath << "\n";
+        return 1;
+    }
+
+    std::vector<Benchmark> benchmarks;
+    addComponentBenchmarks(benchmarks);
+    addMemoryBenchmarks(benchmarks);
+    addFrameBenchmarks(benchmarks);
+
+    std::vector<Result> results;
+    for (const Benchmark& benchmark : benchmarks) {
+        if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        if (options.list) {
+            std::cout << benchmark.name << " (" << benchmark.kind << ")\n";
+            continue;
+        }
+        results.push_back(measure(benchmark, options));
+        // Progress goes to stderr so stdout stays valid JSON
+        std::cerr << benchmark.name << ": " << results.back().median << " ns/op (p95 "
+                  << results.back().p95 << ")\n";
+    }
+    if (options.list) {
+        return 0;
+    }
+    if (!options.baselinePath.empty()) {
+        // The comparison goes to stdout; the new results only to --out
+        int regressions = compareResults(results, baselines, options, std::cout);
+        if (!options.outPath.empty()) {
+            std::ofstream out(options.outPath);
+            writeJson(results, options, out);
+        }
+        return regressions > 0 ? 2 : 0;
+    }
+    if (options.outPath.empty()) {
+        writeJson(results, options, std::cout);
+    } else {
+        std::ofstream out(options.outPath);
+        if (!out.is_open()) {
+            std::cerr << "Failed to write " << options.outPath << "\n";
+            return 1;
+        }
+        writeJson(results, options, out);
+    }
+    return 0;
+}
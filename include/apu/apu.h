@@ -4,34 +4,64 @@
 // This header declares a minimal Audio Processing Unit (APU) stub. The
 // Game Boy APU is complex, featuring four channels and many registers.
 // This implementation merely stores the audio registers and provides a
-// step function placeholder. Full sound emulation is beyond the scope
-// of this skeleton.
+// step function placeholder that produces silent samples at the output
+// rate. Full sound emulation is beyond the scope of this skeleton.
 
 #ifndef GBLATOR_APU_H
 #define GBLATOR_APU_H
 
+#include <cstddef>
 #include <cstdint>
 
 namespace gblator {
 
 class Memory;
+class StateWriter;
+class StateReader;
 
 /**
  * @brief Minimal stub for the Game Boy’s audio hardware.
  *
- * The APU class stores the audio register values and updates nothing
- * else. Real audio generation would require mixing channel outputs and
- * producing PCM samples, which is out of scope for this demonstration.
+ * The APU class stores the audio register values and emits samples into
+ * an output buffer at a fixed rate. Real audio generation would require
+ * mixing channel outputs, which is out of scope for this demonstration,
+ * so the samples are silent; the buffer exists so that front ends can
+ * consume audio through a stable interface.
  */
 class APU {
 public:
+    /** Output sample rate: one stereo sample every 32 CPU cycles. */
+    static constexpr int kSampleRate = 32768;
+    /** Capacity of the sample buffer in stereo samples (about 7 frames). */
+    static constexpr size_t kMaxSamples = 4096;
+
     explicit APU(Memory& memory);
     /** Reset audio registers and state. */
     void reset();
     /** Step the APU by the given number of CPU cycles. */
     void step(int cycles);
+    /** Number of CPU cycles until the next output sample. */
+    int cyclesUntilNextSample() const;
+    /**
+     * Samples produced since the last clearSamples(), as interleaved
+     * signed 16-bit stereo (left, right). Samples beyond kMaxSamples are
+     * dropped until the buffer is cleared.
+     */
+    const int16_t* samples() const;
+    /** Number of stereo samples available in samples(). */
+    size_t sampleCount() const;
+    /** Discard buffered samples. */
+    void clearSamples();
+
+    /** Serialise the sample clock. Buffered samples are not included. */
+    void saveState(StateWriter& writer) const;
+    /** Restore state written by saveState(). */
+    void loadState(StateReader& reader);
 private:
     Memory& memory_;
+    int sampleCounter_;   ///< CPU cycles accumulated towards the next sample
+    size_t sampleCount_;  ///< Stereo samples currently buffered
+    int16_t samples_[kMaxSamples * 2]; ///< Interleaved stereo output buffer
 };
 
 } // namespace gblator
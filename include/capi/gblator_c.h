@@ -0,0 +1,191 @@
+/*
+ * Part of the GBLator project.
+ *
+ * This header declares the stable C interface of the emulator, built as
+ * the gblator_c shared library. It is meant for foreign-function bindings
+ * (Python ctypes, Rust FFI, ...) and uses only C types. Buffers are never
+ * copied across the boundary: the framebuffer, audio and RAM accessors
+ * return pointers into the emulator itself, which stay valid until the
+ * next call that steps, resets or loads into the same instance. Save
+ * states are written to and read from caller-owned memory.
+ */
+
+#ifndef GBLATOR_C_H
+#define GBLATOR_C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(GBLATOR_C_EXPORTS)
+#    define GBLATOR_C_API __declspec(dllexport)
+#  else
+#    define GBLATOR_C_API __declspec(dllimport)
+#  endif
+#else
+#  define GBLATOR_C_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Version of this interface; bumped on any incompatible change. */
+#define GBLATOR_C_API_VERSION 1
+
+/** Screen dimensions of the framebuffer. */
+#define GBLATOR_SCREEN_WIDTH 160
+#define GBLATOR_SCREEN_HEIGHT 144
+
+/** Button bits for gblator_set_input(). */
+enum {
+    GBLATOR_BUTTON_RIGHT = 1 << 0,
+    GBLATOR_BUTTON_LEFT = 1 << 1,
+    GBLATOR_BUTTON_UP = 1 << 2,
+    GBLATOR_BUTTON_DOWN = 1 << 3,
+    GBLATOR_BUTTON_A = 1 << 4,
+    GBLATOR_BUTTON_B = 1 << 5,
+    GBLATOR_BUTTON_SELECT = 1 << 6,
+    GBLATOR_BUTTON_START = 1 << 7
+};
+
+/** RAM regions for gblator_memory_region(). */
+enum {
+    GBLATOR_REGION_VRAM0 = 0,
+    GBLATOR_REGION_VRAM1 = 1,
+    GBLATOR_REGION_WRAM = 2,
+    GBLATOR_REGION_ERAM = 3,
+    GBLATOR_REGION_OAM = 4,
+    GBLATOR_REGION_IO = 5,
+    GBLATOR_REGION_HRAM = 6
+};
+
+/** Text formats for gblator_counters_text(). */
+enum {
+    GBLATOR_COUNTERS_JSON = 0,
+    GBLATOR_COUNTERS_PROMETHEUS = 1
+};
+
+/**
+ * Performance counters; see gblator::PerfCounters for the meaning of each
+ * field. Host hardware counters are only included in gblator_counters_text().
+ */
+typedef struct gblator_counters {
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t frames;
+    uint64_t interrupts;
+    uint64_t bank_switches;
+    uint64_t dma_transfers;
+    uint64_t halted_cycles;
+    uint64_t idle_skip_cycles;
+    uint64_t block_cache_hits;
+    uint64_t block_cache_misses;
+    uint64_t host_ns_last_frame;
+    uint64_t host_ns_total;
+} gblator_counters;
+
+/** Opaque emulator instance. */
+typedef struct gblator_instance gblator_instance;
+
+/** Return GBLATOR_C_API_VERSION of the loaded library. */
+GBLATOR_C_API uint32_t gblator_api_version(void);
+
+/** Create an instance with no ROM loaded. Returns NULL on failure. */
+GBLATOR_C_API gblator_instance* gblator_create(void);
+
+/** Destroy an instance. Passing NULL is allowed. */
+GBLATOR_C_API void gblator_destroy(gblator_instance* gb);
+
+/**
+ * Load a ROM image from memory (the image is copied) and reset.
+ * Returns non-zero on success.
+ */
+GBLATOR_C_API int gblator_load_rom(gblator_instance* gb, const uint8_t* data, size_t size);
+
+/**
+ * Load a ROM image from memory without copying it and reset. The image
+ * must stay valid and unchanged until the instance is destroyed or
+ * another ROM is loaded; many instances may share it.
+ * Returns non-zero on success.
+ */
+GBLATOR_C_API int gblator_load_rom_borrowed(gblator_instance* gb, const uint8_t* data, size_t size);
+
+/**
+ * Load a ROM image from an open file descriptor (file, pipe or socket)
+ * and reset. The descriptor is not closed. Returns non-zero on success;
+ * always fails on platforms without POSIX I/O.
+ */
+GBLATOR_C_API int gblator_load_rom_fd(gblator_instance* gb, int fd);
+
+/** Reset the machine to its post-boot state. */
+GBLATOR_C_API void gblator_reset(gblator_instance* gb);
+
+/**
+ * Run the given number of frames. The audio buffer is cleared first and
+ * then holds the samples of all frames run (up to its capacity).
+ */
+GBLATOR_C_API void gblator_step_frames(gblator_instance* gb, int frames);
+
+/** Set the pressed buttons as a mask of GBLATOR_BUTTON_* bits. */
+GBLATOR_C_API void gblator_set_input(gblator_instance* gb, uint8_t buttons);
+
+/** Size in bytes of a save state for the loaded ROM. */
+GBLATOR_C_API size_t gblator_state_size(const gblator_instance* gb);
+
+/**
+ * Save the machine state into caller memory of at least
+ * gblator_state_size() bytes. Returns non-zero on success.
+ */
+GBLATOR_C_API int gblator_save_state(const gblator_instance* gb, void* dst, size_t size);
+
+/**
+ * Restore a state saved from an instance running the same ROM.
+ * Returns non-zero on success; the instance is unchanged on failure.
+ */
+GBLATOR_C_API int gblator_load_state(gblator_instance* gb, const void* src, size_t size);
+
+/**
+ * Last completed frame: GBLATOR_SCREEN_WIDTH x GBLATOR_SCREEN_HEIGHT
+ * bytes, row-major, DMG shades 0 (white) to 3 (black).
+ */
+GBLATOR_C_API const uint8_t* gblator_framebuffer(const gblator_instance* gb);
+
+/**
+ * Audio produced by the last gblator_step_frames() call as interleaved
+ * signed 16-bit stereo at *sample_rate Hz. *samples receives the number
+ * of stereo samples. Either output pointer may be NULL.
+ */
+GBLATOR_C_API const int16_t* gblator_audio_buffer(const gblator_instance* gb, size_t* samples,
+                                                  int* sample_rate);
+
+/**
+ * Direct access to a RAM region (GBLATOR_REGION_*). *size receives its
+ * length in bytes. Writes through the pointer modify emulated memory.
+ * Returns NULL for an unknown or empty region.
+ */
+GBLATOR_C_API uint8_t* gblator_memory_region(gblator_instance* gb, int region, size_t* size);
+
+/** Copy the instance's performance counters into *counters. */
+GBLATOR_C_API void gblator_get_counters(const gblator_instance* gb, gblator_counters* counters);
+
+/**
+ * Sample host hardware counters (cycles, instructions, branch and cache
+ * misses) around every frame stepped from now on, on the calling thread.
+ * Returns non-zero if the host permits at least one of them.
+ */
+GBLATOR_C_API int gblator_enable_hw_counters(gblator_instance* gb);
+
+/**
+ * Render the performance counters as text (GBLATOR_COUNTERS_*) into
+ * buf, NUL-terminated and truncated to size bytes. Returns the length of
+ * the full text, excluding the terminator, or 0 (with buf emptied) if the
+ * text could not be built.
+ */
+GBLATOR_C_API size_t gblator_counters_text(const gblator_instance* gb, int format, char* buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GBLATOR_C_H */
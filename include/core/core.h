@@ -3,39 +3,83 @@
 //
 // This header declares a GameBoy class that ties together the CPU,
 // memory, PPU, timer, APU, and joypad. It provides a simple run loop
-// for emulation.
+// for emulation, a frame-based loop, and optional real-time pacing.
 
 #ifndef GBLATOR_CORE_H
 #define GBLATOR_CORE_H
 
+#include "apu/apu.h"
+#include "core/perf_counters.h"
+#include "utils/hw_counters.h"
+#include "cpu/cpu.h"
+#include "joypad/joypad.h"
+#include "mmu/memory.h"
+#include "ppu/ppu.h"
+#include "sched/cycle_scheduler.h"
+#include "serial/serial.h"
+#include "utils/timer.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
 #include <string>
+#include <vector>
 
 namespace gblator {
 
-class Memory;
-class CPU;
-class PPU;
-class Timer;
-class APU;
-class Joypad;
+class StateWriter;
+struct StateSection;
+class GuestTrace;
+class InputLatency;
 
 /**
  * @brief Represents an instance of the Game Boy console.
  *
  * This class owns the major subsystems and provides methods to load
- * a ROM and execute it, stepping all components in sync.
+ * a ROM and execute it, stepping all components in sync. The components
+ * are held by value so a machine is one contiguous object (apart from
+ * the ROM image and cartridge RAM), which lets InstancePool place it.
  */
 class GameBoy {
 public:
+    /** Machine cycles in one video frame (154 lines of 456 dots, 4 dots per cycle). */
+    static constexpr int kCyclesPerFrame = 17556;
+    /** Machine cycles per second (4.194304 MHz clock / 4). */
+    static constexpr int64_t kCyclesPerSecond = 1048576;
+
     GameBoy();
     ~GameBoy();
 
+    GameBoy(const GameBoy&) = delete;
+    GameBoy& operator=(const GameBoy&) = delete;
+
     /**
      * Load a ROM into memory.
      * @param filepath Path to the ROM file
      * @return true on success
      */
     bool loadROM(const std::string& filepath);
+    /**
+     * Load a ROM image from memory (the image is copied).
+     * @param data Pointer to the ROM image
+     * @param size Size of the image in bytes
+     * @return true on success
+     */
+    bool loadROM(const uint8_t* data, size_t size);
+    /**
+     * Load a ROM image from memory, copying or borrowing it.
+     * A borrowed image must outlive the instance (or the next load).
+     * @param rom The ROM image
+     * @param ownership Whether to copy or borrow the image
+     * @return true on success
+     */
+    bool loadROM(std::span<const uint8_t> rom, RomOwnership ownership = RomOwnership::Copy);
+    /**
+     * Load a ROM image from an open file descriptor, which stays open.
+     * @param fd Readable file, pipe or socket descriptor
+     * @return true on success
+     */
+    bool loadROMFromFd(int fd);
     /** Reset all components to initial state. */
     void reset();
     /**
@@ -44,6 +88,91 @@ public:
      * @param instructionCount Number of instructions to execute
      */
     void run(int instructionCount);
+    /**
+     * Run the emulator until one full video frame worth of cycles has
+     * elapsed.
+     *
+     * While the CPU is halted with no interrupt pending, the components
+     * are advanced straight to the next scheduled event (VBlank, timer
+     * overflow, serial transfer completion or the end of the frame)
+     * instead of one idle cycle at a time. In real-time mode the host
+     * thread sleeps until the wall-clock deadline of that event, and
+     * again until the frame deadline.
+     */
+    void runFrame();
+    /**
+     * Run the current frame up to the given machine cycle of the frame
+     * (clamped to kCyclesPerFrame) without completing it; the last
+     * instruction may overshoot by a few cycles. A later runFrame()
+     * finishes the frame. Used to advance linked instances in slices.
+     *
+     * @param frameCycle Machine cycle of the frame to run to
+     */
+    void runFrameUntil(int frameCycle);
+    /** Machine cycles elapsed in the current frame. */
+    int frameCycle() const;
+    /**
+     * Enable or disable real-time pacing of runFrame() to the Game Boy
+     * frame rate (about 59.73 Hz). Enabling restarts the frame clock.
+     */
+    void setRealTime(bool enabled);
+    bool realTime() const;
+    /**
+     * Select how guest code is executed from the next instruction on.
+     * The machine state does not depend on the engine.
+     * @return false if the engine is not available in this build
+     */
+    bool setEngine(CpuEngine engine);
+    CpuEngine engine() const;
+    /** Total machine cycles skipped while the CPU was halted. */
+    uint64_t idleCycles() const;
+    /** Gather the performance counters of this instance. */
+    PerfCounters counters() const;
+    /**
+     * Measure host hardware counters around every runFrame() from now on.
+     * The counters follow the calling thread, which should be the one
+     * running the frames.
+     * @return false if the host allows none of the events
+     */
+    bool enableHardwareCounters();
+    /** Stop measuring host hardware counters; totals are kept. */
+    void disableHardwareCounters();
+    /** Host hardware counters sampled so far. */
+    const HardwareCounters& hardwareCounters() const;
+    /**
+     * Attach a guest event timeline to every component (nullptr
+     * detaches). The trace is not owned and must outlive the attachment.
+     */
+    void setTrace(GuestTrace* trace);
+    /**
+     * Attach an input latency probe to the Joypad, memory and PPU (nullptr
+     * detaches). The probe is not owned and must outlive the attachment.
+     */
+    void setLatencyProbe(InputLatency* probe);
+    /** Size in bytes of a save state for the loaded cartridge. */
+    size_t stateSize() const;
+    /**
+     * Parts of a save state for the loaded cartridge, in order: the
+     * header, every memory region (banked ones per bank), the banking
+     * registers and each component's internals.
+     */
+    std::vector<StateSection> stateLayout() const;
+    /**
+     * Save the complete machine state (everything except ROM) into a
+     * caller-provided buffer. Does not allocate.
+     * @param data Destination buffer
+     * @param size Size of the buffer; must be at least stateSize()
+     * @return true on success
+     */
+    bool saveState(uint8_t* data, size_t size) const;
+    /**
+     * Restore a state produced by saveState() for the same cartridge.
+     * The machine is left untouched if the state is rejected.
+     * @param data Source buffer
+     * @param size Size of the state in bytes
+     * @return true on success
+     */
+    bool loadState(const uint8_t* data, size_t size);
     /** Access underlying memory. */
     Memory& memory();
     CPU& cpu();
@@ -51,13 +180,58 @@ public:
     Timer& timer();
     APU& apu();
     Joypad& joypad();
+    Serial& serial();
 private:
-    Memory* memory_;
-    CPU* cpu_;
-    PPU* ppu_;
-    Timer* timer_;
-    APU* apu_;
-    Joypad* joypad_;
+    using Clock = std::chrono::steady_clock;
+
+    /** Write every component's state in a fixed order. */
+    void writeState(StateWriter& writer) const;
+
+    /** Execute one CPU step, counting its memory accesses in statistics builds. */
+    int stepCpu();
+    /**
+     * The batched engine: run instructions until the CPU halts or the frame
+     * reaches frameCycle, with the same component steps as tick() but
+     * without its trace, probe and idle checks or an idle serial port.
+     */
+    void runBatched(int frameCycle);
+    /**
+     * Advance the clock by the given machine cycles, resuming the PPU,
+     * timer and APU tasks that are due and stepping the serial port.
+     * With idle set (the CPU is halted) every task is resumed once over
+     * the whole stretch instead of at each of its register changes.
+     */
+    void tick(int cycles, bool idle = false);
+    /** Machine cycles until the next component may request an interrupt. */
+    int cyclesUntilNextEvent() const;
+    /**
+     * Run until frameCycles_ reaches the given cycle, skipping halted
+     * stretches and sleeping in real-time mode.
+     * @return Time spent sleeping
+     */
+    Clock::duration advanceTo(int frameCycle);
+    /** Wall-clock time at which the given cycle of the current frame is due. */
+    Clock::time_point deadlineFor(int frameCycle) const;
+
+    Memory memory_;              ///< Declared first: the other components hold a reference to it
+    CPU cpu_;
+    PPU ppu_;
+    Timer timer_;
+    APU apu_;
+    Joypad joypad_;
+    Serial serial_;
+    CycleScheduler scheduler_;   ///< Runs the PPU, timer and APU; declared after them so it is destroyed first
+
+    int frameCycles_;            ///< Machine cycles elapsed in the current frame
+    uint64_t idleCycles_;        ///< Machine cycles skipped while halted
+    uint64_t cycles_;            ///< Machine cycles emulated since construction
+    uint64_t frames_;            ///< Frames completed since construction
+    uint64_t hostNsLastFrame_;   ///< Host time of the last runFrame(), excluding sleeps
+    uint64_t hostNsTotal_;       ///< Host time of all runFrame() calls, excluding sleeps
+    HardwareCounters hwCounters_; ///< Host counters sampled around runFrame() while open
+    bool realTime_;              ///< Whether runFrame() is paced to wall-clock time
+    CpuEngine engine_;           ///< Engine executing guest code
+    Clock::time_point frameStart_; ///< Wall-clock start of the current frame
 };
 
 } // namespace gblator
@@ -0,0 +1,62 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the determinism audit. The same ROM and input
+// replay (one joypad button mask per frame, as used by the fork server)
+// run on two consoles in two threads. After every frame both threads save
+// their state and meet at a barrier, where the state hashes are compared.
+// At the first frame whose hashes differ both stop, and the two states
+// are kept and diffed region by region, so a desync is pinned to a
+// frame and to the addresses that diverged instead of being bisected.
+
+#ifndef GBLATOR_DETERMINISM_AUDIT_H
+#define GBLATOR_DETERMINISM_AUDIT_H
+
+#include "core/state.h"
+#include "core/state_diff.h"
+#include "cpu/cpu.h"
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+namespace gblator {
+
+class GameBoy;
+
+/** Options of a determinism audit. */
+struct AuditConfig {
+    int frames = 0;                                 ///< Frames to run; 0 runs one per input byte
+    CpuEngine firstEngine = CpuEngine::Interpreter;  ///< Engine of the first run
+    CpuEngine secondEngine = CpuEngine::Interpreter; ///< Engine of the second run, e.g. one being validated
+    /**
+     * Called on each run's thread before every frame with the run index
+     * (0 or 1) and the frame number, e.g. to attach observers that must
+     * not change the outcome. May be empty.
+     */
+    std::function<void(int run, GameBoy& gb, int frame)> beforeFrame;
+};
+
+/** Outcome of a determinism audit. */
+struct AuditResult {
+    bool ok = false;                 ///< Both consoles loaded the ROM and accepted their engines
+    int divergedFrame = -1;          ///< First frame (0-based) after which the states differ, or -1
+    int framesCompared = 0;          ///< Frames whose states were compared, including a diverged one
+    std::vector<uint64_t> hashes;    ///< State hash after each matching frame, for regression baselines
+    std::vector<StateSection> layout; ///< Layout of the states
+    std::vector<uint8_t> first;      ///< State of the first run at the divergence (empty if none)
+    std::vector<uint8_t> second;     ///< State of the second run at the divergence (empty if none)
+    StateDiff diff;                  ///< Difference of first and second
+};
+
+/**
+ * Run the replay twice in parallel and compare the states after every frame.
+ * @param rom Cartridge image, borrowed by both consoles for the audit
+ * @param inputs One button mask per frame; frames past the end press nothing
+ */
+AuditResult auditDeterminism(std::span<const uint8_t> rom, std::span<const uint8_t> inputs,
+                             const AuditConfig& config = AuditConfig());
+
+} // namespace gblator
+
+#endif // GBLATOR_DETERMINISM_AUDIT_H
@@ -0,0 +1,88 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the automatic choice of a CPU engine for a ROM.
+// Starting from a snapshot of a running console, every engine available
+// in the build warms up on a scratch instance and then runs the same
+// short stretch of frames, timed one by one. Engines whose final state
+// hash differs from the interpreter's are rejected, and the fastest of
+// the rest is selected. Choices are remembered per ROM hash and can be
+// kept in a small text file so later runs skip the trial. With a single
+// engine built in (statistics builds have only the interpreter) there is
+// nothing to compare and the interpreter is chosen without a trial.
+
+#ifndef GBLATOR_ENGINE_SELECT_H
+#define GBLATOR_ENGINE_SELECT_H
+
+#include "cpu/cpu.h"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gblator {
+
+class GameBoy;
+
+/** Result of running one engine from the snapshot. */
+struct EngineTrial {
+    CpuEngine engine = CpuEngine::Interpreter;
+    uint64_t bestFrameNs = 0;  ///< Fastest frame of the trial in host nanoseconds
+    uint64_t stateHash = 0;    ///< Hash of the save state after the trial
+    bool agrees = false;       ///< stateHash matches the interpreter's
+};
+
+/** Engine selected for a ROM and how it was found. */
+struct EngineChoice {
+    CpuEngine engine = CpuEngine::Interpreter;
+    uint64_t romHash = 0;
+    bool cached = false;               ///< Taken from the cache without a trial
+    std::vector<EngineTrial> trials;   ///< Empty when cached or only one engine is available
+};
+
+/**
+ * @brief Picks the fastest correct CPU engine for each ROM.
+ *
+ * The cache file has one line per ROM: the ROM hash in hexadecimal and the
+ * engine name. Lines naming engines missing from this build are ignored.
+ */
+class EngineSelector {
+public:
+    /** @param trialFrames Frames each engine is timed over, after its warm-up */
+    explicit EngineSelector(int trialFrames = 120);
+
+    /**
+     * Merge choices from a cache file into memory. A missing file is not
+     * an error.
+     * @return false if the file exists but cannot be parsed
+     */
+    bool loadCache(const std::string& path);
+    /**
+     * Write all remembered choices to a cache file.
+     * @return false if the file cannot be written
+     */
+    bool saveCache(const std::string& path) const;
+
+    /**
+     * Choose an engine for the ROM loaded in gb and apply it. Trials start
+     * from the current state of gb, which is left untouched apart from the
+     * engine.
+     */
+    EngineChoice select(GameBoy& gb);
+
+    /** Engines built into this binary, the interpreter first. */
+    static std::vector<CpuEngine> availableEngines();
+
+private:
+    /** Run one engine from the snapshot on a scratch instance. */
+    bool trial(std::span<const uint8_t> rom, const std::vector<uint8_t>& snapshot, CpuEngine engine,
+               EngineTrial& result) const;
+
+    int trialFrames_;
+    std::unordered_map<uint64_t, CpuEngine> cache_;  ///< ROM hash to chosen engine
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_ENGINE_SELECT_H
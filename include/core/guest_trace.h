@@ -0,0 +1,109 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the guest hardware event timeline. Unlike the host
+// profiler, it records what the emulated machine did and when, in machine
+// cycles: interrupts, PPU mode changes, LYC matches, timer overflows,
+// bank switches, OAM DMA, LCD power and writes to selected IO registers.
+// It is meant for tracking down timing regressions introduced by fast
+// paths, by comparing timelines with and without them.
+
+#ifndef GBLATOR_GUEST_TRACE_H
+#define GBLATOR_GUEST_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace gblator {
+
+/** Kinds of guest events; the value and address fields depend on the kind. */
+enum class GuestEvent : uint8_t {
+    InterruptRequested,  ///< value: interrupt bit (0 VBlank … 4 Joypad)
+    InterruptServiced,   ///< value: interrupt bit
+    PpuMode,             ///< value: new mode, address: LY
+    LycMatch,            ///< address: LY
+    TimerOverflow,       ///< value: TMA reloaded into TIMA
+    BankSwitch,          ///< value: new bank selection, address: register written
+    OamDma,              ///< address: source address
+    LcdOn,
+    LcdOff,
+    IoWrite,             ///< value: byte written, address: watched register
+    Count
+};
+
+/** Filter mask bit of an event kind. */
+constexpr uint32_t guestEventBit(GuestEvent event) {
+    return 1u << static_cast<unsigned>(event);
+}
+
+/** Filter mask selecting every event kind. */
+constexpr uint32_t kAllGuestEvents = (1u << static_cast<unsigned>(GuestEvent::Count)) - 1;
+
+/** One timeline entry, 16 bytes. */
+struct GuestEventRecord {
+    uint64_t cycle;     ///< Machine cycle at which the event was observed
+    GuestEvent type;
+    uint8_t value;
+    uint16_t address;
+    uint32_t reserved;
+};
+
+/**
+ * @brief Ring buffer of guest events for one GameBoy.
+ *
+ * Attach with GameBoy::setTrace(). Events filtered out by the mask cost
+ * one test; with no trace attached the components skip recording
+ * entirely. When the ring is full the oldest events are overwritten.
+ *
+ * CPU-side events carry the cycle at which the instruction started;
+ * events raised by the PPU and timer carry the cycle at the end of the
+ * step in which they were observed.
+ */
+class GuestTrace {
+public:
+    /** @param capacity Events kept before the oldest are overwritten */
+    explicit GuestTrace(size_t capacity = 1 << 16);
+
+    /** Select the recorded event kinds (guestEventBit() values). */
+    void setMask(uint32_t mask);
+    uint32_t mask() const;
+    /** Record (or stop recording) IoWrite events for an IO register FF00–FF7F. */
+    void watchRegister(uint16_t address, bool watch = true);
+
+    /** Set the machine cycle stamped on subsequent events. */
+    void setCycle(uint64_t cycle);
+    /** Record an event if its kind (and, for IoWrite, its register) is selected. */
+    void record(GuestEvent type, uint8_t value = 0, uint16_t address = 0);
+
+    /** Events currently held. */
+    size_t size() const;
+    /** Events overwritten because the ring was full. */
+    uint64_t dropped() const;
+    /** Event by age, 0 being the oldest held. */
+    const GuestEventRecord& at(size_t index) const;
+    /** Discard every event. */
+    void clear();
+
+    /**
+     * @brief Write the timeline as Chrome Trace Event JSON.
+     *
+     * The output loads in Perfetto and chrome://tracing. Machine cycles
+     * are converted to microseconds of emulated time, events are grouped
+     * into CPU, PPU, timer, interrupt and cartridge tracks, and the PPU
+     * mode is also emitted as a counter track.
+     */
+    void writePerfettoJson(std::ostream& out) const;
+
+private:
+    std::vector<GuestEventRecord> events_;
+    uint64_t count_;       ///< Events recorded since the last clear
+    uint64_t cycle_;       ///< Current stamp
+    uint32_t mask_;        ///< Selected event kinds
+    uint64_t watched_[2];  ///< Bit per IO register for IoWrite
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_GUEST_TRACE_H
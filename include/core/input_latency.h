@@ -0,0 +1,107 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the input latency probe. For every change of the
+// host button state it timestamps three points: the input entering the
+// Joypad, the first guest read of P1/JOYP whose selected button group
+// includes a changed button, and the first completed frame that differs
+// from the one before it. The two intervals are kept as distributions in
+// emulated frames and in host microseconds, which is what run-ahead and
+// pacing are tuned against.
+
+#ifndef GBLATOR_INPUT_LATENCY_H
+#define GBLATOR_INPUT_LATENCY_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace gblator {
+
+/** Interval measured by the probe. */
+enum class LatencyStage : uint8_t {
+    InputToRead,   ///< Input to the first P1 read that observes it
+    InputToFrame,  ///< Input to the first completed frame that changed
+    Count
+};
+
+/** Nearest-rank percentiles of one interval. */
+struct LatencyDistribution {
+    uint64_t samples = 0;
+    double p50Frames = 0, p90Frames = 0, p99Frames = 0, maxFrames = 0; ///< Emulated frames
+    double p50Us = 0, p90Us = 0, p99Us = 0, maxUs = 0;                 ///< Host microseconds
+};
+
+/**
+ * @brief Tracks one input at a time from the Joypad to the screen.
+ *
+ * Attach with GameBoy::setLatencyProbe(). An input that changes the
+ * buttons again before its frame changed is counted as superseded, and
+ * one followed by maxFrames unchanged frames as timed out; neither
+ * contributes an InputToFrame sample. Host time includes pacing sleeps,
+ * so in real-time mode it is the latency a player sees.
+ */
+class InputLatency {
+public:
+    /**
+     * @param capacity Samples kept per stage before the oldest are overwritten
+     * @param maxFrames Frames to wait for a changed frame before giving up
+     */
+    explicit InputLatency(size_t capacity = 4096, int maxFrames = 120);
+
+    /** Set the machine cycle used to stamp subsequent events. */
+    void setCycle(uint64_t cycle);
+    /** Called by the Joypad when the button state changes. */
+    void inputChanged(uint8_t previous, uint8_t buttons);
+    /** Called by Memory on a read of P1/JOYP with the buttons its select bits expose. */
+    void joypadRead(uint8_t visible);
+    /** Called by the PPU when a frame is presented, with the frame it replaces. */
+    void framePresented(const uint8_t* frame, const uint8_t* previous, size_t size);
+
+    /** Percentiles of the samples currently held for a stage. */
+    LatencyDistribution distribution(LatencyStage stage) const;
+    /** Inputs seen. */
+    uint64_t inputs() const;
+    /** Inputs replaced by another before their frame changed. */
+    uint64_t superseded() const;
+    /** Inputs after which no frame changed within maxFrames. */
+    uint64_t timedOut() const;
+    /** Discard all samples and counts. */
+    void clear();
+
+    /** Write both distributions and the counts as one JSON object. */
+    void writeJson(std::ostream& out) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Sample {
+        uint64_t cycles; ///< Emulated machine cycles
+        uint64_t ns;     ///< Host nanoseconds
+    };
+
+    /** Store an interval ending now for a stage. */
+    void record(LatencyStage stage);
+
+    std::vector<Sample> samples_[static_cast<size_t>(LatencyStage::Count)];
+    uint64_t recorded_[static_cast<size_t>(LatencyStage::Count)]; ///< Samples ever recorded per stage
+    int maxFrames_;
+    uint64_t cycle_;
+    uint64_t inputs_;
+    uint64_t superseded_;
+    uint64_t timedOut_;
+
+    // Input in flight
+    bool pending_;
+    bool observed_;          ///< A P1 read has seen it
+    uint8_t changed_;        ///< Buttons that changed
+    int framesWaited_;
+    uint64_t inputCycle_;
+    Clock::time_point inputTime_;
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_INPUT_LATENCY_H
@@ -0,0 +1,89 @@
+//
+// Part of the GBLator project.
+//
+// This header declares a pool of preconstructed GameBoy instances for
+// large batch nodes. Instances live in huge-page arenas, one arena per
+// core, built by a thread running on that core so the memory sits on the
+// core's NUMA node. Every instance borrows one ROM image kept by the
+// pool. All allocation happens in open(): acquire() and release() never
+// construct, destroy or allocate, since released machines are reset and
+// pushed back on their core's free list.
+
+#ifndef GBLATOR_INSTANCE_POOL_H
+#define GBLATOR_INSTANCE_POOL_H
+
+#include "utils/huge_page_arena.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace gblator {
+
+class GameBoy;
+
+/** Layout of an instance pool. */
+struct InstancePoolConfig {
+    int cores = 1;             ///< Number of per-core arenas; core i maps to CPU i modulo the CPU count
+    int instancesPerCore = 1;  ///< Instances preconstructed in each arena
+};
+
+/**
+ * @brief Preallocated, per-core lists of GameBoy instances for one ROM.
+ *
+ * A worker pinned to CPU c should acquire from and release to core c so
+ * it only ever touches node-local memory; the per-core locks are then
+ * uncontended.
+ */
+class InstancePool {
+public:
+    InstancePool();
+    ~InstancePool();
+
+    InstancePool(const InstancePool&) = delete;
+    InstancePool& operator=(const InstancePool&) = delete;
+
+    /**
+     * Map the arenas and construct every instance with the ROM loaded.
+     * @return true on success
+     */
+    bool open(const uint8_t* rom, size_t romSize, const InstancePoolConfig& config);
+    /** Destroy every instance and release the arenas. */
+    void close();
+
+    /**
+     * Take a freshly reset instance from a core's free list.
+     * @return The instance, or nullptr if that core has none left
+     */
+    GameBoy* acquire(int core);
+    /** Reset an instance and return it to the free list of its home core. */
+    void release(GameBoy* gb);
+
+    int cores() const;
+    /** Instances currently free on a core. */
+    size_t available(int core) const;
+    /** Whether every arena is backed by huge pages. */
+    bool hugePages() const;
+
+private:
+    struct Core {
+        HugePageArena arena;
+        mutable std::mutex mutex;
+        std::vector<GameBoy*> free; ///< Reserved to capacity so release() never allocates
+        size_t count = 0;           ///< Instances constructed in the arena
+        bool ok = false;            ///< Whether setup succeeded
+    };
+
+    /** Map and populate one core's arena; runs on a thread pinned to that core. */
+    void setupCore(Core& core, unsigned cpu, int instances);
+    GameBoy* instanceAt(const Core& core, size_t index) const;
+
+    std::vector<std::unique_ptr<Core>> cores_;
+    std::vector<uint8_t> rom_; ///< ROM image borrowed by every instance
+    size_t stride_; ///< Bytes between consecutive instances in an arena
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_INSTANCE_POOL_H
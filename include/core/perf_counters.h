@@ -0,0 +1,68 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the per-instance performance counters and their
+// JSON and Prometheus text renderings. The counters are plain integers
+// kept by the components themselves and only gathered on request, so
+// they cost nothing worth measuring and stay enabled in production.
+
+#ifndef GBLATOR_PERF_COUNTERS_H
+#define GBLATOR_PERF_COUNTERS_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace gblator {
+
+/**
+ * @brief Snapshot of an instance's counters.
+ *
+ * Every field counts from construction of the instance and is not
+ * affected by reset() or loading a state; take differences between
+ * snapshots for rates.
+ */
+struct PerfCounters {
+    uint64_t cycles = 0;            ///< Emulated machine cycles
+    uint64_t instructions = 0;      ///< Instructions executed
+    uint64_t frames = 0;            ///< Frames completed by runFrame()
+    uint64_t interrupts = 0;        ///< Interrupts dispatched
+    uint64_t bankSwitches = 0;      ///< Bank selection changes (MBC, VBK, SVBK)
+    uint64_t dmaTransfers = 0;      ///< OAM DMA transfers
+    uint64_t haltedCycles = 0;      ///< Halted cycles stepped one at a time
+    uint64_t idleSkipCycles = 0;    ///< Halted cycles skipped to the next event
+    uint64_t blockCacheHits = 0;    ///< Reserved for a block-caching CPU; always 0 with the interpreter
+    uint64_t blockCacheMisses = 0;  ///< Reserved for a block-caching CPU; always 0 with the interpreter
+    uint64_t hostNsLastFrame = 0;   ///< Host time spent in the last runFrame(), excluding pacing sleeps
+    uint64_t hostNsTotal = 0;       ///< Host time spent in all runFrame() calls, excluding pacing sleeps
+
+    // Host hardware counters over all measured frames; 0 unless enabled
+    // with GameBoy::enableHardwareCounters() and permitted by the kernel
+    uint64_t hostCycles = 0;        ///< Host CPU cycles
+    uint64_t hostInstructions = 0;  ///< Host instructions retired
+    uint64_t hostBranchMisses = 0;  ///< Host branch mispredictions
+    uint64_t hostL1dMisses = 0;     ///< Host L1 data cache read misses
+    uint64_t hostLlcMisses = 0;     ///< Host last-level cache read misses
+
+    // Ratios over the last measured frame; 0 when not measured
+    double hostIpcLastFrame = 0;            ///< Host instructions per host cycle
+    double branchMissesPerInstruction = 0;  ///< Host branch misses per emulated instruction
+    double l1dMissesPerInstruction = 0;     ///< Host L1D misses per emulated instruction
+    double llcMissesPerInstruction = 0;     ///< Host LLC misses per emulated instruction
+};
+
+/** Write the counters as one JSON object. */
+void writeCountersJson(const PerfCounters& counters, std::ostream& out);
+
+/**
+ * @brief Write the counters in the Prometheus text exposition format.
+ *
+ * @param counters Counters to write
+ * @param out Destination stream
+ * @param labels Label set without braces, e.g. instance="3" (may be empty)
+ */
+void writeCountersPrometheus(const PerfCounters& counters, std::ostream& out, const std::string& labels = "");
+
+} // namespace gblator
+
+#endif // GBLATOR_PERF_COUNTERS_H
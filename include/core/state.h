@@ -0,0 +1,144 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the small byte cursors used to serialise save
+// states. Every component writes its fields in a fixed order through a
+// StateWriter and reads them back in the same order through a
+// StateReader. Both work directly on caller-provided memory, so saving
+// and loading a state never allocates. Components also mark where each
+// part of their state starts; the marks are only collected when a layout
+// is requested, e.g. to diff two states region by region.
+
+#ifndef GBLATOR_STATE_H
+#define GBLATOR_STATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace gblator {
+
+/** A named part of a save state, as marked by StateWriter::section(). */
+struct StateSection {
+    const char* name = "";  ///< Component or region, e.g. "WRAM"
+    int bank = -1;          ///< Bank number of a banked region, or -1
+    int address = -1;       ///< Guest address of the first byte, or -1 if not memory-mapped
+    size_t offset = 0;      ///< Offset of the first byte in the state
+    size_t size = 0;        ///< Length in bytes
+};
+
+/**
+ * @brief Sequential writer of save-state data into a fixed buffer.
+ *
+ * A writer constructed without a buffer only counts bytes, which is how
+ * the size of a state is computed. Writing past the end of the buffer
+ * marks the writer as failed instead of overrunning it.
+ */
+class StateWriter {
+public:
+    /** Create a counting writer that stores nothing. */
+    StateWriter() : data_(nullptr), capacity_(0), size_(0), ok_(true) {}
+    /** Create a writer storing into the given buffer. */
+    StateWriter(uint8_t* data, size_t capacity)
+        : data_(data), capacity_(capacity), size_(0), ok_(true) {}
+
+    /** Append raw bytes. */
+    void write(const void* src, size_t count) {
+        if (data_ != nullptr && count != 0) {
+            if (size_ + count > capacity_) {
+                ok_ = false;
+                return;
+            }
+            std::memcpy(data_ + size_, src, count);
+        }
+        size_ += count;
+    }
+
+    /** Append a trivially copyable value in host byte order. */
+    template <typename T>
+    void value(const T& v) {
+        write(&v, sizeof(T));
+    }
+
+    /**
+     * Mark the start of a part of the state, which runs up to the next
+     * mark. Does nothing unless a layout is being collected.
+     * @param name Static string naming the part
+     * @param address Guest address of its first byte, or -1
+     * @param bank Bank number for banked memory, or -1
+     */
+    void section(const char* name, int address = -1, int bank = -1) {
+        if (layout_ != nullptr) {
+            StateSection part;
+            part.name = name;
+            part.bank = bank;
+            part.address = address;
+            part.offset = size_;
+            layout_->push_back(part);
+        }
+    }
+    /** Collect section() marks into layout (nullptr stops); sizes are left 0. */
+    void setLayout(std::vector<StateSection>* layout) { layout_ = layout; }
+
+    /** Number of bytes written (or counted) so far. */
+    size_t size() const { return size_; }
+    /** Whether every write fitted into the buffer. */
+    bool ok() const { return ok_; }
+
+private:
+    uint8_t* data_;
+    size_t capacity_;
+    size_t size_;
+    bool ok_;
+    std::vector<StateSection>* layout_ = nullptr;
+};
+
+/**
+ * @brief Sequential reader of save-state data from a fixed buffer.
+ *
+ * Reading past the end of the buffer marks the reader as failed and
+ * yields zero bytes, so a truncated state is detected rather than read
+ * out of bounds.
+ */
+class StateReader {
+public:
+    StateReader(const uint8_t* data, size_t size) : data_(data), size_(size), pos_(0), ok_(true) {}
+
+    /** Copy the next bytes into dst, which may be null when count is 0. */
+    void read(void* dst, size_t count) {
+        if (count == 0) {
+            return;
+        }
+        if (!ok_ || pos_ + count > size_) {
+            ok_ = false;
+            std::memset(dst, 0, count);
+            return;
+        }
+        std::memcpy(dst, data_ + pos_, count);
+        pos_ += count;
+    }
+
+    /** Read a trivially copyable value in host byte order. */
+    template <typename T>
+    void value(T& v) {
+        read(&v, sizeof(T));
+    }
+
+    /** Number of bytes consumed so far. */
+    size_t position() const { return pos_; }
+    /** Whether every read was satisfied. */
+    bool ok() const { return ok_; }
+    /** Mark the state as invalid (e.g. a size mismatch). */
+    void fail() { ok_ = false; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_;
+    bool ok_;
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_STATE_H
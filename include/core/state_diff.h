@@ -0,0 +1,65 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the comparison of two save states of the same
+// cartridge. The states are split along the layout reported by
+// GameBoy::stateLayout() (header, each memory bank, banking registers
+// and component internals) and every part is scanned 16 bytes at a time
+// with SSE2 or NEON where available. Differing bytes are grouped into
+// contiguous ranges and reported with guest addresses for memory-mapped
+// parts and with offsets for the rest.
+
+#ifndef GBLATOR_STATE_DIFF_H
+#define GBLATOR_STATE_DIFF_H
+
+#include "core/state.h"
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <span>
+#include <vector>
+
+namespace gblator {
+
+/** Contiguous differing bytes, relative to the start of their section. */
+struct StateDiffRange {
+    size_t offset = 0;
+    size_t size = 0;
+};
+
+/** Differences within one section of the state. */
+struct StateSectionDiff {
+    StateSection section;
+    size_t bytes = 0;                     ///< Differing bytes in the section
+    std::vector<StateDiffRange> ranges;   ///< In increasing order
+};
+
+/** Result of comparing two states. */
+struct StateDiff {
+    bool comparable = true;                  ///< false if the states differ in size
+    size_t bytes = 0;                        ///< Differing bytes in total
+    std::vector<StateSectionDiff> sections;  ///< Sections with differences, in state order
+};
+
+/**
+ * Find the first index at or after from where two buffers differ.
+ * @return The index, or size if the rest is equal
+ */
+size_t findDifference(const uint8_t* a, const uint8_t* b, size_t from, size_t size);
+
+/**
+ * Compare two states section by section. Bytes outside the layout are
+ * reported as a trailing "Unknown" section.
+ */
+StateDiff diffStates(const std::vector<StateSection>& layout, std::span<const uint8_t> a,
+                     std::span<const uint8_t> b);
+
+/**
+ * Write a human-readable report, e.g. "WRAM bank 1: D010-D013 (4 bytes)".
+ * At most maxRanges ranges are listed per section.
+ */
+void writeStateDiff(const StateDiff& diff, std::ostream& out, size_t maxRanges = 16);
+
+} // namespace gblator
+
+#endif // GBLATOR_STATE_DIFF_H
@@ -13,10 +13,38 @@
 #define GBLATOR_CPU_H
 
 #include <cstdint>
+#include <string>
 #include "mmu/memory.h"
+#include "utils/diagnostics.h"
 
 namespace gblator {
 
+class StateWriter;
+class StateReader;
+
+/**
+ * Ways of executing guest code. Every engine must produce exactly the
+ * same machine state; they differ only in host speed.
+ */
+enum class CpuEngine : uint8_t {
+    Interpreter,  ///< Decode and execute one instruction per CPU::step()
+    Batched,      ///< Same instructions, run in a tight loop with the per-instruction hooks hoisted out
+    Count
+};
+
+/** Number of CpuEngine values. */
+constexpr int kCpuEngines = static_cast<int>(CpuEngine::Count);
+
+/** Whether the engine is built into this binary. */
+bool cpuEngineAvailable(CpuEngine engine);
+/** Lower-case name of the engine, e.g. "interpreter". */
+const char* cpuEngineName(CpuEngine engine);
+/**
+ * Look up an engine by its name.
+ * @return false if no engine has that name
+ */
+bool parseCpuEngine(const std::string& name, CpuEngine& engine);
+
 /**
  * @brief Simple emulation of the Game Boy CPU.
  *
@@ -51,18 +79,57 @@ public:
     /**
      * @brief Execute a single instruction at the current program counter.
      *
-     * Fetches the opcode byte at the current PC, increments the PC, and
-     * dispatches execution. At present only a very small subset of
-     * opcodes is implemented; unimplemented opcodes will print a message
-     * to standard error.
+     * Services a pending interrupt if IME is set, otherwise fetches the
+     * opcode byte at the current PC, increments the PC, and dispatches
+     * execution. While halted the CPU executes nothing and one idle
+     * machine cycle elapses. Illegal opcodes execute as NOPs and are
+     * reported to diagnostics().
+     *
+     * @return Number of machine cycles (4 clock cycles each) consumed
+     */
+    int step();
+
+    /**
+     * @brief Whether the CPU is suspended by HALT or STOP.
+     *
+     * The CPU leaves this state as soon as an enabled interrupt is
+     * requested (IE & IF != 0), regardless of IME.
      */
-    void step();
+    bool halted() const;
+
+    /** Whether an enabled interrupt is currently requested (IE & IF). */
+    bool interruptPending() const;
+
+    /** Instructions executed since construction. */
+    uint64_t instructions() const;
+    /** Interrupts dispatched since construction. */
+    uint64_t interruptsTaken() const;
+    /** Idle machine cycles stepped one at a time while halted. */
+    uint64_t haltedCycles() const;
+
+    /** Illegal opcodes met so far, deduplicated per opcode and PC. */
+    DiagnosticChannel& diagnostics();
+
+    /** Serialise registers and interrupt/halt state. */
+    void saveState(StateWriter& writer) const;
+    /** Restore state written by saveState(). */
+    void loadState(StateReader& reader);
 
 private:
     // 8‑bit registers
     uint8_t a_{0}, f_{0}, b_{0}, c_{0}, d_{0}, e_{0}, h_{0}, l_{0};
     // Stack pointer and program counter
     uint16_t sp_{0}, pc_{0};
+    // Interrupt master enable and the delayed enable requested by EI
+    bool ime_{false}, imePending_{false};
+    // Low-power states entered by HALT and STOP
+    bool halted_{false}, stopped_{false};
+    // Extra machine cycles spent by a taken conditional branch
+    int extraCycles_{0};
+    // Performance counters; never reset, not part of the save state
+    uint64_t instructions_{0}, interruptsTaken_{0}, haltedCycles_{0};
+    // Reports of unimplemented opcodes; never reset
+    DiagnosticChannel diagnostics_;
     // Reference to memory
     Memory& memory_;
 
@@ -100,6 +167,17 @@ private:
      */
     bool getFlag(Flag flag) const;
 
+    /**
+     * @brief Dispatch a pending enabled interrupt.
+     *
+     * Wakes the CPU from HALT/STOP when any enabled interrupt is
+     * requested. If IME is set, pushes PC and jumps to the vector of the
+     * highest-priority interrupt, clearing its IF bit.
+     *
+     * @return Machine cycles spent dispatching, or 0 if none was taken
+     */
+    int serviceInterrupts();
+
     /**
      * @brief Dispatch execution of a single opcode.
      *
@@ -107,6 +185,14 @@ private:
      */
     void executeInstruction(uint8_t opcode);
 
+    /**
+     * @brief Execute a CB-prefixed opcode: rotates, shifts, SWAP, BIT, RES
+     * and SET on a register or on the byte at HL.
+     *
+     * @param opcode The byte following the 0xCB prefix
+     */
+    void executeCbInstruction(uint8_t opcode);
+
     // Helper arithmetic and flag update methods
     /**
      * @brief Increment an 8-bit value and update CPU flags.
@@ -0,0 +1,117 @@
+//
+// Part of the GBLator project.
+//
+// This header declares VectorEnv, a batched reinforcement-learning style
+// interface over many GameBoy instances running the same ROM. One call to
+// step() applies an action to every instance, runs them (optionally on
+// several threads) and writes observations, rewards and done flags into
+// contiguous arrays. Finished episodes restart from a start state that is
+// captured once, so resets cost a state load rather than a reboot.
+
+#ifndef GBLATOR_VECTOR_ENV_H
+#define GBLATOR_VECTOR_ENV_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace gblator {
+
+class GameBoy;
+class WorkerPool;
+
+/** How emulation is turned into environment steps. */
+struct EnvConfig {
+    int numEnvs = 1;           ///< Number of GameBoy instances
+    int numThreads = 1;        ///< Threads stepping the batch, including the caller
+    int frameSkip = 1;         ///< Frames run per step with the action held
+    int warmupFrames = 0;      ///< Frames run after boot before the start state is captured
+    int rewardAddress = -1;    ///< Reward is the change of this byte per step (-1: always 0)
+    int doneAddress = -1;      ///< Episode ends when this byte is non-zero (-1: never)
+    int maxEpisodeFrames = 0;  ///< Episode ends after this many frames (0: unlimited)
+};
+
+/**
+ * @brief A batch of GameBoy environments stepped with one call.
+ *
+ * Observations are stored as one [numEnvs, height, width] array of DMG
+ * shades (0–3). For an environment whose episode ended during a step,
+ * the done flag is set and its observation is already the first frame
+ * of the next episode.
+ */
+class VectorEnv {
+public:
+    VectorEnv();
+    ~VectorEnv();
+
+    /**
+     * @brief Boot every environment and capture the start state.
+     *
+     * @param rom Pointer to the ROM image (copied once and shared)
+     * @param romSize Size of the ROM image in bytes
+     * @param config Environment configuration
+     * @return true on success
+     */
+    bool open(const uint8_t* rom, size_t romSize, const EnvConfig& config);
+
+    /** Number of environments. */
+    size_t size() const;
+    /** Observation width in pixels. */
+    int width() const;
+    /** Observation height in pixels. */
+    int height() const;
+
+    /**
+     * @brief Write results into caller-owned arrays instead of internal ones.
+     *
+     * The arrays must hold size() observations, rewards and done flags and
+     * outlive their use by step() and reset(). Passing nullptr for all
+     * three returns to the internal arrays.
+     */
+    void setBuffers(uint8_t* observations, float* rewards, uint8_t* dones);
+
+    /** Restore every environment to the start state and publish its observation. */
+    void reset();
+
+    /**
+     * @brief Advance every environment by one step.
+     *
+     * @param actions One button mask (bit per Joypad::Button) per environment
+     * @param n Number of actions; must equal size()
+     * @return false if n does not match the number of environments
+     */
+    bool step(const uint8_t* actions, size_t n);
+
+    const uint8_t* observations() const;
+    const float* rewards() const;
+    const uint8_t* dones() const;
+
+    /** Access one environment directly. */
+    GameBoy& env(size_t index);
+
+private:
+    void stepEnv(size_t index, uint8_t action);
+    void resetEnv(size_t index);
+    void publish(size_t index);
+
+    EnvConfig config_;
+    std::vector<uint8_t> rom_;  ///< One copy of the ROM image, borrowed by every environment
+    std::vector<std::unique_ptr<GameBoy>> envs_;
+    std::unique_ptr<WorkerPool> pool_;
+    std::vector<uint8_t> startState_;
+    std::vector<int> episodeFrames_;
+    std::vector<uint8_t> rewardValues_;
+
+    // Internal result arrays and the ones currently written to
+    std::vector<uint8_t> ownObservations_;
+    std::vector<float> ownRewards_;
+    std::vector<uint8_t> ownDones_;
+    uint8_t* observations_;
+    float* rewards_;
+    uint8_t* dones_;
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_VECTOR_ENV_H
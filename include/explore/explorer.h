@@ -0,0 +1,119 @@
+//
+// Part of the GBLator project.
+//
+// This header declares a Go-Explore style driver that searches a ROM's
+// state space with save states. It keeps an archive of cells, each a
+// coarse fingerprint of the machine (a downscaled frame or a handful of
+// RAM bytes) together with a state that reaches it. Every generation it
+// restores a batch of promising cells, runs a burst of inputs from each
+// on a worker pool and adds the cells those bursts discover.
+
+#ifndef GBLATOR_EXPLORER_H
+#define GBLATOR_EXPLORER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace gblator {
+
+class GameBoy;
+class WorkerPool;
+
+/**
+ * Chooses the buttons (bit per Joypad::Button) for one frame of a burst.
+ * Called concurrently from worker threads; rng is the burst's private
+ * generator state and frame counts from 0 within the burst.
+ */
+using InputPolicy = uint8_t (*)(void* context, uint64_t& rng, int frame);
+
+/** Exploration parameters. */
+struct ExploreConfig {
+    int numThreads = 1;             ///< Threads running bursts, including the caller
+    int burstsPerGeneration = 16;   ///< Bursts run in parallel per generation
+    int burstFrames = 60;           ///< Frames per burst
+    int actionRepeat = 4;           ///< Frames a random input is held (default policy only)
+    int warmupFrames = 0;           ///< Frames run after boot before the first cell is taken
+    int maxCellsPerBurst = 8;       ///< New cells a single burst may contribute
+    std::vector<uint16_t> cellAddresses; ///< Cell key bytes; empty keys cells on the downscaled frame
+    int cellWidth = 11;             ///< Downscaled frame width
+    int cellHeight = 8;             ///< Downscaled frame height
+    int cellShades = 8;             ///< Intensity levels of the downscaled frame
+    uint64_t seed = 1;              ///< Seed for cell selection and random inputs
+    InputPolicy policy = nullptr;   ///< Scripted input policy (nullptr: random buttons)
+    void* policyContext = nullptr;  ///< Passed to policy
+};
+
+/** One archive entry. */
+struct Cell {
+    uint64_t key = 0;          ///< Fingerprint of the machine state
+    uint64_t frames = 0;       ///< Frames from the start state to this cell
+    uint32_t timesChosen = 0;  ///< Bursts started from this cell
+    uint32_t discoveries = 0;  ///< New cells found by bursts started here
+};
+
+/**
+ * @brief Archive-based state-space explorer.
+ *
+ * Cells are chosen with weight 1/sqrt(1 + timesChosen), so rarely
+ * explored cells are favoured. When a burst reaches a known cell in fewer
+ * frames than recorded, the cell's state is replaced by the shorter path.
+ * Results depend only on the seed, not on the number of threads.
+ */
+class Explorer {
+public:
+    Explorer();
+    ~Explorer();
+
+    /**
+     * Boot the ROM, run the warm-up and seed the archive with one cell.
+     * @return true on success
+     */
+    bool open(const uint8_t* rom, size_t romSize, const ExploreConfig& config);
+
+    /** Run one generation of bursts and merge the cells they found. */
+    void runGeneration();
+
+    size_t cellCount() const;
+    const Cell& cell(size_t index) const;
+    /** Save state of a cell, usable with GameBoy::loadState(). */
+    const uint8_t* cellState(size_t index) const;
+    size_t stateSize() const;
+    /** Total frames emulated by bursts. */
+    uint64_t framesRun() const;
+    /** Generations completed. */
+    uint64_t generations() const;
+
+private:
+    /** Per-burst instance and the cells it found, merged after the batch. */
+    struct Slot {
+        std::unique_ptr<GameBoy> gb;
+        size_t cell = 0;            ///< Archive index the burst started from
+        uint64_t rng = 0;
+        std::vector<Cell> found;
+        std::vector<uint8_t> states; ///< found.size() states back to back
+    };
+
+    void runBurst(size_t slot);
+    uint64_t cellKey(GameBoy& gb) const;
+    size_t chooseCell(uint64_t& rng) const;
+    void addCell(const Cell& cell, const uint8_t* state);
+
+    ExploreConfig config_;
+    std::vector<uint8_t> rom_;  ///< One copy of the ROM image, borrowed by every slot
+    std::vector<Slot> slots_;
+    std::unique_ptr<WorkerPool> pool_;
+    std::vector<Cell> cells_;
+    std::vector<uint8_t> states_;                 ///< cells_.size() states back to back
+    std::unordered_map<uint64_t, size_t> index_;  ///< Cell key to archive index
+    std::vector<double> weights_;                 ///< Cumulative selection weights
+    size_t stateSize_;
+    uint64_t framesRun_;
+    uint64_t generations_;
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_EXPLORER_H
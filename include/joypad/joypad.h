@@ -15,6 +15,8 @@
 namespace gblator {
 
 class Memory;
+class StateWriter;
+class StateReader;
 
 /**
  * @brief Represents the Game Boy joypad input.
@@ -41,10 +43,26 @@ public:
     void reset();
     /** Press or release a button. */
     void setButton(Button button, bool pressed);
-    /** Update the JOYP register to reflect current button states. */
+    /**
+     * Set the state of all eight buttons at once.
+     *
+     * @param buttons Bitmask indexed by Button (1 = pressed)
+     */
+    void setButtons(uint8_t buttons);
+    /** Current button bitmask indexed by Button (1 = pressed). */
+    uint8_t buttons() const;
+    /** Make reads of the JOYP register reflect the current button states. */
     void updateRegister();
 
+    /** Serialise the button state. */
+    void saveState(StateWriter& writer) const;
+    /** Restore state written by saveState(). */
+    void loadState(StateReader& reader);
+
 private:
+    /** Report a change of the button state to the latency probe, if any. */
+    void noteInput(uint8_t previous);
+
     Memory& memory_;
     uint8_t buttonState_; ///< Bitmask of button states (1=pressed, 0=released)
 };
@@ -0,0 +1,68 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the memory access statistics gathered by the
+// instrumentation build of Memory (CMake option GBLATOR_MEMORY_STATS).
+// They show which regions and IO registers guest code touches most,
+// i.e. which accesses would benefit from fast paths or lazy evaluation.
+
+#ifndef GBLATOR_ACCESS_STATS_H
+#define GBLATOR_ACCESS_STATS_H
+
+#include <cstdint>
+#include <iosfwd>
+
+namespace gblator {
+
+/** Regions of the memory map as decoded by Memory. */
+enum class AccessRegion {
+    ROM0,      ///< 0000–3FFF fixed ROM bank (writes are MBC commands)
+    ROMX,      ///< 4000–7FFF switchable ROM bank (writes are MBC commands)
+    VRAM,      ///< 8000–9FFF
+    ERAM,      ///< A000–BFFF cartridge RAM
+    WRAM0,     ///< C000–CFFF
+    WRAMX,     ///< D000–DFFF
+    Echo,      ///< E000–FDFF mirror of C000–DDFF
+    OAM,       ///< FE00–FE9F
+    Unusable,  ///< FEA0–FEFF
+    IO,        ///< FF00–FF7F
+    HRAM,      ///< FF80–FFFE
+    IE,        ///< FFFF
+    Count
+};
+
+/** Number of AccessRegion values. */
+constexpr int kAccessRegions = static_cast<int>(AccessRegion::Count);
+
+/**
+ * @brief Read and write counts per region and per IO register.
+ *
+ * Only accesses made by the CPU are counted; the PPU, timer and other
+ * components reading their own registers are excluded. An echo RAM access
+ * is counted under Echo and again under the WRAM region it mirrors.
+ */
+struct MemoryAccessStats {
+    uint64_t reads[kAccessRegions] = {};
+    uint64_t writes[kAccessRegions] = {};
+    uint64_t ioReads[0x80] = {};   ///< Indexed by address - 0xFF00
+    uint64_t ioWrites[0x80] = {};  ///< Indexed by address - 0xFF00
+};
+
+/** Region an address decodes to. */
+AccessRegion accessRegion(uint16_t address);
+
+/** Short name of a region, e.g. "WRAM0". */
+const char* accessRegionName(AccessRegion region);
+
+/**
+ * @brief Write the statistics as one JSON object.
+ *
+ * Regions are listed in map order; IO registers only when accessed.
+ * Counts are divided by frames (if non-zero) to report per-frame rates
+ * alongside the totals.
+ */
+void writeAccessStatsJson(const MemoryAccessStats& stats, uint64_t frames, std::ostream& out);
+
+} // namespace gblator
+
+#endif // GBLATOR_ACCESS_STATS_H
@@ -13,12 +13,28 @@
 #ifndef GBLATOR_MEMORY_H
 #define GBLATOR_MEMORY_H
 
+#include <array>
+#include "mmu/access_stats.h"
+#include <cstddef>
 #include <cstdint>
+#include <span>
 #include <string>
 #include <vector>
 
 namespace gblator {
 
+class StateWriter;
+class StateReader;
+class GuestTrace;
+class InputLatency;
+class CycleScheduler;
+
+/** How loadROM() keeps a ROM image given as a buffer. */
+enum class RomOwnership {
+    Copy,   ///< Copy the image into the Memory
+    Borrow  ///< Read the caller's buffer in place
+};
+
 /**
  * @brief Represents the Game Boy's memory and implements address decoding.
  *
@@ -43,6 +59,17 @@ namespace gblator {
  */
 class Memory {
 public:
+    /** RAM regions whose backing storage can be accessed directly. */
+    enum class Region {
+        VRAM0,  ///< VRAM bank 0 (8 KiB)
+        VRAM1,  ///< VRAM bank 1 (8 KiB, CGB only)
+        WRAM,   ///< All eight work RAM banks (32 KiB)
+        ERAM,   ///< Cartridge RAM, all banks (size depends on the cartridge)
+        OAM,    ///< Object Attribute Memory (160 bytes)
+        IO,     ///< I/O registers FF00–FF7F (128 bytes)
+        HRAM    ///< High RAM (127 bytes)
+    };
+
     /**
      * @brief Construct a new Memory instance.
      *
@@ -51,6 +78,10 @@ public:
      */
     Memory();
 
+    // The ROM view may point into romData_, so copies would dangle
+    Memory(const Memory&) = delete;
+    Memory& operator=(const Memory&) = delete;
+
     /**
      * @brief Read a byte from the given address.
      *
@@ -108,6 +139,110 @@ public:
      */
     bool loadROM(const std::string &filepath);
 
+    /**
+     * @brief Load a ROM image from a memory buffer.
+     *
+     * Copies the image into the internal ROM buffer and configures the
+     * cartridge exactly as loadROM(filepath) does.
+     *
+     * @param data Pointer to the ROM image
+     * @param size Size of the ROM image in bytes
+     * @return true on success, false if the image is empty
+     */
+    bool loadROM(const uint8_t* data, size_t size);
+
+    /**
+     * @brief Load a ROM image held by the caller.
+     *
+     * With RomOwnership::Borrow nothing is copied: the emulator reads the
+     * caller's buffer, which must stay unchanged and alive until another
+     * ROM is loaded or the Memory is destroyed. Many instances can share
+     * one image this way.
+     *
+     * @param rom The ROM image
+     * @param ownership Whether to copy or borrow the image
+     * @return true on success, false if the image is empty
+     */
+    bool loadROM(std::span<const uint8_t> rom, RomOwnership ownership = RomOwnership::Copy);
+
+    /**
+     * @brief Load a ROM image from an open file descriptor.
+     *
+     * Regular files are read from offset 0 without moving the file
+     * position; pipes and sockets are read until end of file. The
+     * descriptor is not closed. Unsupported where POSIX I/O is missing.
+     *
+     * @param fd Readable file descriptor
+     * @return true on success, false on a read error or an empty image
+     */
+    bool loadROMFromFd(int fd);
+
+    /**
+     * @brief Access the backing storage of a RAM region.
+     *
+     * The returned pointer stays valid until the next ROM load, which
+     * may reallocate cartridge RAM.
+     *
+     * @param region Region to access
+     * @param size Receives the size of the region in bytes
+     * @return Pointer to the first byte of the region (nullptr if empty)
+     */
+    uint8_t* regionData(Region region, size_t& size);
+
+    /** The loaded ROM image (copied or borrowed); empty before a load. */
+    std::span<const uint8_t> romImage() const;
+
+    /** Enabled and requested interrupts (IE & IF & 0x1F), read without address decoding. */
+    uint8_t pendingInterrupts() const;
+    /** SC (FF02), read without address decoding; polled by the serial port every step. */
+    uint8_t serialControl() const;
+
+    /**
+     * Access statistics gathered since the last clear. Only maintained in
+     * builds configured with GBLATOR_MEMORY_STATS; always zero otherwise.
+     */
+    const MemoryAccessStats& accessStats() const;
+    void clearAccessStats();
+    /** Count (or stop counting) subsequent accesses; used to exclude non-CPU accesses. */
+    void setAccessCounting(bool enabled);
+
+    /** Attach a guest event timeline (nullptr detaches). Not owned. */
+    void setTrace(GuestTrace* trace);
+    /** Attached timeline, shared with the other components, or nullptr. */
+    GuestTrace* trace() const;
+    /** Attach an input latency probe (nullptr detaches). Not owned. */
+    void setLatencyProbe(InputLatency* probe);
+    /** Attached probe, shared with the Joypad and PPU, or nullptr. */
+    InputLatency* latencyProbe() const;
+    /**
+     * Mark subsequent accesses as made by the guest CPU (or by the host).
+     * Only guest reads of P1 count as the guest observing an input.
+     */
+    void setCpuAccess(bool cpu);
+    /**
+     * Attach the scheduler running the PPU and timer (nullptr detaches).
+     * Writes to LCDC, STAT, LY, LYC and TAC invalidate it. Not owned.
+     */
+    void setScheduler(CycleScheduler* scheduler);
+
+    /**
+     * Set the pressed buttons (bit per Joypad::Button) that reads of
+     * P1/JOYP report for the selected group. Kept up to date by the Joypad.
+     */
+    void setJoypadButtons(uint8_t buttons);
+
+    /** Writes that changed the ROM, cartridge RAM, VRAM or WRAM bank mapping. */
+    uint64_t bankSwitches() const;
+    /** OAM DMA transfers started. */
+    uint64_t dmaTransfers() const;
+
+    /** Serialise RAM contents and banking registers. ROM is not included. */
+    void saveState(StateWriter& writer) const;
+    /** Restore state written by saveState(); fails on a cartridge RAM size mismatch. */
+    void loadState(StateReader& reader);
+    /** Whether a state positioned at this component's part fits the loaded cartridge; consumes nothing. */
+    bool acceptsState(StateReader reader) const;
+
     /**
      * @brief Reset memory to initial state.
      *
@@ -120,17 +255,33 @@ private:
     // Helpers to compute current ROM bank and RAM bank based on MBC
     uint8_t currentROMBank() const;
     uint8_t currentRAMBank() const;
+    /** Count a bank selection change and trace it. */
+    void noteBankSwitch(uint16_t address, uint8_t bank);
+    /** Trace the side effects of an IO register write before it happens. */
+    void traceIoWrite(uint16_t address, uint8_t value);
+    /** Value of P1/JOYP: the stored select bits and the selected buttons (active-low). */
+    uint8_t joypadRegister() const;
+    /** Parse the header of the image at rom_, size the cartridge RAM and reset. */
+    void initCartridge();
+#if defined(GBLATOR_MEMORY_STATS)
+    /** Count one access in accessStats_. */
+    void countAccess(uint16_t address, bool write) const;
+#endif
 
-    // Cartridge and memory configuration
-    std::vector<uint8_t> romData_;      ///< Entire ROM data loaded from file
+    // Cartridge and memory configuration. The fixed-size regions are stored
+    // inline so the whole machine state lives in one allocation.
+    std::vector<uint8_t> romData_;      ///< Copied ROM image; empty when borrowed
+    const uint8_t* rom_;                ///< ROM image read by the CPU (romData_ or a borrowed buffer)
+    size_t romSize_;                    ///< Size of the ROM image
     std::vector<uint8_t> eram_;         ///< External RAM (cartridge RAM)
-    std::vector<uint8_t> wram_;         ///< Work RAM (8 banks of 4 KiB each)
-    std::vector<uint8_t> vram0_;        ///< VRAM bank 0 (8 KiB)
-    std::vector<uint8_t> vram1_;        ///< VRAM bank 1 (8 KiB, CGB only)
-    std::vector<uint8_t> oam_;          ///< Object Attribute Memory (160 bytes)
+    std::array<uint8_t, 0x8000> wram_;  ///< Work RAM (8 banks of 4 KiB each)
+    std::array<uint8_t, 0x2000> vram0_; ///< VRAM bank 0 (8 KiB)
+    std::array<uint8_t, 0x2000> vram1_; ///< VRAM bank 1 (8 KiB, CGB only)
+    std::array<uint8_t, 0xA0> oam_;     ///< Object Attribute Memory (160 bytes)
     uint8_t ioRegisters_[0x80];         ///< I/O registers FF00–FF7F
-    std::vector<uint8_t> hram_;         ///< High RAM (127 bytes)
+    std::array<uint8_t, 0x7F> hram_;    ///< High RAM (127 bytes)
     uint8_t ieRegister_;                ///< Interrupt Enable register at FFFF
+    uint8_t joypadButtons_;             ///< Pressed buttons mirrored from the Joypad (1 = pressed)
 
     // MBC1 state
     uint8_t romBankLow_;                ///< 5‑bit lower ROM bank register (00→01 translation applies)
@@ -146,6 +297,18 @@ private:
     uint8_t cartType_;                  ///< Cartridge type (MBC)
     size_t numRomBanks_;                ///< Number of 16‑KiB ROM banks
     size_t numRamBanks_;                ///< Number of 8‑KiB RAM banks
+
+    // Performance counters; never reset, not part of the save state
+    uint64_t bankSwitches_;             ///< Writes that changed a bank selection
+    uint64_t dmaTransfers_;             ///< OAM DMA transfers started
+    GuestTrace* trace_;                 ///< Guest event timeline, or nullptr
+    InputLatency* latency_;             ///< Input latency probe, or nullptr
+    CycleScheduler* scheduler_;         ///< Scheduler of the timing components, or nullptr
+    bool cpuAccess_;                    ///< Whether accesses are currently made by the CPU
+#if defined(GBLATOR_MEMORY_STATS)
+    mutable MemoryAccessStats accessStats_; ///< Counted from const readByte() as well
+    bool accessCounting_;               ///< Whether accesses are currently counted
+#endif
 };
 
 } // namespace gblator
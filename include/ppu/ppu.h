@@ -4,10 +4,11 @@
 // This header declares a very simple PPU (Pixel Processing Unit) class which
 // manages the LCD state machine for the Game Boy. It tracks scanline timing,
 // PPU modes (HBlank, VBlank, OAM search, pixel transfer), and updates
-// relevant memory‑mapped registers (LY and STAT). It does not implement
-// actual pixel rendering; instead, it provides the framework to add a
-// renderer later. The timings and mode durations are based on the Pan Docs
-// description of PPU modes【602189112438222†L141-L160】.
+// relevant memory‑mapped registers (LY and STAT). Each visible scanline is
+// rendered (background, window and objects) into a back buffer when it
+// completes, and the buffers are swapped at the start of VBlank. The
+// timings and mode durations are based on the Pan Docs description of PPU
+// modes【602189112438222†L141-L160】.
 
 #ifndef GBLATOR_PPU_H
 #define GBLATOR_PPU_H
@@ -17,6 +18,8 @@
 namespace gblator {
 
 class Memory;
+class StateWriter;
+class StateReader;
 
 /**
  * @brief Simple Pixel Processing Unit emulation.
@@ -31,6 +34,9 @@ class Memory;
  */
 class PPU {
 public:
+    static constexpr int kScreenWidth = 160;
+    static constexpr int kScreenHeight = 144;
+
     /**
      * @brief Construct a new PPU attached to a Memory instance.
      *
@@ -55,12 +61,56 @@ public:
      */
     void step(int cycles);
 
+    /**
+     * @brief Number of CPU cycles until the PPU next requests an interrupt.
+     *
+     * Only the VBlank interrupt is generated at present, so this is the
+     * distance to the start of the next VBlank (LY=144). Returns INT_MAX
+     * while the LCD is off, as no interrupt can be raised then.
+     */
+    int cyclesUntilNextEvent() const;
+
+    /**
+     * @brief Number of CPU cycles until the PPU next changes LY or the
+     * STAT mode, or INT_MAX while the LCD is off.
+     *
+     * Stepping the PPU by less than this only advances its dot counter.
+     */
+    int cyclesUntilNextChange() const;
+
+    /**
+     * @brief Last completed frame, one byte per pixel.
+     *
+     * Pixels are stored row by row (kScreenWidth × kScreenHeight) as DMG
+     * shades 0 (white) to 3 (black) after palette mapping. The pointer
+     * stays valid, and its contents unchanged, until the PPU is stepped
+     * into the next VBlank.
+     */
+    const uint8_t* frameBuffer() const;
+
+    /** Number of frames completed (VBlank entries) since reset. */
+    uint64_t frameCount() const;
+
+    /** Serialise the PPU timing state. */
+    void saveState(StateWriter& writer) const;
+    /** Restore state written by saveState(). */
+    void loadState(StateReader& reader);
+
 private:
     Memory& memory_;
     int dotCounter_;  ///< Current dot within the current scanline (0–455)
     uint8_t ly_;      ///< Current scanline (0–153)
     uint8_t mode_;    ///< Current PPU mode (0–3)
     bool vblankTriggered_; ///< Whether the VBlank interrupt has been triggered this frame
+    uint8_t windowLine_;   ///< Internal window line counter for the current frame
+    int frontBuffer_;      ///< Index of the completed frame in frameBuffers_
+    uint64_t frameCount_;  ///< Frames completed since reset
+    uint8_t frameBuffers_[2][kScreenWidth * kScreenHeight]; ///< Front and back frame buffers
+
+    /**
+     * @brief Render the current scanline (LY) into the back buffer.
+     */
+    void renderScanline();
 
     /**
      * @brief Update the STAT register’s mode bits and LYC=LY flag.
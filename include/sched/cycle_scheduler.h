@@ -0,0 +1,210 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the cycle scheduler that runs a console's
+// components as C++20 coroutines. A component task loops forever: it
+// co_awaits the number of machine cycles until its registers next
+// change, then catches its component up by the cycles that actually
+// elapsed. The GameBoy advances the scheduler after every instruction,
+// which costs one comparison unless a task is due; due tasks are resumed
+// in timestamp order, ties in the order they were spawned. Between
+// resumptions a component's registers are exactly what stepping it after
+// every instruction would have produced. When the CPU writes a register
+// that a task's sleep was computed from (LCDC, STAT, LY, LYC or TAC),
+// the memory asks the scheduler to catch every task up to the start of
+// that instruction and to run them all again at its end. While the CPU is
+// halted nothing observes the registers, so a skipped stretch resumes
+// each task only once.
+//
+// Coroutine frames are carved from an arena stored inline in the
+// scheduler, so spawning allocates nothing from the heap and resuming
+// allocates nothing at all.
+
+#ifndef GBLATOR_CYCLE_SCHEDULER_H
+#define GBLATOR_CYCLE_SCHEDULER_H
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+
+// Wrap component task definitions in these. GCC takes the arena operator
+// new template and the no-op operator delete for a mismatched pair.
+#if defined(__GNUC__) && !defined(__clang__)
+#define GBLATOR_TASKS_BEGIN \
+    _Pragma("GCC diagnostic push") _Pragma("GCC diagnostic ignored \"-Wmismatched-new-delete\"")
+#define GBLATOR_TASKS_END _Pragma("GCC diagnostic pop")
+#else
+#define GBLATOR_TASKS_BEGIN
+#define GBLATOR_TASKS_END
+#endif
+
+namespace gblator {
+
+class CycleScheduler;
+
+/**
+ * @brief Coroutine type of a component task.
+ *
+ * The body must take the CycleScheduler as its first parameter, which is
+ * where the frame is allocated, and be defined between GBLATOR_TASKS_BEGIN
+ * and GBLATOR_TASKS_END. A task does nothing until it is handed to
+ * CycleScheduler::spawn().
+ */
+class ComponentTask {
+public:
+    struct promise_type {
+        int slot = -1;  ///< Index in the scheduler, set by spawn()
+
+        /** Allocate the frame in the scheduler's arena; nullptr once it is full. */
+        template <typename... Args>
+        static void* operator new(size_t size, CycleScheduler& scheduler, Args&...) noexcept;
+        /** Frames are reclaimed with the scheduler. */
+        static void operator delete(void*, size_t) noexcept {}
+        static ComponentTask get_return_object_on_allocation_failure() noexcept { return ComponentTask(nullptr); }
+
+        ComponentTask get_return_object() noexcept {
+            return ComponentTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept {}
+    };
+    using Handle = std::coroutine_handle<promise_type>;
+
+    ComponentTask(ComponentTask&& other) noexcept : handle_(other.handle_) { other.handle_ = nullptr; }
+    ComponentTask(const ComponentTask&) = delete;
+    ComponentTask& operator=(const ComponentTask&) = delete;
+    ComponentTask& operator=(ComponentTask&&) = delete;
+    /** Destroys the frame if it was never spawned. */
+    ~ComponentTask();
+
+private:
+    friend class CycleScheduler;
+    explicit ComponentTask(Handle handle) : handle_(handle) {}
+
+    Handle handle_;
+};
+
+/**
+ * @brief Resumes component tasks when the cycles they wait for are due.
+ *
+ * Not thread-safe; a scheduler belongs to one console and must not be
+ * moved once tasks are spawned.
+ */
+class CycleScheduler {
+public:
+    /** Most tasks one scheduler runs. */
+    static constexpr int kMaxTasks = 4;
+    /** Bytes available for coroutine frames. */
+    static constexpr size_t kArenaSize = 2048;
+
+    /** Awaitable returned by sleep(); yields the machine cycles since the task last ran. */
+    class Sleep {
+    public:
+        Sleep(CycleScheduler& scheduler, int cycles) : scheduler_(scheduler), cycles_(cycles), slot_(-1) {}
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(ComponentTask::Handle handle) noexcept;
+        int await_resume() noexcept;
+
+    private:
+        CycleScheduler& scheduler_;
+        int cycles_;
+        int slot_;
+    };
+
+    CycleScheduler();
+    /** Destroys the frames of all tasks. */
+    ~CycleScheduler();
+
+    CycleScheduler(const CycleScheduler&) = delete;
+    CycleScheduler& operator=(const CycleScheduler&) = delete;
+
+    /**
+     * Take over a task and run it up to its first sleep.
+     * @return false if the task could not be allocated or kMaxTasks are running
+     */
+    bool spawn(ComponentTask task);
+
+    /**
+     * Suspend the calling task for the given machine cycles (at least one;
+     * INT_MAX sleeps until the next sync).
+     */
+    Sleep sleep(int cycles) { return Sleep(*this, cycles); }
+
+    /** Resume every task due at or before the given cycle, in timestamp order. */
+    void advance(uint64_t now) {
+        if (now >= nextDue_) {
+            runUntil(now);
+        } else {
+            now_ = now;
+        }
+    }
+
+    /**
+     * Move to the given cycle and resume every task once, so each
+     * component covers the whole stretch in a single step. Only valid
+     * while nothing observes the registers in between, e.g. while the CPU
+     * is halted.
+     */
+    void jumpTo(uint64_t now);
+    /** Resume every task now, so all components are caught up to the current cycle. */
+    void syncAll();
+    /**
+     * A register some task's sleep depends on is about to be written:
+     * catch every task up now, and resume them all again at the next
+     * advance(). Ignored while a task is running.
+     */
+    void invalidate();
+    /**
+     * Discard the cycles elapsed since each task last ran and let every
+     * task recompute its sleep; used after components were reset or
+     * loaded from a save state. The next advance() resumes all tasks.
+     */
+    void restart();
+
+    /** Cycle the scheduler has reached. */
+    uint64_t now() const { return now_; }
+    /** Tasks resumed so far. */
+    uint64_t resumes() const { return resumes_; }
+    /** Arena bytes taken by coroutine frames. */
+    size_t arenaUsed() const { return arenaUsed_; }
+
+private:
+    template <typename... Args>
+    friend void* ComponentTask::promise_type::operator new(size_t, CycleScheduler&, Args&...) noexcept;
+
+    struct Slot {
+        ComponentTask::Handle handle;
+        uint64_t due = UINT64_MAX;   ///< Cycle at which the task wants to run
+        uint64_t lastRun = 0;        ///< Cycle at which the task last ran
+    };
+
+    void* allocate(size_t size) noexcept;
+    void runUntil(uint64_t now);
+    /** Resume one task at now_. */
+    void resume(int slot);
+    /** Resume every task at now_. */
+    void resumeAll();
+    void updateNextDue();
+
+    std::array<Slot, kMaxTasks> slots_;
+    int count_;
+    uint64_t now_;
+    uint64_t nextDue_;      ///< Earliest due cycle, or 0 to force the next advance()
+    uint64_t resumes_;
+    bool resuming_;         ///< A task is running; syncs are ignored
+    bool resyncPending_;    ///< Resume every task at the next advance()
+    size_t arenaUsed_;
+    alignas(std::max_align_t) std::byte arena_[kArenaSize];
+};
+
+template <typename... Args>
+void* ComponentTask::promise_type::operator new(size_t size, CycleScheduler& scheduler, Args&...) noexcept {
+    return scheduler.allocate(size);
+}
+
+} // namespace gblator
+
+#endif // GBLATOR_CYCLE_SCHEDULER_H
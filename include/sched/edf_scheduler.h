@@ -0,0 +1,112 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the earliest-deadline-first scheduler that runs
+// many real-time GameBoy instances on a few worker threads. Each instance
+// is released once per Game Boy frame period and must finish its frame
+// before the next release; workers always pick the released instance
+// with the earliest deadline and run exactly one frame of it. Instead of
+// every instance sleeping on its own thread, idle time is spent on other
+// instances, and deadline misses are recorded per instance.
+
+#ifndef GBLATOR_EDF_SCHEDULER_H
+#define GBLATOR_EDF_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gblator {
+
+class GameBoy;
+
+/** Per-instance scheduling statistics. */
+struct EdfStats {
+    uint64_t framesRun = 0;       ///< Frames completed
+    uint64_t deadlineMisses = 0;  ///< Frames completed after their deadline
+    uint64_t resyncs = 0;         ///< Times the instance fell a whole period behind and was re-phased
+    int64_t maxLatenessNs = 0;    ///< Worst completion time past a deadline
+};
+
+/**
+ * @brief Multiplexes real-time GameBoy instances onto worker threads.
+ *
+ * Instances must not use GameBoy::setRealTime(); pacing is done here.
+ * Input set through setInput() is applied at the start of the next frame
+ * and the optional per-instance callback runs on the worker right after
+ * each frame, e.g. to hand the framebuffer to an encoder.
+ */
+class EdfScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using FrameCallback = std::function<void(GameBoy&)>;
+
+    /**
+     * @brief Create the scheduler and its workers.
+     *
+     * @param workers Number of worker threads (at least 1)
+     * @param pinThreads Pin worker i to CPU i modulo the CPU count (Linux only)
+     */
+    explicit EdfScheduler(int workers, bool pinThreads = true);
+    /** Stops the workers; instances are not touched. */
+    ~EdfScheduler();
+
+    EdfScheduler(const EdfScheduler&) = delete;
+    EdfScheduler& operator=(const EdfScheduler&) = delete;
+
+    /**
+     * @brief Start scheduling an instance, first released immediately.
+     *
+     * @param gb Instance to run; must stay alive until remove() returns
+     * @param onFrame Called on the worker after every frame (may be empty)
+     * @return Identifier used by the other methods
+     */
+    int add(GameBoy& gb, FrameCallback onFrame = FrameCallback());
+
+    /** Stop scheduling an instance, waiting for a frame in progress. */
+    void remove(int id);
+
+    /** Set the buttons (bit per Joypad::Button) applied from the next frame on. */
+    void setInput(int id, uint8_t buttons);
+
+    /** Statistics of one instance. */
+    EdfStats stats(int id) const;
+
+    /** Frame period used for every instance (about 16.74 ms). */
+    static Clock::duration framePeriod();
+
+private:
+    struct Entry {
+        GameBoy* gb = nullptr;
+        FrameCallback onFrame;
+        std::atomic<uint8_t> input{0};
+        Clock::time_point release;
+        Clock::time_point deadline;
+        EdfStats stats;
+        bool active = false;   ///< Still scheduled
+        bool queued = false;   ///< Present in the ready heap
+        bool running = false;  ///< A worker is running its frame
+    };
+
+    void workerLoop();
+    void push(Entry* entry);
+    Entry* popEarliest();
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;     ///< Signals workers about heap changes
+    std::condition_variable finished_; ///< Signals remove() that a frame ended
+    std::vector<std::unique_ptr<Entry>> entries_;
+    std::vector<Entry*> heap_;         ///< Min-heap on deadline
+    std::vector<std::thread> workers_;
+    bool stopping_;
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_EDF_SCHEDULER_H
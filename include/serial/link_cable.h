@@ -0,0 +1,63 @@
+//
+// Part of the GBLator project.
+//
+// This header declares an in-process link cable between two GameBoy
+// instances. Both consoles are advanced by the cable, one frame per
+// runFrame(), in slices of at most one transfer time (1024 machine
+// cycles). A transfer started by either side cannot complete within the
+// slice it started in, so every completion falls on a slice boundary
+// where both consoles have reached the same cycle and the bytes are
+// exchanged there; within a slice each console runs uninterrupted
+// without looking at the other. No threads or locks are involved.
+
+#ifndef GBLATOR_LINK_CABLE_H
+#define GBLATOR_LINK_CABLE_H
+
+#include <cstdint>
+
+namespace gblator {
+
+class GameBoy;
+class Serial;
+
+/**
+ * @brief Connects the serial ports of two GameBoy instances.
+ *
+ * The console running a transfer on its internal clock shifts its SB
+ * into the other one's and receives the other's SB in return, provided
+ * the other console is waiting on the external clock (SC = 0x80); if not,
+ * it receives 0xFF and the other console is left alone. Instances must not
+ * be run through runFrame() directly while connected, and must outlive
+ * the cable.
+ */
+class LinkCable {
+public:
+    /** Plug the cable into both consoles. */
+    LinkCable(GameBoy& first, GameBoy& second);
+    /** Unplug the cable; later transfers receive 0xFF again. */
+    ~LinkCable();
+
+    LinkCable(const LinkCable&) = delete;
+    LinkCable& operator=(const LinkCable&) = delete;
+
+    /** Run both consoles for one frame, exchanging bytes as transfers complete. */
+    void runFrame();
+
+    /** Bytes exchanged between the consoles so far. */
+    uint64_t exchanges() const;
+    /** Slices run so far (each covers both consoles). */
+    uint64_t slices() const;
+
+private:
+    /** Complete a finished internal clock transfer of master with the other port. */
+    void exchange(Serial& master, Serial& other);
+
+    GameBoy& first_;
+    GameBoy& second_;
+    uint64_t exchanges_;
+    uint64_t slices_;
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_LINK_CABLE_H
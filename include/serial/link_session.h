@@ -0,0 +1,162 @@
+//
+// Part of the GBLator project.
+//
+// This header declares a link session between two processes, each
+// running its own GameBoy, connected by a Unix domain socket. Instead of
+// waiting for the peer at every transferred byte, a session runs ahead
+// optimistically. Every frame is divided into equal slices no longer
+// than one transfer, and at each slice boundary the serial port state of
+// both consoles (SB plus whether a transfer is finished or waiting for
+// the clock) decides the exchange with the same rule as the in-process
+// LinkCable. Unlike the cable, which stops both consoles at the exact
+// completion cycle, a session only exchanges at boundaries, so a
+// transfer finishes up to one slice later than it would in process. The
+// remote state is predicted to be the last one received. Records of the
+// local state are streamed to the peer once per frame. When a record
+// arrives that contradicts a prediction, the session loads the save
+// state taken at the start of that frame and re-simulates up to the
+// present, sending corrections for any of its own records that changed.
+// A session stops to wait for the peer only when it gets too far ahead
+// of the records it has received. POSIX only; elsewhere the session
+// cannot be opened.
+
+#ifndef GBLATOR_LINK_SESSION_H
+#define GBLATOR_LINK_SESSION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gblator {
+
+class GameBoy;
+
+/** Timing of a link session; both ends must use the same values. */
+struct LinkSessionConfig {
+    /**
+     * Exchange points per frame; must divide GameBoy::kCyclesPerFrame into
+     * slices of at most Serial::kTransferCycles (19 gives 924 cycles)
+     */
+    int slicesPerFrame = 19;
+    int maxAheadFrames = 2;    ///< Frames a session may run past the last remote record before waiting
+    int timeoutMs = 5000;      ///< Longest wait for the peer before the session fails
+};
+
+/** Counters of a link session. */
+struct LinkSessionStats {
+    uint64_t slices = 0;             ///< Slices simulated for the first time
+    uint64_t predictedSlices = 0;    ///< Slices first simulated with a predicted remote record
+    uint64_t rollbacks = 0;          ///< Mispredictions that loaded an earlier state
+    uint64_t resimulatedSlices = 0;  ///< Slices simulated again after a rollback
+    uint64_t corrections = 0;        ///< Records resent because re-simulation changed them
+    uint64_t stalls = 0;             ///< Times the session waited for the peer
+    uint64_t stallNs = 0;            ///< Host time spent waiting for the peer
+};
+
+/**
+ * @brief Optimistic link play with a console in another process.
+ *
+ * The GameBoy must stay alive while the session is open and must only be
+ * run through runFrame(); input for a frame is taken from its Joypad when
+ * runFrame() starts and replayed on re-simulation. Performance counters
+ * of the console include re-simulated work.
+ */
+class LinkSession {
+public:
+    LinkSession();
+    /** Closes the session. */
+    ~LinkSession();
+
+    LinkSession(const LinkSession&) = delete;
+    LinkSession& operator=(const LinkSession&) = delete;
+
+    /**
+     * Create a socket at path and wait for one peer to connect.
+     * @return true once the peer is connected and agrees on the configuration
+     */
+    bool listen(const std::string& path, GameBoy& gb, const LinkSessionConfig& config = LinkSessionConfig());
+    /**
+     * Connect to a peer listening at path, retrying until the timeout.
+     * @return true once connected and the peer agrees on the configuration
+     */
+    bool connect(const std::string& path, GameBoy& gb, const LinkSessionConfig& config = LinkSessionConfig());
+    /**
+     * Use an already connected stream socket, e.g. one end of a
+     * socketpair(). The session takes ownership of the descriptor.
+     * @return true once the peer agrees on the configuration
+     */
+    bool attach(int fd, GameBoy& gb, const LinkSessionConfig& config = LinkSessionConfig());
+    /** Disconnect; later transfers of the console receive 0xFF. */
+    void close();
+    bool isOpen() const;
+
+    /**
+     * Run one frame of the console, rolling back first if the peer's
+     * records contradict earlier predictions.
+     * @return false if the peer disconnected, timed out or the session
+     *         lost sync; the session is closed then
+     */
+    bool runFrame();
+
+    const LinkSessionStats& stats() const;
+
+private:
+    /** Serial port state at a slice boundary, as sent to the peer. */
+    struct Record {
+        uint8_t flags = 0;    ///< kDone | kWaiting
+        uint8_t data = 0;     ///< SB
+        bool operator!=(const Record& other) const { return flags != other.flags || data != other.data; }
+    };
+    /** Local bookkeeping of one slice boundary. */
+    struct Boundary {
+        int64_t index = -1;  ///< Boundary number, to detect stale ring entries
+        Record local;        ///< Record sent to the peer
+        int result = -1;     ///< Byte received in the exchange, -1 if none
+    };
+    /** Save state and input at the start of a frame. */
+    struct Frame {
+        int64_t index = -1;
+        uint8_t buttons = 0;
+        std::vector<uint8_t> state;
+    };
+    /** Remote record received for a boundary. */
+    struct Remote {
+        int64_t index = -1;
+        Record record;
+    };
+
+    /** Byte the local end receives at a boundary, or -1 if its transfer does not complete. */
+    static int exchangeResult(const Record& local, const Record& remote);
+    bool handshake();
+    /** Simulate the slice starting at boundary next_; fresh is false when re-simulating. */
+    void simulateSlice(bool fresh, uint8_t buttons);
+    /** Re-simulate from the frame containing the boundary rollbackTo_. */
+    bool rollback();
+    /** Read pending messages; with wait, block until at least one arrives. */
+    bool receive(bool wait);
+    bool handleMessage(const uint8_t* bytes);
+    /** Remote record for a boundary: the one received, or the last received as a prediction. */
+    Record remoteRecord(int64_t boundary) const;
+    void queueRecord(int64_t boundary, const Record& record);
+    bool flush();
+    bool fail();
+
+    GameBoy* gb_;
+    int fd_;
+    LinkSessionConfig config_;
+    int sliceCycles_;
+    bool agreed_;           ///< The peer's hello matched the configuration
+    int64_t next_;          ///< Next boundary to simulate
+    int64_t remoteKnown_;   ///< Highest boundary received from the peer (-1: none)
+    int64_t rollbackTo_;    ///< Earliest boundary whose exchange used a wrong record (-1: none)
+    std::vector<Boundary> boundaries_;
+    std::vector<Frame> frames_;
+    std::vector<Remote> remote_;
+    std::vector<uint8_t> outbox_;   ///< Messages waiting for the next flush
+    std::vector<uint8_t> inbox_;    ///< Bytes of a partially received message
+    LinkSessionStats stats_;
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_LINK_SESSION_H
@@ -0,0 +1,80 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the serial port behind SB (FF01) and SC (FF02).
+// Writing SC with bit 7 set starts a transfer: with the internal clock
+// (SC bit 0) the eight bits are shifted out at 8192 Hz, so the transfer
+// completes 1024 machine cycles later, SB holds the byte received, SC
+// bit 7 is cleared and the serial interrupt is requested. The completion
+// is a scheduled event, so a halted CPU waiting for it is skipped ahead
+// like for the timer. A transfer on the external clock waits for the
+// other console; without a LinkCable nothing arrives and an internal
+// clock transfer receives 0xFF, as with no cable plugged in.
+
+#ifndef GBLATOR_SERIAL_H
+#define GBLATOR_SERIAL_H
+
+#include <cstdint>
+
+namespace gblator {
+
+class Memory;
+class StateWriter;
+class StateReader;
+
+/**
+ * @brief Emulates the serial transfer registers and interrupt.
+ *
+ * When linked, a finished internal clock transfer is not completed by
+ * the port itself; it waits for the LinkCable to exchange bytes with the
+ * other console at the same machine cycle.
+ */
+class Serial {
+public:
+    /** Machine cycles of one transfer: 8 bits at 8192 Hz. */
+    static constexpr int kTransferCycles = 1024;
+
+    explicit Serial(Memory& memory);
+    /** Cancel any transfer and clear SB/SC. */
+    void reset();
+    /**
+     * Advance the port by the given number of machine cycles, starting a
+     * transfer requested through SC and finishing one that is complete.
+     */
+    void step(int cycles);
+    /**
+     * Machine cycles until the running internal clock transfer completes.
+     *
+     * @return Cycles until completion, or INT_MAX when none is running
+     */
+    int cyclesUntilNextEvent() const;
+
+    /** Let a LinkCable complete transfers (true) or complete them with 0xFF (false). */
+    void setLinked(bool linked);
+    /** An internal clock transfer has shifted all bits and waits for the cable. */
+    bool transferDone() const;
+    /** A transfer on the external clock is waiting for the other console. */
+    bool waitingForClock() const;
+    /** Byte in SB, which is shifted out by the next transfer. */
+    uint8_t data() const;
+    /** Finish the current transfer: store the byte received, clear SC bit 7 and request the interrupt. */
+    void completeTransfer(uint8_t received);
+    /** Transfers completed since construction; not part of the save state. */
+    uint64_t transfers() const;
+
+    /** Serialise the transfer progress. */
+    void saveState(StateWriter& writer) const;
+    /** Restore state written by saveState(). */
+    void loadState(StateReader& reader);
+
+private:
+    Memory& memory_;
+    int remaining_;      ///< Machine cycles left in an internal clock transfer, 0 when none runs
+    bool done_;          ///< Internal clock transfer shifted out, waiting for the cable
+    bool linked_;        ///< Completions are left to a LinkCable
+    uint64_t transfers_; ///< Completed transfers
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_SERIAL_H
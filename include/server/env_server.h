@@ -0,0 +1,150 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the shared-memory environment server used by
+// multi-process trainers. The server owns a VectorEnv and exchanges
+// actions, observations, rewards and done flags with a client through one
+// POSIX shared memory segment. Requests and replies are signalled with
+// futexes on two sequence counters in the segment header, so a step costs
+// no sockets, no serialisation and no copies: the VectorEnv writes its
+// results straight into the segment. Only Linux is supported; elsewhere
+// open() and connect() fail.
+
+#ifndef GBLATOR_ENV_SERVER_H
+#define GBLATOR_ENV_SERVER_H
+
+#include "env/vector_env.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace gblator {
+
+/** Commands a client can issue through the segment header. */
+enum class EnvCommand : uint32_t {
+    Step = 1,     ///< Apply actions[] and advance every environment
+    Reset = 2,    ///< Restore every environment to the start state
+    Shutdown = 3  ///< Stop the server
+};
+
+/**
+ * @brief Header at the start of the shared memory segment.
+ *
+ * The header is followed by the arrays it describes, each starting on a
+ * 64-byte boundary: actions (uint8 button mask per environment), rewards
+ * (float per environment), dones (uint8 per environment) and
+ * observations (width × height shades per environment, contiguous).
+ * A client writes actions and command, increments request and wakes it;
+ * the server replies by storing the same value into response.
+ */
+struct EnvShmHeader {
+    std::atomic<uint32_t> magic;     ///< kEnvShmMagic, published last
+    uint32_t version;                ///< kEnvShmVersion
+    uint32_t numEnvs;                ///< Number of environments served
+    uint32_t width;                  ///< Observation width in pixels
+    uint32_t height;                 ///< Observation height in pixels
+    uint32_t command;                ///< EnvCommand of the pending request
+    std::atomic<uint32_t> request;   ///< Incremented by the client per request
+    std::atomic<uint32_t> response;  ///< Set to request by the server when done
+    uint64_t actionsOffset;          ///< Byte offset of the actions array
+    uint64_t rewardsOffset;          ///< Byte offset of the rewards array
+    uint64_t donesOffset;            ///< Byte offset of the dones array
+    uint64_t observationsOffset;     ///< Byte offset of the observations array
+    uint64_t totalSize;              ///< Size of the whole segment
+};
+
+/** "GBLE" in little-endian byte order. */
+constexpr uint32_t kEnvShmMagic = 0x454C4247;
+constexpr uint32_t kEnvShmVersion = 1;
+
+/** Polls of a sequence word before sleeping on its futex. */
+constexpr int kEnvSpinIterations = 4096;
+
+/** Default time a client waits for the server to answer a request. */
+constexpr int kEnvReplyTimeoutMs = 10000;
+
+/**
+ * @brief Serves a VectorEnv over a shared memory segment.
+ *
+ * Episode handling (rewards, done flags, auto-reset) is that of
+ * VectorEnv.
+ */
+class EnvServer {
+public:
+    EnvServer();
+    ~EnvServer();
+
+    /**
+     * Open the environments and create the segment /name holding their
+     * result arrays.
+     * @return true on success
+     */
+    bool open(const std::string& name, const uint8_t* rom, size_t romSize, const EnvConfig& config);
+    /** Handle requests until a client sends EnvCommand::Shutdown. */
+    void serve();
+    /** Unmap and unlink the segment. */
+    void close();
+
+private:
+    VectorEnv env_;
+    std::string name_;
+    EnvShmHeader* header_;
+    size_t mappedSize_;
+};
+
+/**
+ * @brief Client side of an EnvServer segment.
+ *
+ * Fill actions(), call step(), then read rewards(), dones() and
+ * observations() in place until the next request. A request fails if
+ * the server does not answer within the reply timeout, e.g. because it
+ * died; the segment is then in an unknown state and the client should
+ * disconnect.
+ */
+class EnvClient {
+public:
+    EnvClient();
+    ~EnvClient();
+
+    /**
+     * Map the segment /name created by a server.
+     * @param replyTimeoutMs How long each request waits for the server
+     */
+    bool connect(const std::string& name, int replyTimeoutMs = kEnvReplyTimeoutMs);
+    /** Unmap the segment. */
+    void disconnect();
+
+    size_t numEnvs() const;
+    uint8_t* actions();
+    const float* rewards() const;
+    const uint8_t* dones() const;
+    const uint8_t* observations() const;
+
+    /**
+     * Submit actions() and wait for the results.
+     * @return false if the server did not answer in time
+     */
+    bool step();
+    /**
+     * Reset every environment and wait.
+     * @return false if the server did not answer in time
+     */
+    bool reset();
+    /**
+     * Ask the server to stop and wait for its acknowledgement.
+     * @return false if the server did not answer in time
+     */
+    bool shutdown();
+
+private:
+    bool request(EnvCommand command);
+
+    EnvShmHeader* header_;
+    size_t mappedSize_;
+    int replyTimeoutMs_;
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_ENV_SERVER_H
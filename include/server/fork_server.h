@@ -0,0 +1,70 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the fork server used for crash-isolated runs such
+// as fuzzing or untrusted homebrew. The parent loads the ROM once, runs it
+// to a warm-up point and then fork()s one child per job; children share
+// the warmed-up machine copy-on-write and start instantly. Jobs arrive as
+// lines on a control stream and each reply reports the child's exit
+// status and the hash of every frame it completed. POSIX only; elsewhere
+// open() fails.
+
+#ifndef GBLATOR_FORK_SERVER_H
+#define GBLATOR_FORK_SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+
+namespace gblator {
+
+class GameBoy;
+
+/** Warm-up and limits applied to every job. */
+struct ForkServerConfig {
+    int warmupFrames = 0;    ///< Frames run in the parent before serving jobs
+    int timeoutSeconds = 0;  ///< Children running longer are killed by SIGALRM (0: no limit)
+};
+
+/**
+ * @brief Serves emulation jobs from forked copies of a warmed-up machine.
+ *
+ * Protocol: each request line is the path of an input file holding one
+ * joypad button mask (bit per Joypad::Button) per frame. For each
+ * request one reply line is written:
+ *
+ *     exit <code> <frames> <hash>...
+ *     signal <number> <frames> <hash>...
+ *     error <message>
+ *
+ * where each hash is the 16-digit hex FNV-1a hash of a completed frame.
+ * Hashes are streamed from the child as frames complete, so a crashing
+ * job still reports the frames it reached.
+ */
+class ForkServer {
+public:
+    ForkServer();
+    ~ForkServer();
+
+    /**
+     * Load the ROM and run the warm-up frames.
+     * @return true on success
+     */
+    bool open(const uint8_t* rom, size_t romSize, const ForkServerConfig& config);
+
+    /** Handle request lines from in until end of stream. */
+    void serve(std::istream& in, std::ostream& out);
+
+private:
+    /** Fork a child for one job and write its reply. */
+    void runJob(const std::string& inputPath, std::ostream& out);
+
+    ForkServerConfig config_;
+    std::unique_ptr<GameBoy> gb_;
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_FORK_SERVER_H
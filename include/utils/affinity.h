@@ -0,0 +1,36 @@
+//
+// Part of the GBLator project.
+//
+// This header provides small helpers for placing threads on CPUs and
+// finding out which NUMA node they run on. On platforms without the
+// underlying calls the helpers report failure and callers carry on
+// unpinned.
+
+#ifndef GBLATOR_AFFINITY_H
+#define GBLATOR_AFFINITY_H
+
+#include <thread>
+
+namespace gblator {
+
+/** Number of CPUs available to the process (at least 1). */
+unsigned cpuCount();
+
+/**
+ * Restrict a thread to one CPU.
+ * @return true on success
+ */
+bool pinThread(std::thread& thread, unsigned cpu);
+
+/**
+ * Restrict the calling thread to one CPU.
+ * @return true on success
+ */
+bool pinCurrentThread(unsigned cpu);
+
+/** NUMA node of the CPU the calling thread runs on, or -1 if unknown. */
+int currentNumaNode();
+
+} // namespace gblator
+
+#endif // GBLATOR_AFFINITY_H
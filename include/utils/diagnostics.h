@@ -0,0 +1,152 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the diagnostic channel used instead of writing to
+// std::cerr from the emulation loop. A ROM stuck on an unimplemented
+// opcode would otherwise produce one synchronised stream write per
+// instruction. Instead, each instance deduplicates its reports per
+// (kind, opcode, PC), counts repeats, and pushes first occurrences into a
+// lock-free ring that a background logger drains. Reporting never
+// allocates or locks.
+
+#ifndef GBLATOR_DIAGNOSTICS_H
+#define GBLATOR_DIAGNOSTICS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace gblator {
+
+class DiagnosticLogger;
+
+/** What went wrong; values start at 1 so a packed key is never 0. */
+enum class DiagnosticKind : uint8_t {
+    UnimplementedOpcode = 1,
+};
+
+/** One deduplicated report. */
+struct Diagnostic {
+    DiagnosticKind kind;
+    uint8_t opcode;
+    uint16_t pc;  ///< Address of the instruction
+};
+
+/**
+ * @brief Per-instance, single-producer diagnostic channel.
+ *
+ * report() is called from the thread running the instance; drain() and
+ * the repeat counts may be read from one other thread at the same time.
+ */
+class DiagnosticChannel {
+public:
+    /** Distinct (kind, opcode, PC) triples tracked; further ones are only counted as overflow. */
+    static constexpr size_t kTableSize = 256;
+    /** First occurrences buffered until drained; further ones are dropped and counted. */
+    static constexpr size_t kRingSize = 64;
+
+    DiagnosticChannel();
+    /** Detaches from the logger, if any. */
+    ~DiagnosticChannel();
+
+    DiagnosticChannel(const DiagnosticChannel&) = delete;
+    DiagnosticChannel& operator=(const DiagnosticChannel&) = delete;
+
+    /** Record an occurrence; only the first one per (kind, opcode, PC) is queued. */
+    void report(DiagnosticKind kind, uint8_t opcode, uint16_t pc);
+
+    /**
+     * @brief Pop queued first occurrences.
+     *
+     * @param out Destination array
+     * @param capacity Number of entries out can hold
+     * @return Number of diagnostics written
+     */
+    size_t drain(Diagnostic* out, size_t capacity);
+
+    /** Occurrences of a (kind, opcode, PC) triple so far (0 if never reported or untracked). */
+    uint64_t count(DiagnosticKind kind, uint8_t opcode, uint16_t pc) const;
+    /** Distinct triples tracked. */
+    size_t distinct() const;
+    /** First occurrences lost because the ring was full. */
+    uint64_t dropped() const;
+    /** Occurrences of triples that did not fit into the table. */
+    uint64_t overflow() const;
+
+private:
+    friend class DiagnosticLogger;
+
+    struct Entry {
+        std::atomic<uint32_t> key{0};   ///< Packed (kind, opcode, PC); 0 when free
+        std::atomic<uint64_t> count{0};
+    };
+
+    Entry table_[kTableSize];
+    Diagnostic ring_[kRingSize];
+    std::atomic<uint32_t> head_;   ///< Written by the producer
+    std::atomic<uint32_t> tail_;   ///< Written by the consumer
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> overflow_;
+    std::atomic<DiagnosticLogger*> logger_; ///< Logger draining this channel, if any
+};
+
+/**
+ * @brief Background thread writing diagnostics from attached channels.
+ *
+ * Each first occurrence is written as one line prefixed with the label
+ * the channel was attached with. When a channel is detached (explicitly,
+ * by its destruction or by the logger's), a summary line is written for
+ * every triple that repeated.
+ */
+class DiagnosticLogger {
+public:
+    /**
+     * @param out Destination stream; only the logger thread writes to it
+     * @param interval How often the channels are drained
+     */
+    explicit DiagnosticLogger(std::ostream& out,
+                              std::chrono::milliseconds interval = std::chrono::milliseconds(100));
+    /** Detaches every channel and stops the thread. */
+    ~DiagnosticLogger();
+
+    DiagnosticLogger(const DiagnosticLogger&) = delete;
+    DiagnosticLogger& operator=(const DiagnosticLogger&) = delete;
+
+    /** Start draining a channel; a channel can be attached to one logger at a time. */
+    void attach(DiagnosticChannel& channel, const std::string& label);
+    /** Drain and summarise a channel, then stop draining it. */
+    void detach(DiagnosticChannel& channel);
+    /** Drain every channel now, from the calling thread. */
+    void flush();
+
+private:
+    struct Source {
+        DiagnosticChannel* channel;
+        std::string label;
+    };
+
+    void run();
+    /** Write the channel's queued diagnostics; requires mutex_. */
+    void drainLocked(const Source& source);
+    /** Write repeat counts of a channel; requires mutex_. */
+    void summariseLocked(const Source& source);
+
+    std::ostream& out_;
+    std::chrono::milliseconds interval_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<Source> sources_;
+    bool stopping_;
+    std::thread thread_;
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_DIAGNOSTICS_H
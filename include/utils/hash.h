@@ -0,0 +1,38 @@
+//
+// Part of the GBLator project.
+//
+// This header provides the 64-bit FNV-1a hash used to fingerprint frames
+// and save states, e.g. when comparing runs for determinism.
+
+#ifndef GBLATOR_HASH_H
+#define GBLATOR_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gblator {
+
+/** FNV-1a offset basis; pass a previous result to continue hashing. */
+constexpr uint64_t kHashSeed = 0xCBF29CE484222325ull;
+
+/**
+ * @brief Hash a block of bytes with 64-bit FNV-1a.
+ *
+ * @param data Bytes to hash
+ * @param size Number of bytes
+ * @param seed kHashSeed, or the hash of preceding data
+ * @return The updated hash
+ */
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = kHashSeed) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+} // namespace gblator
+
+#endif // GBLATOR_HASH_H
@@ -0,0 +1,88 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the host hardware performance counters sampled
+// around GameBoy::runFrame(). On Linux they are opened with
+// perf_event_open for the calling thread, counting user-space events
+// only. Kernels that forbid access (perf_event_paranoid, containers) or
+// CPUs without a given event leave that event unavailable; it then reads
+// as zero and nothing else changes.
+
+#ifndef GBLATOR_HW_COUNTERS_H
+#define GBLATOR_HW_COUNTERS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gblator {
+
+/** Host events that can be counted. */
+enum class HwEvent : uint8_t {
+    Cycles,
+    Instructions,
+    BranchMisses,
+    L1dMisses,   ///< L1 data cache read misses
+    LlcMisses,   ///< Last-level cache read misses
+    Count
+};
+
+/** Event counts over some interval, indexed by HwEvent. */
+struct HwSample {
+    uint64_t values[static_cast<size_t>(HwEvent::Count)] = {};
+    uint64_t emulatedInstructions = 0; ///< Guest instructions executed in the interval
+
+    uint64_t operator[](HwEvent event) const { return values[static_cast<size_t>(event)]; }
+};
+
+/**
+ * @brief Set of per-thread host counters read at frame boundaries.
+ *
+ * The counters follow the thread that called open(); frames run on any
+ * other thread are not measured. Reading them costs one system call per
+ * available event and does not allocate.
+ */
+class HardwareCounters {
+public:
+    HardwareCounters();
+    /** Closes the counters. */
+    ~HardwareCounters();
+
+    HardwareCounters(const HardwareCounters&) = delete;
+    HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+    /**
+     * @brief Open every event for the calling thread.
+     *
+     * @return true if at least one event could be opened
+     */
+    bool open();
+    /** Close all events; totals are kept. */
+    void close();
+    /** Whether any event is open. */
+    bool isOpen() const;
+    /** Whether one event is open. */
+    bool available(HwEvent event) const;
+
+    /** Start an interval. */
+    void begin();
+    /** End the interval started by begin() and add it to the totals. */
+    void end(uint64_t emulatedInstructions);
+
+    /** Counts of the last completed interval. */
+    const HwSample& last() const;
+    /** Counts of all completed intervals. */
+    const HwSample& total() const;
+
+private:
+    /** Current (multiplexing-scaled) value of an event. */
+    uint64_t read(size_t index) const;
+
+    int fds_[static_cast<size_t>(HwEvent::Count)];
+    uint64_t start_[static_cast<size_t>(HwEvent::Count)];
+    HwSample last_;
+    HwSample total_;
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_HW_COUNTERS_H
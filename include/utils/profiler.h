@@ -0,0 +1,76 @@
+//
+// Part of the GBLator project.
+//
+// This header declares the host-side instrumentation layer. Zones mark
+// the begin and end of major phases (CPU run slices, PPU line renders,
+// APU catch-up, DMA, save states, frame hand-off) and are stored in
+// per-thread ring buffers, then exported in the Chrome Trace Event format
+// for chrome://tracing or Perfetto.
+//
+// Zones are only compiled in when GBLATOR_PROFILE is defined (CMake
+// option GBLATOR_PROFILE). Otherwise GBLATOR_ZONE expands to nothing and
+// the hot paths are unchanged. The recording and export functions are
+// always available.
+
+#ifndef GBLATOR_PROFILER_H
+#define GBLATOR_PROFILER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+namespace gblator {
+
+/** Events kept per thread; older events are overwritten. */
+constexpr size_t kProfileRingCapacity = 1 << 16;
+
+/** Host monotonic time in nanoseconds. */
+uint64_t profileNow();
+
+/**
+ * @brief Record a completed zone on the calling thread's ring buffer.
+ *
+ * @param name Zone name; must be a string literal or otherwise outlive
+ * the export
+ * @param beginNs Start time from profileNow()
+ * @param endNs End time from profileNow()
+ */
+void profileRecord(const char* name, uint64_t beginNs, uint64_t endNs);
+
+/**
+ * @brief Write every recorded zone as Chrome Trace Event JSON.
+ *
+ * Threads should be quiescent (not recording) while exporting.
+ */
+void writeChromeTrace(std::ostream& out);
+
+/** Discard all recorded zones. Threads should be quiescent. */
+void clearProfile();
+
+/** RAII zone recording its lifetime; use through GBLATOR_ZONE. */
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name) : name_(name), begin_(profileNow()) {}
+    ~ProfileZone() { profileRecord(name_, begin_, profileNow()); }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name_;
+    uint64_t begin_;
+};
+
+} // namespace gblator
+
+#define GBLATOR_ZONE_CONCAT_(a, b) a##b
+#define GBLATOR_ZONE_CONCAT(a, b) GBLATOR_ZONE_CONCAT_(a, b)
+
+#if defined(GBLATOR_PROFILE)
+/** Record the enclosing scope as a zone with the given name. */
+#define GBLATOR_ZONE(name) ::gblator::ProfileZone GBLATOR_ZONE_CONCAT(gblatorZone_, __LINE__)(name)
+#else
+#define GBLATOR_ZONE(name) ((void)0)
+#endif
+
+#endif // GBLATOR_PROFILER_H
@@ -0,0 +1,75 @@
+//
+// Part of the GBLator project.
+//
+// This header declares a small cartridge image builder and the synthetic
+// ROMs built with it. Commercial ROMs cannot be shipped with the
+// project, so benchmarks and tests run these instead: each one is a
+// valid cartridge (Nintendo logo, header and global checksums) whose
+// program loops forever on one kind of workload.
+
+#ifndef GBLATOR_ROM_BUILDER_H
+#define GBLATOR_ROM_BUILDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace gblator {
+
+/**
+ * @brief Assembles a cartridge image byte by byte.
+ *
+ * Code is emitted at a current position given as an offset into the
+ * image; for offsets beyond the first bank, here() reports the address
+ * the byte has when its bank is mapped at 4000–7FFF. The entry point at
+ * 0100 jumps to 0150, where the program is expected to start.
+ */
+class RomBuilder {
+public:
+    /**
+     * @param cartType Cartridge type byte (0x00 ROM only, 0x01–0x03 MBC1, ...)
+     * @param romSizeCode ROM size byte; the image holds 2 << code banks of 16 KiB
+     * @param ramSizeCode RAM size byte
+     */
+    explicit RomBuilder(uint8_t cartType = 0x00, uint8_t romSizeCode = 0x00, uint8_t ramSizeCode = 0x00);
+
+    /** Move the current position to an offset into the image. */
+    RomBuilder& org(size_t offset);
+    /** Emit bytes at the current position. */
+    RomBuilder& emit(std::initializer_list<uint8_t> bytes);
+    /** Emit JR (opcode 0x18) or JR cc (0x20, 0x28, 0x30, 0x38) to an address. */
+    RomBuilder& jr(uint8_t opcode, uint16_t target);
+    /** CPU address of the current position. */
+    uint16_t here() const;
+    /** Set the title stored in the header (at most 16 characters). */
+    RomBuilder& title(const char* text);
+
+    /** The image with the header and both checksums filled in. */
+    std::vector<uint8_t> build() const;
+
+private:
+    std::vector<uint8_t> image_;
+    size_t position_;
+};
+
+/** Workloads available as synthetic ROMs. */
+enum class SyntheticWorkload {
+    AluLoop,          ///< Register arithmetic in a tight loop
+    MemoryTraffic,    ///< HL-indirect read-modify-write over 4 KiB of WRAM
+    BankSwitchStorm,  ///< MBC1 ROM bank selection and a read from every bank
+    VramUpload,       ///< Tile data copied to VRAM in the VBlank handler
+    HaltFrames,       ///< HALT until VBlank, counting frames in FF80
+    CbBitOps,         ///< CB-prefixed rotates, shifts, BIT, RES and SET
+    Count
+};
+
+/** Short name of a workload, e.g. "alu_loop". */
+const char* syntheticWorkloadName(SyntheticWorkload workload);
+
+/** Build the cartridge image of a workload. */
+std::vector<uint8_t> makeSyntheticROM(SyntheticWorkload workload);
+
+} // namespace gblator
+
+#endif // GBLATOR_ROM_BUILDER_H
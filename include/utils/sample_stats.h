@@ -0,0 +1,66 @@
+//
+// Part of the GBLator project.
+//
+// This header provides the statistics used to summarise and compare
+// timing samples: nearest-rank percentiles and the one-sided
+// Mann-Whitney U test the benchmark suite uses to decide whether a
+// benchmark got slower than a stored baseline.
+
+#ifndef GBLATOR_SAMPLE_STATS_H
+#define GBLATOR_SAMPLE_STATS_H
+
+#include <vector>
+
+namespace gblator {
+
+/**
+ * Nearest-rank percentile: the smallest value such that at least
+ * @p fraction of the samples are less than or equal to it.
+ * @param sorted Samples in ascending order; must not be empty
+ * @param fraction Percentile in [0, 1]
+ */
+double nearestRankPercentile(const std::vector<double>& sorted, double fraction);
+
+/**
+ * One-sided Mann-Whitney U test: probability of seeing @p current at
+ * least this much larger than @p baseline if both came from the same
+ * distribution. Uses the normal approximation with tie and continuity
+ * corrections, which is adequate from about eight samples each; returns
+ * 1 when either side is empty or every sample is tied.
+ */
+double slowerPValue(const std::vector<double>& baseline, const std::vector<double>& current);
+
+/** Outcome of comparing one benchmark against its baseline. */
+enum class SampleVerdict {
+    Unchanged,  ///< Median moved by no more than the threshold
+    Regression, ///< Slower beyond the threshold and significant
+    Improved,   ///< Faster beyond the threshold and significant
+    Noise       ///< Moved beyond the threshold but not significant
+};
+
+/** Result of compareSamples(). */
+struct SampleComparison {
+    double baselineMedian = 0;
+    double currentMedian = 0;
+    double changePercent = 0; ///< Change of the median relative to the baseline
+    double pValue = 1;        ///< Smaller of the two one-sided p-values
+    SampleVerdict verdict = SampleVerdict::Unchanged;
+};
+
+/**
+ * Compare two sets of samples (lower is better). A regression needs
+ * the median to grow by more than @p thresholdPercent and the
+ * slowdown to be significant at @p alpha; improvements are judged the
+ * same way in the other direction.
+ * @param baseline Baseline samples; must not be empty
+ * @param current Current samples; must not be empty
+ */
+SampleComparison compareSamples(const std::vector<double>& baseline, const std::vector<double>& current,
+                                double thresholdPercent, double alpha);
+
+/** Name of a verdict as printed by the benchmark suite. */
+const char* sampleVerdictName(SampleVerdict verdict);
+
+} // namespace gblator
+
+#endif // GBLATOR_SAMPLE_STATS_H
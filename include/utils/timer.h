@@ -15,6 +15,8 @@
 namespace gblator {
 
 class Memory;
+class StateWriter;
+class StateReader;
 
 /**
  * @brief Emulates the Game Boy’s timer and divider registers.
@@ -37,6 +39,25 @@ public:
      */
     void step(int cycles);
 
+    /**
+     * Number of CPU cycles until TIMA next overflows and requests the
+     * timer interrupt.
+     *
+     * @return Cycles until overflow, or INT_MAX while the timer is disabled
+     */
+    int cyclesUntilOverflow() const;
+
+    /**
+     * Number of CPU cycles until DIV or TIMA next increments. Stepping the
+     * timer by less than this only advances its internal counters.
+     */
+    int cyclesUntilNextIncrement() const;
+
+    /** Serialise the internal cycle counters. */
+    void saveState(StateWriter& writer) const;
+    /** Restore state written by saveState(). */
+    void loadState(StateReader& reader);
+
 private:
     Memory& memory_;
     int divCounter_;   ///< Counts CPU cycles until DIV increments
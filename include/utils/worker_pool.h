@@ -0,0 +1,77 @@
+//
+// Part of the GBLator project.
+//
+// This header declares a small pool of persistent worker threads used to
+// spread independent per-instance work (one GameBoy per index) across
+// cores. The calling thread takes part in every batch, so a pool of one
+// thread runs everything inline with no synchronisation at all.
+
+#ifndef GBLATOR_WORKER_POOL_H
+#define GBLATOR_WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gblator {
+
+/**
+ * @brief Runs batches of indexed tasks on persistent threads.
+ *
+ * Indices are handed out dynamically, so uneven per-index costs balance
+ * themselves. Dispatch takes a plain function pointer and context rather
+ * than std::function so that running a batch never allocates.
+ */
+class WorkerPool {
+public:
+    using Task = void (*)(void* context, size_t index);
+
+    /**
+     * @brief Create a pool.
+     *
+     * @param threads Total threads including the caller (values below 1 mean 1)
+     */
+    explicit WorkerPool(int threads);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /** Total number of threads taking part in a batch, including the caller. */
+    int size() const;
+
+    /**
+     * @brief Call task(context, i) for every i in [0, count) and wait.
+     */
+    void run(size_t count, Task task, void* context);
+
+    /** Convenience wrapper running a callable fn(i) for every index. */
+    template <typename Fn>
+    void forEach(size_t count, Fn& fn) {
+        run(count, [](void* context, size_t index) { (*static_cast<Fn*>(context))(index); }, &fn);
+    }
+
+private:
+    void workerLoop();
+    void drain();
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    uint64_t generation_;    ///< Incremented for every batch
+    bool stopping_;          ///< Set when the pool is destroyed
+    size_t active_;          ///< Workers still busy with the current batch
+    Task task_;              ///< Task of the current batch
+    void* context_;          ///< Context of the current batch
+    size_t count_;           ///< Number of indices in the current batch
+    std::atomic<size_t> next_; ///< Next index to hand out
+};
+
+} // namespace gblator
+
+#endif // GBLATOR_WORKER_POOL_H
@@ -4,13 +4,26 @@
 
 #include "apu/apu.h"
 #include "mmu/memory.h"
+#include "core/state.h"
+#include "utils/profiler.h"
+#include <cstring>
 
 namespace gblator {
 
-APU::APU(Memory& memory) : memory_(memory) {
+namespace {
+
+// CPU cycles per output sample (1048576 Hz / 32768 Hz)
+constexpr int kCyclesPerSample = 32;
+
+} // namespace
+
+APU::APU(Memory& memory) : memory_(memory), sampleCounter_(0), sampleCount_(0) {
+    std::memset(samples_, 0, sizeof(samples_));
 }
 
 void APU::reset() {
+    sampleCounter_ = 0;
+    sampleCount_ = 0;
     // Reset audio registers to power-on defaults
     // NR50, NR51, NR52 are global control registers
     memory_.writeByte(0xFF24, 0x00); // NR50
@@ -22,9 +35,43 @@ void APU::reset() {
     }
 }
 
-void APU::step(int /*cycles*/) {
-    // Stub: A real APU would generate sound samples here.
-    // This stub does nothing but could process envelopes and length timers.
+void APU::step(int cycles) {
+    GBLATOR_ZONE("apu_catch_up");
+    // Stub: A real APU would mix the four channels here. This stub only
+    // keeps the sample clock running and emits silence.
+    sampleCounter_ += cycles;
+    while (sampleCounter_ >= kCyclesPerSample) {
+        sampleCounter_ -= kCyclesPerSample;
+        if (sampleCount_ < kMaxSamples) {
+            samples_[sampleCount_ * 2] = 0;
+            samples_[sampleCount_ * 2 + 1] = 0;
+            ++sampleCount_;
+        }
+    }
+}
+
+int APU::cyclesUntilNextSample() const {
+    return kCyclesPerSample - sampleCounter_;
+}
+
+const int16_t* APU::samples() const {
+    return samples_;
+}
+
+size_t APU::sampleCount() const {
+    return sampleCount_;
+}
+
+void APU::clearSamples() {
+    sampleCount_ = 0;
+}
+
+void APU::saveState(StateWriter& writer) const {
+    writer.value(sampleCounter_);
+}
+
+void APU::loadState(StateReader& reader) {
+    reader.value(sampleCounter_);
 }
 
 } // namespace gblator
\ No newline at end of file
@@ -0,0 +1,166 @@
+//
+// Implementation of the C interface declared in gblator_c.h
+//
+
+#include "capi/gblator_c.h"
+#include "core/core.h"
+#include "apu/apu.h"
+#include "joypad/joypad.h"
+#include "mmu/memory.h"
+#include "ppu/ppu.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <string>
+
+// The opaque handle is the GameBoy itself; no wrapper state is needed
+struct gblator_instance : gblator::GameBoy {};
+
+static_assert(GBLATOR_SCREEN_WIDTH == gblator::PPU::kScreenWidth, "screen width mismatch");
+static_assert(GBLATOR_SCREEN_HEIGHT == gblator::PPU::kScreenHeight, "screen height mismatch");
+static_assert(GBLATOR_REGION_VRAM0 == static_cast<int>(gblator::Memory::Region::VRAM0) &&
+              GBLATOR_REGION_HRAM == static_cast<int>(gblator::Memory::Region::HRAM),
+              "region numbering mismatch");
+
+extern "C" {
+
+uint32_t gblator_api_version(void) {
+    return GBLATOR_C_API_VERSION;
+}
+
+gblator_instance* gblator_create(void) {
+    return new (std::nothrow) gblator_instance();
+}
+
+void gblator_destroy(gblator_instance* gb) {
+    delete gb;
+}
+
+int gblator_load_rom(gblator_instance* gb, const uint8_t* data, size_t size) {
+    // Exceptions must not cross the C boundary
+    try {
+        return gb->loadROM(data, size) ? 1 : 0;
+    } catch (...) {
+        return 0;
+    }
+}
+
+int gblator_load_rom_borrowed(gblator_instance* gb, const uint8_t* data, size_t size) {
+    if (data == nullptr) {
+        return 0;
+    }
+    try {
+        return gb->loadROM(std::span<const uint8_t>(data, size), gblator::RomOwnership::Borrow) ? 1 : 0;
+    } catch (...) {
+        return 0;
+    }
+}
+
+int gblator_load_rom_fd(gblator_instance* gb, int fd) {
+    try {
+        return gb->loadROMFromFd(fd) ? 1 : 0;
+    } catch (...) {
+        return 0;
+    }
+}
+
+void gblator_reset(gblator_instance* gb) {
+    gb->reset();
+}
+
+void gblator_step_frames(gblator_instance* gb, int frames) {
+    gb->apu().clearSamples();
+    for (int i = 0; i < frames; ++i) {
+        gb->runFrame();
+    }
+}
+
+void gblator_set_input(gblator_instance* gb, uint8_t buttons) {
+    gb->joypad().setButtons(buttons);
+}
+
+size_t gblator_state_size(const gblator_instance* gb) {
+    return gb->stateSize();
+}
+
+int gblator_save_state(const gblator_instance* gb, void* dst, size_t size) {
+    return gb->saveState(static_cast<uint8_t*>(dst), size) ? 1 : 0;
+}
+
+int gblator_load_state(gblator_instance* gb, const void* src, size_t size) {
+    return gb->loadState(static_cast<const uint8_t*>(src), size) ? 1 : 0;
+}
+
+const uint8_t* gblator_framebuffer(const gblator_instance* gb) {
+    return const_cast<gblator_instance*>(gb)->ppu().frameBuffer();
+}
+
+const int16_t* gblator_audio_buffer(const gblator_instance* gb, size_t* samples, int* sample_rate) {
+    gblator::APU& apu = const_cast<gblator_instance*>(gb)->apu();
+    if (samples != nullptr) {
+        *samples = apu.sampleCount();
+    }
+    if (sample_rate != nullptr) {
+        *sample_rate = gblator::APU::kSampleRate;
+    }
+    return apu.samples();
+}
+
+uint8_t* gblator_memory_region(gblator_instance* gb, int region, size_t* size) {
+    size_t regionSize = 0;
+    uint8_t* data = nullptr;
+    if (region >= GBLATOR_REGION_VRAM0 && region <= GBLATOR_REGION_HRAM) {
+        data = gb->memory().regionData(static_cast<gblator::Memory::Region>(region), regionSize);
+    }
+    if (size != nullptr) {
+        *size = regionSize;
+    }
+    return data;
+}
+
+void gblator_get_counters(const gblator_instance* gb, gblator_counters* counters) {
+    gblator::PerfCounters source = gb->counters();
+    counters->cycles = source.cycles;
+    counters->instructions = source.instructions;
+    counters->frames = source.frames;
+    counters->interrupts = source.interrupts;
+    counters->bank_switches = source.bankSwitches;
+    counters->dma_transfers = source.dmaTransfers;
+    counters->halted_cycles = source.haltedCycles;
+    counters->idle_skip_cycles = source.idleSkipCycles;
+    counters->block_cache_hits = source.blockCacheHits;
+    counters->block_cache_misses = source.blockCacheMisses;
+    counters->host_ns_last_frame = source.hostNsLastFrame;
+    counters->host_ns_total = source.hostNsTotal;
+}
+
+int gblator_enable_hw_counters(gblator_instance* gb) {
+    return gb->enableHardwareCounters() ? 1 : 0;
+}
+
+size_t gblator_counters_text(const gblator_instance* gb, int format, char* buf, size_t size) {
+    // Building the text allocates; exceptions must not cross the C boundary
+    try {
+        std::ostringstream text;
+        if (format == GBLATOR_COUNTERS_PROMETHEUS) {
+            gblator::writeCountersPrometheus(gb->counters(), text);
+        } else {
+            gblator::writeCountersJson(gb->counters(), text);
+        }
+        const std::string& result = text.str();
+        if (buf != nullptr && size > 0) {
+            size_t length = std::min(result.size(), size - 1);
+            std::memcpy(buf, result.data(), length);
+            buf[length] = '\0';
+        }
+        return result.size();
+    } catch (...) {
+        if (buf != nullptr && size > 0) {
+            buf[0] = '\0';
+        }
+        return 0;
+    }
+}
+
+} // extern "C"
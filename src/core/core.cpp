@@ -0,0 +1,485 @@
+//
+// Implementation of the GameBoy class declared in core.h
+//
+
+#include "core/core.h"
+#include "core/guest_trace.h"
+#include "core/input_latency.h"
+#include "core/state.h"
+#include "apu/apu.h"
+#include "cpu/cpu.h"
+#include "joypad/joypad.h"
+#include "mmu/memory.h"
+#include "ppu/ppu.h"
+#include "serial/serial.h"
+#include "utils/profiler.h"
+#include "utils/timer.h"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+namespace gblator {
+
+namespace {
+
+// Save-state header: "GBLS" followed by a format version
+constexpr uint32_t kStateMagic = 0x534C4247;
+constexpr uint32_t kStateVersion = 2;
+
+// Component tasks: each sleeps until its component's registers next
+// change, then steps it over the cycles that actually elapsed, which may
+// be fewer when a register write woke it early
+GBLATOR_TASKS_BEGIN
+
+ComponentTask ppuTask(CycleScheduler& scheduler, PPU& ppu) {
+    for (;;) {
+        int elapsed = co_await scheduler.sleep(ppu.cyclesUntilNextChange());
+        if (elapsed > 0) {
+            ppu.step(elapsed);
+        }
+    }
+}
+
+ComponentTask timerTask(CycleScheduler& scheduler, Timer& timer) {
+    for (;;) {
+        // The timer counts clock cycles, four per machine cycle
+        int elapsed = co_await scheduler.sleep((timer.cyclesUntilNextIncrement() + 3) / 4);
+        if (elapsed > 0) {
+            timer.step(elapsed * 4);
+        }
+    }
+}
+
+ComponentTask apuTask(CycleScheduler& scheduler, APU& apu) {
+    for (;;) {
+        int elapsed = co_await scheduler.sleep(apu.cyclesUntilNextSample());
+        if (elapsed > 0) {
+            apu.step(elapsed);
+        }
+    }
+}
+
+GBLATOR_TASKS_END
+
+} // namespace
+
+GameBoy::GameBoy()
+    : cpu_(memory_), ppu_(memory_), timer_(memory_), apu_(memory_), joypad_(memory_), serial_(memory_),
+      frameCycles_(0), idleCycles_(0), cycles_(0), frames_(0), hostNsLastFrame_(0), hostNsTotal_(0),
+      realTime_(false), engine_(CpuEngine::Interpreter), frameStart_(Clock::now()) {
+    // Access statistics only cover instructions; see stepCpu()
+    memory_.setAccessCounting(false);
+    // Ties between tasks resume in this order, the order they used to be stepped in
+    bool spawned = scheduler_.spawn(ppuTask(scheduler_, ppu_));
+    spawned = scheduler_.spawn(timerTask(scheduler_, timer_)) && spawned;
+    spawned = scheduler_.spawn(apuTask(scheduler_, apu_)) && spawned;
+    if (!spawned) {
+        // A component that never runs would silently freeze the machine;
+        // the frames only fail to fit if CycleScheduler::kArenaSize is too
+        // small for this compiler and its flags
+        std::fprintf(stderr, "GBLator: component tasks do not fit the scheduler arena (%zu of %zu bytes)\n",
+                     scheduler_.arenaUsed(), CycleScheduler::kArenaSize);
+        std::abort();
+    }
+    memory_.setScheduler(&scheduler_);
+    scheduler_.restart();
+}
+
+GameBoy::~GameBoy() = default;
+
+bool GameBoy::loadROM(const std::string& filepath) {
+    if (!memory_.loadROM(filepath)) {
+        return false;
+    }
+    reset();
+    return true;
+}
+
+bool GameBoy::loadROM(const uint8_t* data, size_t size) {
+    if (!memory_.loadROM(data, size)) {
+        return false;
+    }
+    reset();
+    return true;
+}
+
+bool GameBoy::loadROM(std::span<const uint8_t> rom, RomOwnership ownership) {
+    if (!memory_.loadROM(rom, ownership)) {
+        return false;
+    }
+    reset();
+    return true;
+}
+
+bool GameBoy::loadROMFromFd(int fd) {
+    if (!memory_.loadROMFromFd(fd)) {
+        return false;
+    }
+    reset();
+    return true;
+}
+
+void GameBoy::reset() {
+    // The register writes below must not wake the tasks mid-reset
+    memory_.setScheduler(nullptr);
+    memory_.reset();
+    cpu_.reset();
+    ppu_.reset();
+    timer_.reset();
+    apu_.reset();
+    joypad_.reset();
+    serial_.reset();
+    // The boot ROM leaves the LCD on with the background enabled and the
+    // default palette loaded before jumping to 0x0100
+    memory_.writeByte(0xFF40, 0x91); // LCDC
+    memory_.writeByte(0xFF47, 0xFC); // BGP
+    memory_.setScheduler(&scheduler_);
+    scheduler_.restart();
+    frameCycles_ = 0;
+    frameStart_ = Clock::now();
+}
+
+void GameBoy::tick(int cycles, bool idle) {
+    cycles_ += static_cast<uint64_t>(cycles);
+    if (GuestTrace* trace = memory_.trace()) {
+        // Component events are stamped at the end of this step, which is
+        // also where the next instruction starts
+        trace->setCycle(cycles_);
+    }
+    if (InputLatency* probe = memory_.latencyProbe()) {
+        probe->setCycle(cycles_);
+    }
+    if (idle) {
+        scheduler_.jumpTo(cycles_);
+    } else {
+        scheduler_.advance(cycles_);
+    }
+    serial_.step(cycles);
+}
+
+int GameBoy::stepCpu() {
+    // Host reads of P1 (tools, servers, tests) must not count as the guest observing an input
+    memory_.setCpuAccess(true);
+#if defined(GBLATOR_MEMORY_STATS)
+    memory_.setAccessCounting(true);
+    int cycles = cpu_.step();
+    memory_.setAccessCounting(false);
+#else
+    int cycles = cpu_.step();
+#endif
+    memory_.setCpuAccess(false);
+    return cycles;
+}
+
+void GameBoy::runBatched(int frameCycle) {
+    memory_.setCpuAccess(true);
+    // Serial::step() leaves an idle port alone until SC requests a
+    // transfer, so it is skipped until then; the first step resyncs
+    bool serialActive = true;
+    do {
+        int cycles = cpu_.step();
+        cycles_ += static_cast<uint64_t>(cycles);
+        frameCycles_ += cycles;
+        scheduler_.advance(cycles_);
+        if (serialActive || (memory_.serialControl() & 0x80) != 0) {
+            serial_.step(cycles);
+            serialActive = (memory_.serialControl() & 0x80) != 0;
+        }
+    } while (frameCycles_ < frameCycle && !cpu_.halted());
+    memory_.setCpuAccess(false);
+}
+
+int GameBoy::cyclesUntilNextEvent() const {
+    int cycles = ppu_.cyclesUntilNextEvent();
+    int timerCycles = timer_.cyclesUntilOverflow();
+    if (timerCycles != INT_MAX) {
+        // Round clock cycles up to whole machine cycles
+        cycles = std::min(cycles, (timerCycles + 3) / 4);
+    }
+    return std::min(cycles, serial_.cyclesUntilNextEvent());
+}
+
+GameBoy::Clock::time_point GameBoy::deadlineFor(int frameCycle) const {
+    int64_t ns = static_cast<int64_t>(frameCycle) * 1000000000 / kCyclesPerSecond;
+    return frameStart_ + std::chrono::nanoseconds(ns);
+}
+
+void GameBoy::run(int instructionCount) {
+    for (int i = 0; i < instructionCount; ++i) {
+        tick(stepCpu());
+    }
+    scheduler_.syncAll();
+}
+
+void GameBoy::runFrame() {
+    bool measureHost = hwCounters_.isOpen();
+    uint64_t instructionsStart = cpu_.instructions();
+    if (measureHost) {
+        hwCounters_.begin();
+    }
+    Clock::time_point hostStart = Clock::now();
+    if (realTime_) {
+        // If the host fell more than a frame behind, resynchronise rather
+        // than racing through frames to catch up
+        Clock::time_point now = Clock::now();
+        if (now > deadlineFor(kCyclesPerFrame)) {
+            frameStart_ = now;
+        }
+    }
+    Clock::duration slept = advanceTo(kCyclesPerFrame);
+    // Carry any overshoot of the last instruction into the next frame
+    frameCycles_ -= kCyclesPerFrame;
+    ++frames_;
+    // Host time is taken before the final pacing sleep, which is not work
+    uint64_t hostNs = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - hostStart - slept).count());
+    hostNsLastFrame_ = hostNs;
+    hostNsTotal_ += hostNs;
+    if (measureHost) {
+        // Counters exclude the kernel, so sleeping adds nothing to them
+        hwCounters_.end(cpu_.instructions() - instructionsStart);
+    }
+    if (realTime_) {
+        Clock::time_point deadline = deadlineFor(kCyclesPerFrame);
+        std::this_thread::sleep_until(deadline);
+        frameStart_ = deadline;
+    }
+}
+
+void GameBoy::runFrameUntil(int frameCycle) {
+    advanceTo(std::min(frameCycle, kCyclesPerFrame));
+}
+
+int GameBoy::frameCycle() const {
+    return frameCycles_;
+}
+
+GameBoy::Clock::duration GameBoy::advanceTo(int frameCycle) {
+    Clock::duration slept = Clock::duration::zero();
+    while (frameCycles_ < frameCycle) {
+        if (cpu_.halted() && !cpu_.interruptPending()) {
+            // Nothing can happen until a component raises an interrupt, so
+            // jump straight to the next event (or the end of the run)
+            scheduler_.syncAll();
+            int skip = std::min(cyclesUntilNextEvent(), frameCycle - frameCycles_);
+            skip = std::max(skip, 1);
+            tick(skip, true);
+            frameCycles_ += skip;
+            idleCycles_ += static_cast<uint64_t>(skip);
+            if (realTime_) {
+                Clock::time_point sleepStart = Clock::now();
+                std::this_thread::sleep_until(deadlineFor(frameCycles_));
+                slept += Clock::now() - sleepStart;
+            }
+            continue;
+        }
+        // Run instructions until the CPU halts or the target is reached;
+        // observers need the interpreter's per-instruction hooks
+        GBLATOR_ZONE("cpu_slice");
+        if (engine_ == CpuEngine::Batched && memory_.trace() == nullptr && memory_.latencyProbe() == nullptr) {
+            runBatched(frameCycle);
+            continue;
+        }
+        do {
+            int cycles = stepCpu();
+            tick(cycles);
+            frameCycles_ += cycles;
+        } while (frameCycles_ < frameCycle && !cpu_.halted());
+    }
+    // Leave every component caught up for save states and front ends
+    scheduler_.syncAll();
+    return slept;
+}
+
+void GameBoy::setRealTime(bool enabled) {
+    realTime_ = enabled;
+    frameStart_ = Clock::now();
+}
+
+bool GameBoy::realTime() const {
+    return realTime_;
+}
+
+bool GameBoy::setEngine(CpuEngine engine) {
+    if (!cpuEngineAvailable(engine)) {
+        return false;
+    }
+    engine_ = engine;
+    return true;
+}
+
+CpuEngine GameBoy::engine() const {
+    return engine_;
+}
+
+uint64_t GameBoy::idleCycles() const {
+    return idleCycles_;
+}
+
+void GameBoy::setTrace(GuestTrace* trace) {
+    memory_.setTrace(trace);
+    if (trace != nullptr) {
+        trace->setCycle(cycles_);
+    }
+}
+
+void GameBoy::setLatencyProbe(InputLatency* probe) {
+    memory_.setLatencyProbe(probe);
+    if (probe != nullptr) {
+        probe->setCycle(cycles_);
+    }
+}
+
+PerfCounters GameBoy::counters() const {
+    PerfCounters counters;
+    counters.cycles = cycles_;
+    counters.instructions = cpu_.instructions();
+    counters.frames = frames_;
+    counters.interrupts = cpu_.interruptsTaken();
+    counters.bankSwitches = memory_.bankSwitches();
+    counters.dmaTransfers = memory_.dmaTransfers();
+    counters.haltedCycles = cpu_.haltedCycles();
+    counters.idleSkipCycles = idleCycles_;
+    counters.hostNsLastFrame = hostNsLastFrame_;
+    counters.hostNsTotal = hostNsTotal_;
+    const HwSample& total = hwCounters_.total();
+    counters.hostCycles = total[HwEvent::Cycles];
+    counters.hostInstructions = total[HwEvent::Instructions];
+    counters.hostBranchMisses = total[HwEvent::BranchMisses];
+    counters.hostL1dMisses = total[HwEvent::L1dMisses];
+    counters.hostLlcMisses = total[HwEvent::LlcMisses];
+    const HwSample& last = hwCounters_.last();
+    if (last[HwEvent::Cycles] != 0) {
+        counters.hostIpcLastFrame = static_cast<double>(last[HwEvent::Instructions]) / last[HwEvent::Cycles];
+    }
+    if (last.emulatedInstructions != 0) {
+        double instructions = static_cast<double>(last.emulatedInstructions);
+        counters.branchMissesPerInstruction = last[HwEvent::BranchMisses] / instructions;
+        counters.l1dMissesPerInstruction = last[HwEvent::L1dMisses] / instructions;
+        counters.llcMissesPerInstruction = last[HwEvent::LlcMisses] / instructions;
+    }
+    return counters;
+}
+
+bool GameBoy::enableHardwareCounters() {
+    return hwCounters_.open();
+}
+
+void GameBoy::disableHardwareCounters() {
+    hwCounters_.close();
+}
+
+const HardwareCounters& GameBoy::hardwareCounters() const {
+    return hwCounters_;
+}
+
+void GameBoy::writeState(StateWriter& writer) const {
+    writer.section("Header");
+    writer.value(kStateMagic);
+    writer.value(kStateVersion);
+    writer.value(frameCycles_);
+    memory_.saveState(writer);
+    writer.section("CPU");
+    cpu_.saveState(writer);
+    writer.section("PPU");
+    ppu_.saveState(writer);
+    writer.section("Timer");
+    timer_.saveState(writer);
+    writer.section("APU");
+    apu_.saveState(writer);
+    writer.section("Joypad");
+    joypad_.saveState(writer);
+    writer.section("Serial");
+    serial_.saveState(writer);
+}
+
+std::vector<StateSection> GameBoy::stateLayout() const {
+    std::vector<StateSection> layout;
+    StateWriter counter;
+    counter.setLayout(&layout);
+    writeState(counter);
+    for (size_t i = 0; i < layout.size(); ++i) {
+        size_t end = i + 1 < layout.size() ? layout[i + 1].offset : counter.size();
+        layout[i].size = end - layout[i].offset;
+    }
+    return layout;
+}
+
+size_t GameBoy::stateSize() const {
+    StateWriter counter;
+    writeState(counter);
+    return counter.size();
+}
+
+bool GameBoy::saveState(uint8_t* data, size_t size) const {
+    if (data == nullptr) {
+        return false;
+    }
+    GBLATOR_ZONE("save_state");
+    StateWriter writer(data, size);
+    writeState(writer);
+    return writer.ok();
+}
+
+bool GameBoy::loadState(const uint8_t* data, size_t size) {
+    // Validate the header and size up front so a bad state is rejected
+    // before any component has been modified
+    if (data == nullptr || size != stateSize()) {
+        return false;
+    }
+    GBLATOR_ZONE("load_state");
+    StateReader reader(data, size);
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    reader.value(magic);
+    reader.value(version);
+    int frameCycles = 0;
+    reader.value(frameCycles);
+    // Only the cartridge RAM size can still mismatch; with it checked
+    // every read below is in bounds, so no component is half loaded
+    if (magic != kStateMagic || version != kStateVersion || !memory_.acceptsState(reader)) {
+        return false;
+    }
+    frameCycles_ = frameCycles;
+    memory_.loadState(reader);
+    cpu_.loadState(reader);
+    ppu_.loadState(reader);
+    timer_.loadState(reader);
+    apu_.loadState(reader);
+    joypad_.loadState(reader);
+    serial_.loadState(reader);
+    scheduler_.restart();
+    return reader.ok() && reader.position() == size;
+}
+
+Memory& GameBoy::memory() {
+    return memory_;
+}
+
+CPU& GameBoy::cpu() {
+    return cpu_;
+}
+
+PPU& GameBoy::ppu() {
+    return ppu_;
+}
+
+Timer& GameBoy::timer() {
+    return timer_;
+}
+
+APU& GameBoy::apu() {
+    return apu_;
+}
+
+Joypad& GameBoy::joypad() {
+    return joypad_;
+}
+
+Serial& GameBoy::serial() {
+    return serial_;
+}
+
+} // namespace gblator
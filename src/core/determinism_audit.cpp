@@ -0,0 +1,73 @@
+//
+// Implementation of the determinism audit declared in determinism_audit.h
+//
+
+#include "core/determinism_audit.h"
+#include "core/core.h"
+#include "utils/hash.h"
+#include <barrier>
+#include <memory>
+#include <thread>
+
+namespace gblator {
+
+AuditResult auditDeterminism(std::span<const uint8_t> rom, std::span<const uint8_t> inputs,
+                             const AuditConfig& config) {
+    AuditResult result;
+    std::unique_ptr<GameBoy> consoles[2] = {std::make_unique<GameBoy>(), std::make_unique<GameBoy>()};
+    const CpuEngine engines[2] = {config.firstEngine, config.secondEngine};
+    for (int i = 0; i < 2; ++i) {
+        if (!consoles[i]->loadROM(rom, RomOwnership::Borrow) || !consoles[i]->setEngine(engines[i])) {
+            return result;
+        }
+    }
+    result.ok = true;
+    result.layout = consoles[0]->stateLayout();
+    int frames = config.frames > 0 ? config.frames : static_cast<int>(inputs.size());
+    result.hashes.reserve(static_cast<size_t>(frames));
+
+    // Each run saves into its own buffer; the barrier's completion step
+    // compares them while both threads wait, so no locking is needed
+    std::vector<uint8_t> states[2];
+    uint64_t hashes[2] = {0, 0};
+    for (std::vector<uint8_t>& state : states) {
+        state.resize(consoles[0]->stateSize());
+    }
+    bool stop = frames <= 0;
+    auto compare = [&]() noexcept {
+        ++result.framesCompared;
+        if (hashes[0] != hashes[1]) {
+            result.divergedFrame = result.framesCompared - 1;
+            stop = true;
+        } else {
+            result.hashes.push_back(hashes[0]);
+            stop = result.framesCompared == frames;
+        }
+    };
+    std::barrier sync(2, compare);
+    auto run = [&](int index) {
+        GameBoy& gb = *consoles[index];
+        for (int frame = 0; !stop; ++frame) {
+            if (config.beforeFrame) {
+                config.beforeFrame(index, gb, frame);
+            }
+            gb.joypad().setButtons(static_cast<size_t>(frame) < inputs.size() ? inputs[frame] : 0);
+            gb.runFrame();
+            gb.saveState(states[index].data(), states[index].size());
+            hashes[index] = hashBytes(states[index].data(), states[index].size());
+            sync.arrive_and_wait();
+        }
+    };
+    std::thread second(run, 1);
+    run(0);
+    second.join();
+
+    if (result.divergedFrame >= 0) {
+        result.first = std::move(states[0]);
+        result.second = std::move(states[1]);
+        result.diff = diffStates(result.layout, result.first, result.second);
+    }
+    return result;
+}
+
+} // namespace gblator
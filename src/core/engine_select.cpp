@@ -0,0 +1,148 @@
+//
+// Implementation of the EngineSelector class.
+//
+
+#include "core/engine_select.h"
+#include "core/core.h"
+#include "utils/hash.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+namespace gblator {
+
+namespace {
+
+// Frames each trial runs before timing starts
+constexpr int kWarmupFrames = 10;
+
+} // namespace
+
+EngineSelector::EngineSelector(int trialFrames) : trialFrames_(std::max(trialFrames, 1)) {
+}
+
+bool EngineSelector::loadCache(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        return true;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string hash;
+        std::string name;
+        if (!(fields >> hash >> name)) {
+            return false;
+        }
+        char* end = nullptr;
+        uint64_t romHash = std::strtoull(hash.c_str(), &end, 16);
+        if (end == hash.c_str() || *end != '\0') {
+            return false;
+        }
+        CpuEngine engine;
+        if (parseCpuEngine(name, engine) && cpuEngineAvailable(engine)) {
+            cache_[romHash] = engine;
+        }
+    }
+    return true;
+}
+
+bool EngineSelector::saveCache(const std::string& path) const {
+    std::ofstream out(path, std::ios::trunc);
+    for (const auto& [romHash, engine] : cache_) {
+        char hash[17];
+        std::snprintf(hash, sizeof(hash), "%016" PRIx64, romHash);
+        out << hash << " " << cpuEngineName(engine) << "\n";
+    }
+    return static_cast<bool>(out);
+}
+
+EngineChoice EngineSelector::select(GameBoy& gb) {
+    EngineChoice choice;
+    std::span<const uint8_t> rom = gb.memory().romImage();
+    choice.romHash = hashBytes(rom.data(), rom.size());
+    auto cached = cache_.find(choice.romHash);
+    if (cached != cache_.end()) {
+        choice.engine = cached->second;
+        choice.cached = true;
+        gb.setEngine(choice.engine);
+        return choice;
+    }
+
+    std::vector<CpuEngine> engines = availableEngines();
+    if (engines.size() > 1) {
+        std::vector<uint8_t> snapshot(gb.stateSize());
+        gb.saveState(snapshot.data(), snapshot.size());
+        for (CpuEngine engine : engines) {
+            EngineTrial result;
+            if (trial(rom, snapshot, engine, result)) {
+                choice.trials.push_back(result);
+            }
+        }
+        // The interpreter is the reference every other engine must match
+        const EngineTrial* best = nullptr;
+        for (EngineTrial& result : choice.trials) {
+            result.agrees = result.stateHash == choice.trials.front().stateHash;
+            if (result.agrees && (best == nullptr || result.bestFrameNs < best->bestFrameNs)) {
+                best = &result;
+            }
+        }
+        if (best != nullptr) {
+            choice.engine = best->engine;
+        }
+    }
+    cache_[choice.romHash] = choice.engine;
+    gb.setEngine(choice.engine);
+    return choice;
+}
+
+std::vector<CpuEngine> EngineSelector::availableEngines() {
+    std::vector<CpuEngine> engines;
+    for (int i = 0; i < kCpuEngines; ++i) {
+        if (cpuEngineAvailable(static_cast<CpuEngine>(i))) {
+            engines.push_back(static_cast<CpuEngine>(i));
+        }
+    }
+    return engines;
+}
+
+bool EngineSelector::trial(std::span<const uint8_t> rom, const std::vector<uint8_t>& snapshot, CpuEngine engine,
+                           EngineTrial& result) const {
+    // Heap-allocated: a machine is too large to keep on a worker's stack
+    auto scratch = std::make_unique<GameBoy>();
+    if (!scratch->loadROM(rom, RomOwnership::Borrow) || !scratch->loadState(snapshot.data(), snapshot.size()) ||
+        !scratch->setEngine(engine)) {
+        return false;
+    }
+    // Untimed frames first, so caches and branch predictors are warm for
+    // every engine alike
+    for (int i = 0; i < kWarmupFrames; ++i) {
+        scratch->runFrame();
+    }
+    // The fastest frame is the least disturbed by the host; every engine
+    // runs the same frames, so the comparison stays fair
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < trialFrames_; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        scratch->runFrame();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, static_cast<uint64_t>(
+                                  std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    }
+    std::vector<uint8_t> state(scratch->stateSize());
+    scratch->saveState(state.data(), state.size());
+    result.engine = engine;
+    result.bestFrameNs = best;
+    result.stateHash = hashBytes(state.data(), state.size());
+    return true;
+}
+
+} // namespace gblator
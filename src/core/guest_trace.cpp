@@ -0,0 +1,158 @@
+//
+// Implementation of the GuestTrace class.
+//
+
+#include "core/guest_trace.h"
+#include "core/core.h"
+#include <ostream>
+
+namespace gblator {
+
+namespace {
+
+const char* const kInterruptNames[] = {"VBlank", "STAT", "Timer", "Serial", "Joypad"};
+
+// Track (tid) of each event kind in the exported trace
+enum Track { kTrackCpu = 1, kTrackInterrupts, kTrackPpu, kTrackTimer, kTrackCartridge };
+
+const char* const kTrackNames[] = {"", "CPU", "Interrupts", "PPU", "Timer", "Cartridge"};
+
+int trackOf(GuestEvent type) {
+    switch (type) {
+    case GuestEvent::InterruptRequested: return kTrackInterrupts;
+    case GuestEvent::PpuMode:
+    case GuestEvent::LycMatch:
+    case GuestEvent::LcdOn:
+    case GuestEvent::LcdOff: return kTrackPpu;
+    case GuestEvent::TimerOverflow: return kTrackTimer;
+    case GuestEvent::BankSwitch:
+    case GuestEvent::OamDma: return kTrackCartridge;
+    default: return kTrackCpu;
+    }
+}
+
+// Emulated microseconds with nanosecond resolution
+void writeTimestamp(std::ostream& out, uint64_t cycle) {
+    uint64_t ns = cycle * 1000000000ull / static_cast<uint64_t>(GameBoy::kCyclesPerSecond);
+    uint64_t fraction = ns % 1000;
+    out << ns / 1000 << '.' << static_cast<char>('0' + fraction / 100)
+        << static_cast<char>('0' + fraction / 10 % 10) << static_cast<char>('0' + fraction % 10);
+}
+
+void writeHex(std::ostream& out, unsigned value, int digits) {
+    static const char kDigits[] = "0123456789ABCDEF";
+    out << "0x";
+    for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4) {
+        out << kDigits[(value >> shift) & 0xF];
+    }
+}
+
+} // namespace
+
+GuestTrace::GuestTrace(size_t capacity)
+    : events_(capacity > 0 ? capacity : 1), count_(0), cycle_(0), mask_(kAllGuestEvents), watched_{0, 0} {
+}
+
+void GuestTrace::setMask(uint32_t mask) {
+    mask_ = mask;
+}
+
+uint32_t GuestTrace::mask() const {
+    return mask_;
+}
+
+void GuestTrace::watchRegister(uint16_t address, bool watch) {
+    if (address < 0xFF00 || address >= 0xFF80) {
+        return;
+    }
+    unsigned index = address - 0xFF00u;
+    uint64_t bit = 1ull << (index % 64);
+    if (watch) {
+        watched_[index / 64] |= bit;
+    } else {
+        watched_[index / 64] &= ~bit;
+    }
+}
+
+void GuestTrace::setCycle(uint64_t cycle) {
+    cycle_ = cycle;
+}
+
+void GuestTrace::record(GuestEvent type, uint8_t value, uint16_t address) {
+    if ((mask_ & guestEventBit(type)) == 0) {
+        return;
+    }
+    if (type == GuestEvent::IoWrite) {
+        unsigned index = address - 0xFF00u;
+        if (index >= 0x80 || (watched_[index / 64] & (1ull << (index % 64))) == 0) {
+            return;
+        }
+    }
+    GuestEventRecord& event = events_[count_ % events_.size()];
+    event.cycle = cycle_;
+    event.type = type;
+    event.value = value;
+    event.address = address;
+    event.reserved = 0;
+    ++count_;
+}
+
+size_t GuestTrace::size() const {
+    return count_ < events_.size() ? static_cast<size_t>(count_) : events_.size();
+}
+
+uint64_t GuestTrace::dropped() const {
+    return count_ - size();
+}
+
+const GuestEventRecord& GuestTrace::at(size_t index) const {
+    uint64_t first = count_ - size();
+    return events_[(first + index) % events_.size()];
+}
+
+void GuestTrace::clear() {
+    count_ = 0;
+}
+
+void GuestTrace::writePerfettoJson(std::ostream& out) const {
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    for (int track = kTrackCpu; track <= kTrackCartridge; ++track) {
+        out << (track == kTrackCpu ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << track << ",\"args\":{\"name\":\"" << kTrackNames[track] << "\"}}";
+    }
+    for (size_t i = 0; i < size(); ++i) {
+        const GuestEventRecord& event = at(i);
+        if (event.type == GuestEvent::PpuMode) {
+            // Counter track showing the mode over time
+            out << ",\n{\"name\":\"ppu_mode\",\"ph\":\"C\",\"pid\":1,\"tid\":" << kTrackPpu << ",\"ts\":";
+            writeTimestamp(out, event.cycle);
+            out << ",\"args\":{\"mode\":" << static_cast<int>(event.value) << "}}";
+            continue;
+        }
+        out << ",\n{\"name\":\"";
+        switch (event.type) {
+        case GuestEvent::InterruptRequested:
+        case GuestEvent::InterruptServiced:
+            out << (event.type == GuestEvent::InterruptRequested ? "request " : "service ")
+                << (event.value < 5 ? kInterruptNames[event.value] : "?");
+            break;
+        case GuestEvent::LycMatch: out << "LYC match"; break;
+        case GuestEvent::TimerOverflow: out << "TIMA overflow"; break;
+        case GuestEvent::BankSwitch: out << "bank switch"; break;
+        case GuestEvent::OamDma: out << "OAM DMA"; break;
+        case GuestEvent::LcdOn: out << "LCD on"; break;
+        case GuestEvent::LcdOff: out << "LCD off"; break;
+        case GuestEvent::IoWrite: out << "write "; writeHex(out, event.address, 4); break;
+        default: out << "event"; break;
+        }
+        out << "\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":" << trackOf(event.type) << ",\"ts\":";
+        writeTimestamp(out, event.cycle);
+        out << ",\"args\":{\"cycle\":" << event.cycle << ",\"value\":" << static_cast<int>(event.value)
+            << ",\"address\":\"";
+        writeHex(out, event.address, 4);
+        out << "\"}}";
+    }
+    out << "\n]}\n";
+}
+
+} // namespace gblator
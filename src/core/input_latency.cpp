@@ -0,0 +1,140 @@
+//
+// Implementation of the InputLatency class.
+//
+
+#include "core/input_latency.h"
+#include "core/core.h"
+#include "utils/sample_stats.h"
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+
+namespace gblator {
+
+namespace {
+
+void writeDistribution(std::ostream& out, const char* name, const LatencyDistribution& d) {
+    out << '"' << name << "\":{\"samples\":" << d.samples
+        << ",\"frames\":{\"p50\":" << d.p50Frames << ",\"p90\":" << d.p90Frames
+        << ",\"p99\":" << d.p99Frames << ",\"max\":" << d.maxFrames << '}'
+        << ",\"us\":{\"p50\":" << d.p50Us << ",\"p90\":" << d.p90Us
+        << ",\"p99\":" << d.p99Us << ",\"max\":" << d.maxUs << "}}";
+}
+
+} // namespace
+
+InputLatency::InputLatency(size_t capacity, int maxFrames)
+    : recorded_(), maxFrames_(maxFrames), cycle_(0), inputs_(0), superseded_(0), timedOut_(0),
+      pending_(false), observed_(false), changed_(0), framesWaited_(0), inputCycle_(0) {
+    for (std::vector<Sample>& samples : samples_) {
+        samples.resize(std::max<size_t>(capacity, 1));
+    }
+}
+
+void InputLatency::setCycle(uint64_t cycle) {
+    cycle_ = cycle;
+}
+
+void InputLatency::inputChanged(uint8_t previous, uint8_t buttons) {
+    if (pending_) {
+        ++superseded_;
+    }
+    ++inputs_;
+    pending_ = true;
+    observed_ = false;
+    changed_ = static_cast<uint8_t>(previous ^ buttons);
+    framesWaited_ = 0;
+    inputCycle_ = cycle_;
+    inputTime_ = Clock::now();
+}
+
+void InputLatency::joypadRead(uint8_t visible) {
+    if (!pending_ || observed_) {
+        return;
+    }
+    if ((changed_ & visible) != 0) {
+        observed_ = true;
+        record(LatencyStage::InputToRead);
+    }
+}
+
+void InputLatency::framePresented(const uint8_t* frame, const uint8_t* previous, size_t size) {
+    if (!pending_) {
+        return;
+    }
+    if (std::memcmp(frame, previous, size) != 0) {
+        record(LatencyStage::InputToFrame);
+        pending_ = false;
+    } else if (++framesWaited_ >= maxFrames_) {
+        ++timedOut_;
+        pending_ = false;
+    }
+}
+
+void InputLatency::record(LatencyStage stage) {
+    size_t index = static_cast<size_t>(stage);
+    std::vector<Sample>& samples = samples_[index];
+    Sample& sample = samples[recorded_[index] % samples.size()];
+    sample.cycles = cycle_ - inputCycle_;
+    sample.ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - inputTime_).count());
+    ++recorded_[index];
+}
+
+LatencyDistribution InputLatency::distribution(LatencyStage stage) const {
+    size_t index = static_cast<size_t>(stage);
+    const std::vector<Sample>& samples = samples_[index];
+    LatencyDistribution result;
+    size_t count = static_cast<size_t>(std::min<uint64_t>(recorded_[index], samples.size()));
+    result.samples = count;
+    if (count == 0) {
+        return result;
+    }
+    std::vector<double> frames(count);
+    std::vector<double> us(count);
+    for (size_t i = 0; i < count; ++i) {
+        frames[i] = static_cast<double>(samples[i].cycles) / GameBoy::kCyclesPerFrame;
+        us[i] = static_cast<double>(samples[i].ns) / 1000.0;
+    }
+    std::sort(frames.begin(), frames.end());
+    std::sort(us.begin(), us.end());
+    result.p50Frames = nearestRankPercentile(frames, 0.50);
+    result.p90Frames = nearestRankPercentile(frames, 0.90);
+    result.p99Frames = nearestRankPercentile(frames, 0.99);
+    result.maxFrames = frames.back();
+    result.p50Us = nearestRankPercentile(us, 0.50);
+    result.p90Us = nearestRankPercentile(us, 0.90);
+    result.p99Us = nearestRankPercentile(us, 0.99);
+    result.maxUs = us.back();
+    return result;
+}
+
+uint64_t InputLatency::inputs() const {
+    return inputs_;
+}
+
+uint64_t InputLatency::superseded() const {
+    return superseded_;
+}
+
+uint64_t InputLatency::timedOut() const {
+    return timedOut_;
+}
+
+void InputLatency::clear() {
+    std::fill(std::begin(recorded_), std::end(recorded_), 0);
+    inputs_ = 0;
+    superseded_ = 0;
+    timedOut_ = 0;
+    pending_ = false;
+}
+
+void InputLatency::writeJson(std::ostream& out) const {
+    out << "{\"inputs\":" << inputs_ << ",\"superseded\":" << superseded_ << ",\"timed_out\":" << timedOut_ << ',';
+    writeDistribution(out, "input_to_read", distribution(LatencyStage::InputToRead));
+    out << ',';
+    writeDistribution(out, "input_to_frame", distribution(LatencyStage::InputToFrame));
+    out << '}';
+}
+
+} // namespace gblator
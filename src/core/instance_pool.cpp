@@ -0,0 +1,143 @@
+//
+// Implementation of the InstancePool class.
+//
+
+#include "core/instance_pool.h"
+#include "core/core.h"
+#include "utils/affinity.h"
+#include <new>
+#include <thread>
+
+namespace gblator {
+
+namespace {
+
+// Instances start on cache-line boundaries so neighbours never share one
+constexpr size_t kCacheLine = 64;
+
+} // namespace
+
+InstancePool::InstancePool()
+    : stride_((sizeof(GameBoy) + kCacheLine - 1) / kCacheLine * kCacheLine) {
+}
+
+InstancePool::~InstancePool() {
+    close();
+}
+
+bool InstancePool::open(const uint8_t* rom, size_t romSize, const InstancePoolConfig& config) {
+    close();
+    if (rom == nullptr || romSize == 0 || config.cores < 1 || config.instancesPerCore < 1) {
+        return false;
+    }
+    // The image is read-only once loaded, so one copy serves every instance
+    rom_.assign(rom, rom + romSize);
+    for (int i = 0; i < config.cores; ++i) {
+        cores_.emplace_back(new Core());
+    }
+    // Build every arena in parallel, each from a thread on its own CPU:
+    // with or without an explicit NUMA binding, first touch then places
+    // the pages on that CPU's node
+    unsigned cpus = cpuCount();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < config.cores; ++i) {
+        threads.emplace_back(&InstancePool::setupCore, this, std::ref(*cores_[i]),
+                             static_cast<unsigned>(i) % cpus, config.instancesPerCore);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const auto& core : cores_) {
+        if (!core->ok) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void InstancePool::setupCore(Core& core, unsigned cpu, int instances) {
+    pinCurrentThread(cpu);
+    if (!core.arena.map(stride_ * static_cast<size_t>(instances), currentNumaNode())) {
+        return;
+    }
+    core.free.reserve(static_cast<size_t>(instances));
+    for (int i = 0; i < instances; ++i) {
+        GameBoy* gb = new (static_cast<uint8_t*>(core.arena.data()) + stride_ * core.count) GameBoy();
+        ++core.count;
+        if (!gb->loadROM(rom_, RomOwnership::Borrow)) {
+            return;
+        }
+        core.free.push_back(gb);
+    }
+    core.ok = true;
+}
+
+void InstancePool::close() {
+    for (auto& core : cores_) {
+        for (size_t i = 0; i < core->count; ++i) {
+            instanceAt(*core, i)->~GameBoy();
+        }
+        core->arena.unmap();
+    }
+    cores_.clear();
+    // Only once no instance reads it any more
+    rom_.clear();
+    rom_.shrink_to_fit();
+}
+
+GameBoy* InstancePool::instanceAt(const Core& core, size_t index) const {
+    return reinterpret_cast<GameBoy*>(static_cast<uint8_t*>(core.arena.data()) + stride_ * index);
+}
+
+GameBoy* InstancePool::acquire(int core) {
+    if (core < 0 || core >= cores()) {
+        return nullptr;
+    }
+    Core& c = *cores_[static_cast<size_t>(core)];
+    std::lock_guard<std::mutex> lock(c.mutex);
+    if (c.free.empty()) {
+        return nullptr;
+    }
+    GameBoy* gb = c.free.back();
+    c.free.pop_back();
+    return gb;
+}
+
+void InstancePool::release(GameBoy* gb) {
+    for (auto& core : cores_) {
+        if (core->arena.contains(gb)) {
+            // Recycle rather than destroy: reset keeps the ROM and every
+            // buffer, so the next acquire() is free
+            gb->setRealTime(false);
+            gb->reset();
+            std::lock_guard<std::mutex> lock(core->mutex);
+            core->free.push_back(gb);
+            return;
+        }
+    }
+}
+
+int InstancePool::cores() const {
+    return static_cast<int>(cores_.size());
+}
+
+size_t InstancePool::available(int core) const {
+    if (core < 0 || core >= cores()) {
+        return 0;
+    }
+    const Core& c = *cores_[static_cast<size_t>(core)];
+    std::lock_guard<std::mutex> lock(c.mutex);
+    return c.free.size();
+}
+
+bool InstancePool::hugePages() const {
+    for (const auto& core : cores_) {
+        if (!core->arena.hugePages()) {
+            return false;
+        }
+    }
+    return !cores_.empty();
+}
+
+} // namespace gblator
@@ -0,0 +1,100 @@
+//
+// Implementation of the performance counter writers.
+//
+
+#include "core/perf_counters.h"
+#include <ostream>
+
+namespace gblator {
+
+namespace {
+
+struct CounterField {
+    const char* name;
+    uint64_t PerfCounters::*value;
+    const char* type; ///< Prometheus metric type
+    const char* help;
+};
+
+// One table drives both output formats so they can never disagree
+const CounterField kFields[] = {
+    {"cycles", &PerfCounters::cycles, "counter", "Emulated machine cycles"},
+    {"instructions", &PerfCounters::instructions, "counter", "Instructions executed"},
+    {"frames", &PerfCounters::frames, "counter", "Frames completed"},
+    {"interrupts", &PerfCounters::interrupts, "counter", "Interrupts dispatched"},
+    {"bank_switches", &PerfCounters::bankSwitches, "counter", "Bank selection changes"},
+    {"dma_transfers", &PerfCounters::dmaTransfers, "counter", "OAM DMA transfers"},
+    {"halted_cycles", &PerfCounters::haltedCycles, "counter", "Halted cycles stepped individually"},
+    {"idle_skip_cycles", &PerfCounters::idleSkipCycles, "counter", "Halted cycles skipped to the next event"},
+    {"block_cache_hits", &PerfCounters::blockCacheHits, "counter", "Block cache hits"},
+    {"block_cache_misses", &PerfCounters::blockCacheMisses, "counter", "Block cache misses"},
+    {"host_ns_last_frame", &PerfCounters::hostNsLastFrame, "gauge", "Host nanoseconds spent on the last frame"},
+    {"host_ns_total", &PerfCounters::hostNsTotal, "counter", "Host nanoseconds spent running frames"},
+    {"host_cycles", &PerfCounters::hostCycles, "counter", "Host CPU cycles spent running frames"},
+    {"host_instructions", &PerfCounters::hostInstructions, "counter", "Host instructions retired running frames"},
+    {"host_branch_misses", &PerfCounters::hostBranchMisses, "counter", "Host branch mispredictions running frames"},
+    {"host_l1d_misses", &PerfCounters::hostL1dMisses, "counter", "Host L1 data cache read misses running frames"},
+    {"host_llc_misses", &PerfCounters::hostLlcMisses, "counter", "Host last-level cache read misses running frames"},
+};
+
+struct RatioField {
+    const char* name;
+    double PerfCounters::*value;
+    const char* help;
+};
+
+// Derived per-frame ratios, always exported as gauges
+const RatioField kRatios[] = {
+    {"host_ipc_last_frame", &PerfCounters::hostIpcLastFrame, "Host instructions per cycle in the last frame"},
+    {"branch_misses_per_instruction", &PerfCounters::branchMissesPerInstruction,
+     "Host branch misses per emulated instruction in the last frame"},
+    {"l1d_misses_per_instruction", &PerfCounters::l1dMissesPerInstruction,
+     "Host L1D read misses per emulated instruction in the last frame"},
+    {"llc_misses_per_instruction", &PerfCounters::llcMissesPerInstruction,
+     "Host LLC read misses per emulated instruction in the last frame"},
+};
+
+} // namespace
+
+void writeCountersJson(const PerfCounters& counters, std::ostream& out) {
+    out << '{';
+    bool first = true;
+    for (const CounterField& field : kFields) {
+        out << (first ? "" : ",") << '"' << field.name << "\":" << counters.*field.value;
+        first = false;
+    }
+    for (const RatioField& field : kRatios) {
+        out << ",\"" << field.name << "\":" << counters.*field.value;
+    }
+    out << '}';
+}
+
+void writeCountersPrometheus(const PerfCounters& counters, std::ostream& out, const std::string& labels) {
+    for (const CounterField& field : kFields) {
+        const char* suffix = field.type[0] == 'c' ? "_total" : "";
+        // Avoid "host_ns_total_total" for fields already named as totals
+        std::string name = std::string("gblator_") + field.name;
+        if (name.size() >= 6 && name.compare(name.size() - 6, 6, "_total") == 0) {
+            suffix = "";
+        }
+        out << "# HELP " << name << suffix << ' ' << field.help << '\n';
+        out << "# TYPE " << name << suffix << ' ' << field.type << '\n';
+        out << name << suffix;
+        if (!labels.empty()) {
+            out << '{' << labels << '}';
+        }
+        out << ' ' << counters.*field.value << '\n';
+    }
+    for (const RatioField& field : kRatios) {
+        std::string name = std::string("gblator_") + field.name;
+        out << "# HELP " << name << ' ' << field.help << '\n';
+        out << "# TYPE " << name << " gauge\n";
+        out << name;
+        if (!labels.empty()) {
+            out << '{' << labels << '}';
+        }
+        out << ' ' << counters.*field.value << '\n';
+    }
+}
+
+} // namespace gblator
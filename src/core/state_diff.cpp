@@ -0,0 +1,189 @@
+//
+// Implementation of the save-state comparison declared in state_diff.h
+//
+
+#include "core/state_diff.h"
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace gblator {
+
+namespace {
+
+// First index at or after from where the buffers agree, or size
+size_t findMatch(const uint8_t* a, const uint8_t* b, size_t from, size_t size) {
+#if defined(__SSE2__)
+    while (from + 16 <= size) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + from));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + from));
+        unsigned equal = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+        if (equal != 0) {
+            return from + static_cast<size_t>(std::countr_zero(equal));
+        }
+        from += 16;
+    }
+#elif defined(__aarch64__)
+    while (from + 16 <= size) {
+        uint8x16_t equal = vceqq_u8(vld1q_u8(a + from), vld1q_u8(b + from));
+        if (vmaxvq_u8(equal) != 0) {
+            break;
+        }
+        from += 16;
+    }
+#else
+    // Eight bytes at a time: a word differs in every byte unless some
+    // byte of x ^ y is zero
+    while (from + 8 <= size) {
+        uint64_t x;
+        uint64_t y;
+        std::memcpy(&x, a + from, sizeof(x));
+        std::memcpy(&y, b + from, sizeof(y));
+        uint64_t diff = x ^ y;
+        if (((diff - 0x0101010101010101ull) & ~diff & 0x8080808080808080ull) != 0) {
+            break;
+        }
+        from += 8;
+    }
+#endif
+    while (from < size && a[from] != b[from]) {
+        ++from;
+    }
+    return from;
+}
+
+// Section label such as "WRAM bank 1"
+std::string sectionLabel(const StateSection& section) {
+    std::string label = section.name;
+    if (section.bank >= 0) {
+        label += " bank " + std::to_string(section.bank);
+    }
+    return label;
+}
+
+} // namespace
+
+size_t findDifference(const uint8_t* a, const uint8_t* b, size_t from, size_t size) {
+#if defined(__SSE2__)
+    while (from + 16 <= size) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + from));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + from));
+        unsigned equal = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+        if (equal != 0xFFFF) {
+            return from + static_cast<size_t>(std::countr_zero(~equal));
+        }
+        from += 16;
+    }
+#elif defined(__aarch64__)
+    while (from + 16 <= size) {
+        uint8x16_t equal = vceqq_u8(vld1q_u8(a + from), vld1q_u8(b + from));
+        if (vminvq_u8(equal) != 0xFF) {
+            break;
+        }
+        from += 16;
+    }
+#else
+    // Eight bytes at a time
+    while (from + 8 <= size) {
+        uint64_t x;
+        uint64_t y;
+        std::memcpy(&x, a + from, sizeof(x));
+        std::memcpy(&y, b + from, sizeof(y));
+        if (x != y) {
+            break;
+        }
+        from += 8;
+    }
+#endif
+    while (from < size && a[from] == b[from]) {
+        ++from;
+    }
+    return from;
+}
+
+StateDiff diffStates(const std::vector<StateSection>& layout, std::span<const uint8_t> a,
+                     std::span<const uint8_t> b) {
+    StateDiff diff;
+    if (a.size() != b.size()) {
+        diff.comparable = false;
+        return diff;
+    }
+    std::vector<StateSection> sections = layout;
+    size_t covered = sections.empty() ? 0 : sections.back().offset + sections.back().size;
+    if (covered < a.size()) {
+        StateSection rest;
+        rest.name = "Unknown";
+        rest.offset = covered;
+        rest.size = a.size() - covered;
+        sections.push_back(rest);
+    }
+    for (const StateSection& section : sections) {
+        size_t begin = std::min(section.offset, a.size());
+        size_t end = std::min(section.offset + section.size, a.size());
+        StateSectionDiff changes;
+        changes.section = section;
+        for (size_t pos = findDifference(a.data(), b.data(), begin, end); pos < end;
+             pos = findDifference(a.data(), b.data(), pos, end)) {
+            size_t runEnd = findMatch(a.data(), b.data(), pos, end);
+            changes.ranges.push_back({pos - begin, runEnd - pos});
+            changes.bytes += runEnd - pos;
+            pos = runEnd;
+        }
+        if (changes.bytes != 0) {
+            diff.bytes += changes.bytes;
+            diff.sections.push_back(std::move(changes));
+        }
+    }
+    return diff;
+}
+
+void writeStateDiff(const StateDiff& diff, std::ostream& out, size_t maxRanges) {
+    if (!diff.comparable) {
+        out << "States differ in size and cannot be compared\n";
+        return;
+    }
+    if (diff.bytes == 0) {
+        out << "States are identical\n";
+        return;
+    }
+    out << diff.bytes << (diff.bytes == 1 ? " byte differs in " : " bytes differ in ") << diff.sections.size()
+        << (diff.sections.size() == 1 ? " section\n" : " sections\n");
+    char text[64];
+    for (const StateSectionDiff& changes : diff.sections) {
+        const StateSection& section = changes.section;
+        out << sectionLabel(section) << ": " << changes.bytes << (changes.bytes == 1 ? " byte in " : " bytes in ")
+            << changes.ranges.size() << (changes.ranges.size() == 1 ? " range\n" : " ranges\n");
+        size_t listed = std::min(changes.ranges.size(), maxRanges);
+        for (size_t i = 0; i < listed; ++i) {
+            const StateDiffRange& range = changes.ranges[i];
+            size_t last = range.offset + range.size - 1;
+            if (section.address >= 0) {
+                size_t base = static_cast<size_t>(section.address);
+                if (range.size == 1) {
+                    std::snprintf(text, sizeof(text), "  %04zX", base + range.offset);
+                } else {
+                    std::snprintf(text, sizeof(text), "  %04zX-%04zX", base + range.offset, base + last);
+                }
+            } else if (range.size == 1) {
+                std::snprintf(text, sizeof(text), "  +0x%zx", range.offset);
+            } else {
+                std::snprintf(text, sizeof(text), "  +0x%zx-+0x%zx", range.offset, last);
+            }
+            out << text << " (" << range.size << (range.size == 1 ? " byte)\n" : " bytes)\n");
+        }
+        if (listed < changes.ranges.size()) {
+            out << "  ... " << changes.ranges.size() - listed << " more\n";
+        }
+    }
+}
+
+} // namespace gblator
@@ -3,10 +3,67 @@
 //
 
 #include "cpu/cpu.h"
-#include <iostream>
+#include "core/guest_trace.h"
+#include "core/state.h"
 
 namespace gblator {
 
+namespace {
+
+// Base duration of every unprefixed opcode in machine cycles (1 M-cycle =
+// 4 clock cycles). Conditional branches list their not-taken duration; the
+// extra cycles of a taken branch are added by executeInstruction(). Illegal
+// opcodes are given one cycle so the emulation always makes progress.
+const uint8_t kOpcodeCycles[256] = {
+    1, 3, 2, 2, 1, 1, 2, 1, 5, 2, 2, 2, 1, 1, 2, 1, // 0x00
+    1, 3, 2, 2, 1, 1, 2, 1, 3, 2, 2, 2, 1, 1, 2, 1, // 0x10
+    2, 3, 2, 2, 1, 1, 2, 1, 2, 2, 2, 2, 1, 1, 2, 1, // 0x20
+    2, 3, 2, 2, 3, 3, 3, 1, 2, 2, 2, 2, 1, 1, 2, 1, // 0x30
+    1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0x40
+    1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0x50
+    1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0x60
+    2, 2, 2, 2, 2, 2, 1, 2, 1, 1, 1, 1, 1, 1, 2, 1, // 0x70
+    1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0x80
+    1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0x90
+    1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0xA0
+    1, 1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 2, 1, // 0xB0
+    2, 3, 3, 4, 3, 4, 2, 4, 2, 4, 3, 2, 3, 6, 2, 4, // 0xC0
+    2, 3, 3, 1, 3, 4, 2, 4, 2, 4, 3, 1, 3, 1, 2, 4, // 0xD0
+    3, 3, 2, 1, 1, 4, 2, 4, 4, 1, 4, 1, 1, 1, 2, 4, // 0xE0
+    3, 3, 2, 1, 1, 4, 2, 4, 3, 2, 4, 1, 1, 1, 2, 4, // 0xF0
+};
+
+const char* const kEngineNames[kCpuEngines] = {
+    "interpreter",
+    "batched",
+};
+
+} // namespace
+
+bool cpuEngineAvailable(CpuEngine engine) {
+#if defined(GBLATOR_MEMORY_STATS)
+    // Access statistics must exclude the component steps between instructions
+    return engine == CpuEngine::Interpreter;
+#else
+    return engine == CpuEngine::Interpreter || engine == CpuEngine::Batched;
+#endif
+}
+
+const char* cpuEngineName(CpuEngine engine) {
+    int index = static_cast<int>(engine);
+    return index >= 0 && index < kCpuEngines ? kEngineNames[index] : "unknown";
+}
+
+bool parseCpuEngine(const std::string& name, CpuEngine& engine) {
+    for (int i = 0; i < kCpuEngines; ++i) {
+        if (name == kEngineNames[i]) {
+            engine = static_cast<CpuEngine>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
 CPU::CPU(Memory& memory) : memory_(memory) {
     reset();
 }
@@ -18,6 +75,10 @@ void CPU::reset() {
     sp_ = 0xFFFE;
     // Program counter starts at 0x0100 after the boot ROM has executed【101292448676489†L117-L136】
     pc_ = 0x0100;
+    ime_ = false;
+    imePending_ = false;
+    halted_ = false;
+    stopped_ = false;
 }
 
 uint16_t CPU::getAF() const { return (static_cast<uint16_t>(a_) << 8) | f_; }
@@ -53,10 +114,120 @@ bool CPU::getFlag(Flag flag) const {
     return (f_ & flag) != 0;
 }
 
-void CPU::step() {
+int CPU::step() {
+    int cycles = serviceInterrupts();
+    if (cycles > 0) {
+        return cycles;
+    }
+    if (halted_ || stopped_) {
+        // Waiting for an interrupt: one idle machine cycle elapses
+        ++haltedCycles_;
+        return 1;
+    }
+    // EI takes effect after the instruction that follows it
+    bool enableIme = imePending_;
     // Fetch the next opcode byte
     uint8_t opcode = memory_.readByte(pc_++);
+    extraCycles_ = 0;
+    ++instructions_;
     executeInstruction(opcode);
+    if (enableIme && imePending_) {
+        ime_ = true;
+        imePending_ = false;
+    }
+    return kOpcodeCycles[opcode] + extraCycles_;
+}
+
+void CPU::saveState(StateWriter& writer) const {
+    writer.value(a_);
+    writer.value(f_);
+    writer.value(b_);
+    writer.value(c_);
+    writer.value(d_);
+    writer.value(e_);
+    writer.value(h_);
+    writer.value(l_);
+    writer.value(sp_);
+    writer.value(pc_);
+    writer.value(ime_);
+    writer.value(imePending_);
+    writer.value(halted_);
+    writer.value(stopped_);
+}
+
+void CPU::loadState(StateReader& reader) {
+    reader.value(a_);
+    reader.value(f_);
+    reader.value(b_);
+    reader.value(c_);
+    reader.value(d_);
+    reader.value(e_);
+    reader.value(h_);
+    reader.value(l_);
+    reader.value(sp_);
+    reader.value(pc_);
+    reader.value(ime_);
+    reader.value(imePending_);
+    reader.value(halted_);
+    reader.value(stopped_);
+}
+
+bool CPU::halted() const {
+    return halted_ || stopped_;
+}
+
+bool CPU::interruptPending() const {
+    return memory_.pendingInterrupts() != 0;
+}
+
+uint64_t CPU::instructions() const {
+    return instructions_;
+}
+
+uint64_t CPU::interruptsTaken() const {
+    return interruptsTaken_;
+}
+
+uint64_t CPU::haltedCycles() const {
+    return haltedCycles_;
+}
+
+DiagnosticChannel& CPU::diagnostics() {
+    return diagnostics_;
+}
+
+int CPU::serviceInterrupts() {
+    // Polled before every instruction, so skip the full address decode
+    uint8_t pending = memory_.pendingInterrupts();
+    if (pending == 0) {
+        return 0;
+    }
+    // Any pending enabled interrupt ends HALT/STOP, even with IME cleared
+    halted_ = false;
+    stopped_ = false;
+    if (!ime_) {
+        return 0;
+    }
+    // Lowest bit has the highest priority: VBlank, STAT, Timer, Serial, Joypad
+    int bit = 0;
+    while ((pending & (1 << bit)) == 0) {
+        ++bit;
+    }
+    ime_ = false;
+    imePending_ = false;
+    uint8_t iflags = memory_.readByte(0xFF0F);
+    memory_.writeByte(0xFF0F, static_cast<uint8_t>(iflags & ~(1 << bit)));
+    sp_ = static_cast<uint16_t>(sp_ - 1);
+    memory_.writeByte(sp_, static_cast<uint8_t>((pc_ >> 8) & 0xFF));
+    sp_ = static_cast<uint16_t>(sp_ - 1);
+    memory_.writeByte(sp_, static_cast<uint8_t>(pc_ & 0xFF));
+    pc_ = static_cast<uint16_t>(0x40 + bit * 8);
+    ++interruptsTaken_;
+    if (GuestTrace* trace = memory_.trace()) {
+        trace->record(GuestEvent::InterruptServiced, static_cast<uint8_t>(bit));
+    }
+    // Dispatching an interrupt takes five machine cycles
+    return 5;
 }
 
 void CPU::executeInstruction(uint8_t opcode) {
@@ -97,7 +268,8 @@ void CPU::executeInstruction(uint8_t opcode) {
     // LD r,r' family (0x40–0x7F), excluding 0x76 (HALT)
     if (opcode >= 0x40 && opcode <= 0x7F) {
         if (opcode == 0x76) {
-            // HALT: halt CPU until interrupt; simplified as no-op here
+            // HALT: suspend execution until an enabled interrupt is pending
+            halted_ = true;
             return;
         }
         int dest = (opcode >> 3) & 0x07;
@@ -255,7 +427,9 @@ void CPU::executeInstruction(uint8_t opcode) {
         // 0x10: STOP (stop CPU until button pressed); treat as NOP and skip one byte
         case 0x10: {
             // The STOP instruction has a 2-byte form (0x10 0x00). We'll skip the padding byte
+            // and then wait like HALT until an interrupt (usually joypad) is pending.
             pc_++;
+            stopped_ = true;
             break;
         }
         // 0x11: LD DE,d16
@@ -353,6 +527,7 @@ void CPU::executeInstruction(uint8_t opcode) {
         case 0x20: {
             int8_t offset = static_cast<int8_t>(memory_.readByte(pc_++));
             if (!getFlag(Z_FLAG)) {
+                extraCycles_ = 1; // branch taken
                 pc_ = static_cast<uint16_t>(pc_ + offset);
             }
             break;
@@ -425,6 +600,7 @@ void CPU::executeInstruction(uint8_t opcode) {
         case 0x28: {
             int8_t offset = static_cast<int8_t>(memory_.readByte(pc_++));
             if (getFlag(Z_FLAG)) {
+                extraCycles_ = 1; // branch taken
                 pc_ = static_cast<uint16_t>(pc_ + offset);
             }
             break;
@@ -472,6 +648,7 @@ void CPU::executeInstruction(uint8_t opcode) {
         case 0x30: {
             int8_t offset = static_cast<int8_t>(memory_.readByte(pc_++));
             if (!getFlag(C_FLAG)) {
+                extraCycles_ = 1; // branch taken
                 pc_ = static_cast<uint16_t>(pc_ + offset);
             }
             break;
@@ -527,6 +704,7 @@ void CPU::executeInstruction(uint8_t opcode) {
         case 0x38: {
             int8_t offset = static_cast<int8_t>(memory_.readByte(pc_++));
             if (getFlag(C_FLAG)) {
+                extraCycles_ = 1; // branch taken
                 pc_ = static_cast<uint16_t>(pc_ + offset);
             }
             break;
@@ -574,6 +752,7 @@ void CPU::executeInstruction(uint8_t opcode) {
         // 0xC0: RET NZ
         case 0xC0: {
             if (!getFlag(Z_FLAG)) {
+                extraCycles_ = 3; // branch taken
                 uint16_t low = memory_.readByte(sp_);
                 uint16_t high = memory_.readByte(sp_ + 1);
                 sp_ += 2;
@@ -595,6 +774,7 @@ void CPU::executeInstruction(uint8_t opcode) {
             uint16_t addr = memory_.readByte(pc_) | (memory_.readByte(pc_ + 1) << 8);
             pc_ += 2;
             if (!getFlag(Z_FLAG)) {
+                extraCycles_ = 1; // branch taken
                 pc_ = addr;
             }
             break;
@@ -610,6 +790,7 @@ void CPU::executeInstruction(uint8_t opcode) {
             uint16_t addr = memory_.readByte(pc_) | (memory_.readByte(pc_ + 1) << 8);
             pc_ += 2;
             if (!getFlag(Z_FLAG)) {
+                extraCycles_ = 3; // branch taken
                 // push current pc onto stack (high byte first)
                 sp_ = static_cast<uint16_t>(sp_ - 1);
                 memory_.writeByte(sp_, static_cast<uint8_t>((pc_ >> 8) & 0xFF));
@@ -648,6 +829,7 @@ void CPU::executeInstruction(uint8_t opcode) {
         // 0xC8: RET Z
         case 0xC8: {
             if (getFlag(Z_FLAG)) {
+                extraCycles_ = 3; // branch taken
                 uint16_t low = memory_.readByte(sp_);
                 uint16_t high = memory_.readByte(sp_ + 1);
                 sp_ += 2;
@@ -668,16 +850,14 @@ void CPU::executeInstruction(uint8_t opcode) {
             uint16_t addr = memory_.readByte(pc_) | (memory_.readByte(pc_ + 1) << 8);
             pc_ += 2;
             if (getFlag(Z_FLAG)) {
+                extraCycles_ = 1; // branch taken
                 pc_ = addr;
             }
             break;
         }
         // 0xCB: PREFIX – CB-prefixed opcodes
         case 0xCB: {
-            // Read the following byte and decode CB instructions. For now, print unimplemented
-            uint8_t cbcode = memory_.readByte(pc_++);
-            std::cerr << "Unimplemented CB opcode: 0x" << std::hex
-                      << static_cast<int>(cbcode) << std::dec << "\n";
+            executeCbInstruction(memory_.readByte(pc_++));
             break;
         }
         // 0xCC: CALL Z,a16
@@ -685,6 +865,7 @@ void CPU::executeInstruction(uint8_t opcode) {
             uint16_t addr = memory_.readByte(pc_) | (memory_.readByte(pc_ + 1) << 8);
             pc_ += 2;
             if (getFlag(Z_FLAG)) {
+                extraCycles_ = 3; // branch taken
                 sp_ = static_cast<uint16_t>(sp_ - 1);
                 memory_.writeByte(sp_, static_cast<uint8_t>((pc_ >> 8) & 0xFF));
                 sp_ = static_cast<uint16_t>(sp_ - 1);
@@ -723,6 +904,7 @@ void CPU::executeInstruction(uint8_t opcode) {
         // 0xD0: RET NC
         case 0xD0: {
             if (!getFlag(C_FLAG)) {
+                extraCycles_ = 3; // branch taken
                 uint16_t low = memory_.readByte(sp_);
                 uint16_t high = memory_.readByte(sp_ + 1);
                 sp_ += 2;
@@ -744,6 +926,7 @@ void CPU::executeInstruction(uint8_t opcode) {
             uint16_t addr = memory_.readByte(pc_) | (memory_.readByte(pc_ + 1) << 8);
             pc_ += 2;
             if (!getFlag(C_FLAG)) {
+                extraCycles_ = 1; // branch taken
                 pc_ = addr;
             }
             break;
@@ -753,6 +936,7 @@ void CPU::executeInstruction(uint8_t opcode) {
             uint16_t addr = memory_.readByte(pc_) | (memory_.readByte(pc_ + 1) << 8);
             pc_ += 2;
             if (!getFlag(C_FLAG)) {
+                extraCycles_ = 3; // branch taken
                 sp_ = static_cast<uint16_t>(sp_ - 1);
                 memory_.writeByte(sp_, static_cast<uint8_t>((pc_ >> 8) & 0xFF));
                 sp_ = static_cast<uint16_t>(sp_ - 1);
@@ -788,6 +972,7 @@ void CPU::executeInstruction(uint8_t opcode) {
         // 0xD8: RET C
         case 0xD8: {
             if (getFlag(C_FLAG)) {
+                extraCycles_ = 3; // branch taken
                 uint16_t low = memory_.readByte(sp_);
                 uint16_t high = memory_.readByte(sp_ + 1);
                 sp_ += 2;
@@ -801,7 +986,9 @@ void CPU::executeInstruction(uint8_t opcode) {
             uint16_t high = memory_.readByte(sp_ + 1);
             sp_ += 2;
             pc_ = static_cast<uint16_t>((high << 8) | low);
-            // enabling interrupts would be handled here; ignore for now
+            // RETI enables interrupts immediately, without the EI delay
+            ime_ = true;
+            imePending_ = false;
             break;
         }
         // 0xDA: JP C,a16
@@ -809,6 +996,7 @@ void CPU::executeInstruction(uint8_t opcode) {
             uint16_t addr = memory_.readByte(pc_) | (memory_.readByte(pc_ + 1) << 8);
             pc_ += 2;
             if (getFlag(C_FLAG)) {
+                extraCycles_ = 1; // branch taken
                 pc_ = addr;
             }
             break;
@@ -818,6 +1006,7 @@ void CPU::executeInstruction(uint8_t opcode) {
             uint16_t addr = memory_.readByte(pc_) | (memory_.readByte(pc_ + 1) << 8);
             pc_ += 2;
             if (getFlag(C_FLAG)) {
+                extraCycles_ = 3; // branch taken
                 sp_ = static_cast<uint16_t>(sp_ - 1);
                 memory_.writeByte(sp_, static_cast<uint8_t>((pc_ >> 8) & 0xFF));
                 sp_ = static_cast<uint16_t>(sp_ - 1);
@@ -949,7 +1138,8 @@ void CPU::executeInstruction(uint8_t opcode) {
         }
         // 0xF3: DI (disable interrupts)
         case 0xF3: {
-            // Interrupt disable would clear IME; not implemented here
+            ime_ = false;
+            imePending_ = false;
             break;
         }
         // 0xF5: PUSH AF
@@ -1002,7 +1192,8 @@ void CPU::executeInstruction(uint8_t opcode) {
         }
         // 0xFB: EI (enable interrupts)
         case 0xFB: {
-            // Would set IME=1 after next instruction; not implemented
+            // IME is set after the instruction following EI; see step()
+            imePending_ = true;
             break;
         }
         // 0xFE: CP n8
@@ -1022,13 +1213,94 @@ void CPU::executeInstruction(uint8_t opcode) {
         }
 
         default: {
-            std::cerr << "Unimplemented opcode: 0x" << std::hex
-                      << static_cast<int>(opcode) << std::dec << "\n";
+            diagnostics_.report(DiagnosticKind::UnimplementedOpcode, opcode, static_cast<uint16_t>(pc_ - 1));
             break;
         }
     }
 }
 
+void CPU::executeCbInstruction(uint8_t opcode) {
+    // The low three bits select the operand in the usual order (B, C, D,
+    // E, H, L, [HL], A); bits 3-5 give the operation or the bit number
+    int index = opcode & 0x07;
+    int bit = (opcode >> 3) & 0x07;
+    uint8_t* reg = nullptr;
+    switch (index) {
+        case 0: reg = &b_; break;
+        case 1: reg = &c_; break;
+        case 2: reg = &d_; break;
+        case 3: reg = &e_; break;
+        case 4: reg = &h_; break;
+        case 5: reg = &l_; break;
+        case 7: reg = &a_; break;
+        default: break;
+    }
+    uint8_t value = reg != nullptr ? *reg : memory_.readByte(getHL());
+
+    // BIT b,r (0x40–0x7F): test only; [HL] takes one extra read cycle
+    if (opcode >= 0x40 && opcode <= 0x7F) {
+        setFlag(Z_FLAG, (value & (1u << bit)) == 0);
+        setFlag(N_FLAG, false);
+        setFlag(H_FLAG, true);
+        extraCycles_ = reg != nullptr ? 0 : 1;
+        return;
+    }
+
+    uint8_t result;
+    if (opcode >= 0x80) {
+        // RES b,r (0x80–0xBF) and SET b,r (0xC0–0xFF) leave the flags alone
+        uint8_t mask = static_cast<uint8_t>(1u << bit);
+        result = opcode < 0xC0 ? static_cast<uint8_t>(value & ~mask) : static_cast<uint8_t>(value | mask);
+    } else {
+        // Rotates and shifts (0x00–0x3F): Z from the result, N and H cleared
+        bool carry = false;
+        switch (bit) {
+            case 0: // RLC
+                carry = (value & 0x80) != 0;
+                result = static_cast<uint8_t>((value << 1) | (value >> 7));
+                break;
+            case 1: // RRC
+                carry = (value & 0x01) != 0;
+                result = static_cast<uint8_t>((value >> 1) | (value << 7));
+                break;
+            case 2: // RL
+                carry = (value & 0x80) != 0;
+                result = static_cast<uint8_t>((value << 1) | (getFlag(C_FLAG) ? 1 : 0));
+                break;
+            case 3: // RR
+                carry = (value & 0x01) != 0;
+                result = static_cast<uint8_t>((value >> 1) | (getFlag(C_FLAG) ? 0x80 : 0));
+                break;
+            case 4: // SLA
+                carry = (value & 0x80) != 0;
+                result = static_cast<uint8_t>(value << 1);
+                break;
+            case 5: // SRA keeps the sign bit
+                carry = (value & 0x01) != 0;
+                result = static_cast<uint8_t>((value >> 1) | (value & 0x80));
+                break;
+            case 6: // SWAP clears the carry
+                result = static_cast<uint8_t>((value << 4) | (value >> 4));
+                break;
+            default: // SRL
+                carry = (value & 0x01) != 0;
+                result = static_cast<uint8_t>(value >> 1);
+                break;
+        }
+        setFlag(Z_FLAG, result == 0);
+        setFlag(N_FLAG, false);
+        setFlag(H_FLAG, false);
+        setFlag(C_FLAG, carry);
+    }
+    if (reg != nullptr) {
+        *reg = result;
+    } else {
+        // Read-modify-write of [HL] takes two extra cycles
+        memory_.writeByte(getHL(), result);
+        extraCycles_ = 2;
+    }
+}
+
 // ----- Helper functions -----
 
 /**
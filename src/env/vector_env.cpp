@@ -0,0 +1,158 @@
+//
+// Implementation of the VectorEnv class.
+//
+
+#include "env/vector_env.h"
+#include "core/core.h"
+#include "joypad/joypad.h"
+#include "mmu/memory.h"
+#include "ppu/ppu.h"
+#include "utils/profiler.h"
+#include "utils/worker_pool.h"
+#include <cstring>
+
+namespace gblator {
+
+namespace {
+
+constexpr size_t kFrameBytes = PPU::kScreenWidth * PPU::kScreenHeight;
+
+} // namespace
+
+VectorEnv::VectorEnv() : observations_(nullptr), rewards_(nullptr), dones_(nullptr) {
+}
+
+VectorEnv::~VectorEnv() {
+}
+
+bool VectorEnv::open(const uint8_t* rom, size_t romSize, const EnvConfig& config) {
+    envs_.clear();
+    if (config.numEnvs <= 0 || config.frameSkip <= 0) {
+        return false;
+    }
+    config_ = config;
+    rom_.assign(rom, rom + romSize);
+    for (int i = 0; i < config_.numEnvs; ++i) {
+        std::unique_ptr<GameBoy> gb(new GameBoy());
+        if (!gb->loadROM(rom_, RomOwnership::Borrow)) {
+            envs_.clear();
+            return false;
+        }
+        envs_.push_back(std::move(gb));
+    }
+    // Every environment restarts from the same post-warm-up snapshot
+    for (int i = 0; i < config_.warmupFrames; ++i) {
+        envs_[0]->runFrame();
+    }
+    startState_.assign(envs_[0]->stateSize(), 0);
+    envs_[0]->saveState(startState_.data(), startState_.size());
+
+    size_t n = envs_.size();
+    episodeFrames_.assign(n, 0);
+    rewardValues_.assign(n, 0);
+    ownObservations_.assign(n * kFrameBytes, 0);
+    ownRewards_.assign(n, 0.0f);
+    ownDones_.assign(n, 0);
+    setBuffers(nullptr, nullptr, nullptr);
+    pool_.reset(new WorkerPool(config_.numThreads));
+    reset();
+    return true;
+}
+
+size_t VectorEnv::size() const {
+    return envs_.size();
+}
+
+int VectorEnv::width() const {
+    return PPU::kScreenWidth;
+}
+
+int VectorEnv::height() const {
+    return PPU::kScreenHeight;
+}
+
+void VectorEnv::setBuffers(uint8_t* observations, float* rewards, uint8_t* dones) {
+    observations_ = observations != nullptr ? observations : ownObservations_.data();
+    rewards_ = rewards != nullptr ? rewards : ownRewards_.data();
+    dones_ = dones != nullptr ? dones : ownDones_.data();
+}
+
+void VectorEnv::reset() {
+    auto task = [this](size_t i) {
+        resetEnv(i);
+        rewards_[i] = 0.0f;
+        dones_[i] = 0;
+        publish(i);
+    };
+    pool_->forEach(envs_.size(), task);
+}
+
+bool VectorEnv::step(const uint8_t* actions, size_t n) {
+    if (n != envs_.size()) {
+        return false;
+    }
+    auto task = [this, actions](size_t i) { stepEnv(i, actions[i]); };
+    pool_->forEach(n, task);
+    return true;
+}
+
+void VectorEnv::stepEnv(size_t index, uint8_t action) {
+    GameBoy& gb = *envs_[index];
+    gb.joypad().setButtons(action);
+    for (int f = 0; f < config_.frameSkip; ++f) {
+        gb.runFrame();
+    }
+    episodeFrames_[index] += config_.frameSkip;
+
+    float reward = 0.0f;
+    if (config_.rewardAddress >= 0) {
+        uint8_t value = gb.memory().readByte(static_cast<uint16_t>(config_.rewardAddress));
+        reward = static_cast<float>(static_cast<int>(value) - static_cast<int>(rewardValues_[index]));
+        rewardValues_[index] = value;
+    }
+    bool done = false;
+    if (config_.doneAddress >= 0) {
+        done = gb.memory().readByte(static_cast<uint16_t>(config_.doneAddress)) != 0;
+    }
+    if (config_.maxEpisodeFrames > 0 && episodeFrames_[index] >= config_.maxEpisodeFrames) {
+        done = true;
+    }
+    rewards_[index] = reward;
+    dones_[index] = done ? 1 : 0;
+    if (done) {
+        resetEnv(index);
+    }
+    publish(index);
+}
+
+void VectorEnv::resetEnv(size_t index) {
+    GameBoy& gb = *envs_[index];
+    gb.loadState(startState_.data(), startState_.size());
+    episodeFrames_[index] = 0;
+    if (config_.rewardAddress >= 0) {
+        rewardValues_[index] = gb.memory().readByte(static_cast<uint16_t>(config_.rewardAddress));
+    }
+}
+
+void VectorEnv::publish(size_t index) {
+    GBLATOR_ZONE("frame_handoff");
+    std::memcpy(observations_ + index * kFrameBytes, envs_[index]->ppu().frameBuffer(), kFrameBytes);
+}
+
+const uint8_t* VectorEnv::observations() const {
+    return observations_;
+}
+
+const float* VectorEnv::rewards() const {
+    return rewards_;
+}
+
+const uint8_t* VectorEnv::dones() const {
+    return dones_;
+}
+
+GameBoy& VectorEnv::env(size_t index) {
+    return *envs_[index];
+}
+
+} // namespace gblator
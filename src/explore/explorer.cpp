@@ -0,0 +1,239 @@
+//
+// Implementation of the Explorer class.
+//
+
+#include "explore/explorer.h"
+#include "core/core.h"
+#include "utils/hash.h"
+#include "utils/worker_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace gblator {
+
+namespace {
+
+// Upper bound on downscaled frame pixels, so keys are built on the stack
+constexpr int kMaxCellPixels = 1024;
+
+// splitmix64: small, fast and good enough for input and cell selection
+uint64_t nextRandom(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+double uniformRandom(uint64_t& state) {
+    return static_cast<double>(nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+} // namespace
+
+Explorer::Explorer() : stateSize_(0), framesRun_(0), generations_(0) {
+}
+
+Explorer::~Explorer() {
+}
+
+bool Explorer::open(const uint8_t* rom, size_t romSize, const ExploreConfig& config) {
+    slots_.clear();
+    cells_.clear();
+    states_.clear();
+    index_.clear();
+    framesRun_ = 0;
+    generations_ = 0;
+    if (config.burstsPerGeneration < 1 || config.burstFrames < 1 || config.actionRepeat < 1 ||
+        config.maxCellsPerBurst < 1 || config.cellShades < 1) {
+        return false;
+    }
+    if (config.cellAddresses.empty() &&
+        (config.cellWidth < 1 || config.cellWidth > PPU::kScreenWidth || config.cellHeight < 1 ||
+         config.cellHeight > PPU::kScreenHeight || config.cellWidth * config.cellHeight > kMaxCellPixels)) {
+        return false;
+    }
+    config_ = config;
+
+    rom_.assign(rom, rom + romSize);
+    slots_.resize(static_cast<size_t>(config_.burstsPerGeneration));
+    for (Slot& slot : slots_) {
+        slot.gb.reset(new GameBoy());
+        if (!slot.gb->loadROM(rom_, RomOwnership::Borrow)) {
+            slots_.clear();
+            return false;
+        }
+    }
+    GameBoy& first = *slots_[0].gb;
+    for (int i = 0; i < config_.warmupFrames; ++i) {
+        first.runFrame();
+    }
+    stateSize_ = first.stateSize();
+    for (Slot& slot : slots_) {
+        // Sized once so bursts never allocate
+        slot.found.reserve(static_cast<size_t>(config_.maxCellsPerBurst));
+        slot.states.resize(stateSize_ * static_cast<size_t>(config_.maxCellsPerBurst));
+    }
+
+    Cell start;
+    start.key = cellKey(first);
+    std::vector<uint8_t> state(stateSize_);
+    first.saveState(state.data(), state.size());
+    addCell(start, state.data());
+    pool_.reset(new WorkerPool(config_.numThreads));
+    return true;
+}
+
+uint64_t Explorer::cellKey(GameBoy& gb) const {
+    if (!config_.cellAddresses.empty()) {
+        uint64_t hash = kHashSeed;
+        for (uint16_t address : config_.cellAddresses) {
+            uint8_t value = gb.memory().readByte(address);
+            hash = hashBytes(&value, 1, hash);
+        }
+        return hash;
+    }
+    // Average the shade of each block of the frame, then quantise
+    const uint8_t* frame = gb.ppu().frameBuffer();
+    uint8_t cells[kMaxCellPixels];
+    int width = config_.cellWidth;
+    int height = config_.cellHeight;
+    for (int cy = 0; cy < height; ++cy) {
+        int y0 = cy * PPU::kScreenHeight / height;
+        int y1 = (cy + 1) * PPU::kScreenHeight / height;
+        for (int cx = 0; cx < width; ++cx) {
+            int x0 = cx * PPU::kScreenWidth / width;
+            int x1 = (cx + 1) * PPU::kScreenWidth / width;
+            int sum = 0;
+            for (int y = y0; y < y1; ++y) {
+                const uint8_t* row = frame + y * PPU::kScreenWidth;
+                for (int x = x0; x < x1; ++x) {
+                    sum += row[x];
+                }
+            }
+            int pixels = (y1 - y0) * (x1 - x0);
+            int level = sum * config_.cellShades / (pixels * 4);
+            cells[cy * width + cx] = static_cast<uint8_t>(std::min(level, config_.cellShades - 1));
+        }
+    }
+    return hashBytes(cells, static_cast<size_t>(width * height));
+}
+
+size_t Explorer::chooseCell(uint64_t& rng) const {
+    double target = uniformRandom(rng) * weights_.back();
+    size_t index = static_cast<size_t>(std::upper_bound(weights_.begin(), weights_.end(), target) - weights_.begin());
+    return std::min(index, cells_.size() - 1);
+}
+
+void Explorer::addCell(const Cell& cell, const uint8_t* state) {
+    index_[cell.key] = cells_.size();
+    cells_.push_back(cell);
+    states_.insert(states_.end(), state, state + stateSize_);
+}
+
+void Explorer::runBurst(size_t index) {
+    // The archive is read-only while a batch runs, so lookups need no lock
+    Slot& slot = slots_[index];
+    GameBoy& gb = *slot.gb;
+    gb.loadState(cellState(slot.cell), stateSize_);
+    slot.found.clear();
+    uint64_t baseFrames = cells_[slot.cell].frames;
+    uint8_t buttons = 0;
+    for (int frame = 0; frame < config_.burstFrames; ++frame) {
+        if (config_.policy != nullptr) {
+            buttons = config_.policy(config_.policyContext, slot.rng, frame);
+        } else if (frame % config_.actionRepeat == 0) {
+            buttons = static_cast<uint8_t>(nextRandom(slot.rng));
+        }
+        gb.joypad().setButtons(buttons);
+        gb.runFrame();
+        if (slot.found.size() >= static_cast<size_t>(config_.maxCellsPerBurst)) {
+            continue;
+        }
+        Cell cell;
+        cell.key = cellKey(gb);
+        cell.frames = baseFrames + static_cast<uint64_t>(frame) + 1;
+        auto known = index_.find(cell.key);
+        if (known != index_.end() && cells_[known->second].frames <= cell.frames) {
+            continue;
+        }
+        // The first visit within a burst is also its shortest
+        bool repeated = false;
+        for (const Cell& found : slot.found) {
+            repeated = repeated || found.key == cell.key;
+        }
+        if (repeated) {
+            continue;
+        }
+        gb.saveState(slot.states.data() + slot.found.size() * stateSize_, stateSize_);
+        slot.found.push_back(cell);
+    }
+}
+
+void Explorer::runGeneration() {
+    if (cells_.empty()) {
+        return;
+    }
+    // Choose start cells and seed every burst on the calling thread so the
+    // outcome does not depend on how the pool schedules bursts
+    weights_.resize(cells_.size());
+    double total = 0.0;
+    for (size_t i = 0; i < cells_.size(); ++i) {
+        total += 1.0 / std::sqrt(1.0 + cells_[i].timesChosen);
+        weights_[i] = total;
+    }
+    uint64_t rng = config_.seed ^ (generations_ * 0xD1B54A32D192ED03ull);
+    for (Slot& slot : slots_) {
+        slot.cell = chooseCell(rng);
+        slot.rng = nextRandom(rng);
+    }
+
+    auto burst = [this](size_t index) { runBurst(index); };
+    pool_->forEach(slots_.size(), burst);
+
+    // Merge in slot order: new cells are added, shorter paths replace
+    // the state of known cells
+    for (Slot& slot : slots_) {
+        ++cells_[slot.cell].timesChosen;
+        for (size_t i = 0; i < slot.found.size(); ++i) {
+            const Cell& cell = slot.found[i];
+            const uint8_t* state = slot.states.data() + i * stateSize_;
+            auto known = index_.find(cell.key);
+            if (known == index_.end()) {
+                addCell(cell, state);
+                ++cells_[slot.cell].discoveries;
+            } else if (cell.frames < cells_[known->second].frames) {
+                cells_[known->second].frames = cell.frames;
+                std::memcpy(states_.data() + known->second * stateSize_, state, stateSize_);
+            }
+        }
+    }
+    framesRun_ += slots_.size() * static_cast<uint64_t>(config_.burstFrames);
+    ++generations_;
+}
+
+size_t Explorer::cellCount() const {
+    return cells_.size();
+}
+
+const Cell& Explorer::cell(size_t index) const {
+    return cells_[index];
+}
+
+const uint8_t* Explorer::cellState(size_t index) const {
+    return states_.data() + index * stateSize_;
+}
+
+size_t Explorer::stateSize() const {
+    return stateSize_;
+}
+
+uint64_t Explorer::framesRun() const {
+    return framesRun_;
+}
+
+uint64_t Explorer::generations() const {
+    return generations_;
+}
+
+} // namespace gblator
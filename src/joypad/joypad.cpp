@@ -4,6 +4,8 @@
 
 #include "joypad/joypad.h"
 #include "mmu/memory.h"
+#include "core/input_latency.h"
+#include "core/state.h"
 
 namespace gblator {
 
@@ -14,36 +16,65 @@ void Joypad::reset() {
     buttonState_ = 0x00;
     // Initialize JOYP register to no buttons selected, all buttons unpressed
     memory_.writeByte(0xFF00, 0xFF);
+    updateRegister();
 }
 
 void Joypad::setButton(Button button, bool pressed) {
     uint8_t mask = static_cast<uint8_t>(1 << static_cast<uint8_t>(button));
+    uint8_t previous = buttonState_;
     if (pressed) {
+        if ((buttonState_ & mask) == 0) {
+            // A new press requests the joypad interrupt (IF bit 4), which
+            // also wakes the CPU from STOP
+            uint8_t iflags = memory_.readByte(0xFF0F);
+            memory_.writeByte(0xFF0F, static_cast<uint8_t>(iflags | 0x10));
+        }
         buttonState_ |= mask;
     } else {
         buttonState_ &= static_cast<uint8_t>(~mask);
     }
+    noteInput(previous);
+    updateRegister();
+}
+
+void Joypad::setButtons(uint8_t buttons) {
+    if ((buttons & ~buttonState_) != 0) {
+        // Newly pressed buttons request the joypad interrupt (IF bit 4)
+        uint8_t iflags = memory_.readByte(0xFF0F);
+        memory_.writeByte(0xFF0F, static_cast<uint8_t>(iflags | 0x10));
+    }
+    uint8_t previous = buttonState_;
+    buttonState_ = buttons;
+    noteInput(previous);
+    updateRegister();
+}
+
+uint8_t Joypad::buttons() const {
+    return buttonState_;
+}
+
+void Joypad::saveState(StateWriter& writer) const {
+    writer.value(buttonState_);
+}
+
+void Joypad::loadState(StateReader& reader) {
+    reader.value(buttonState_);
     updateRegister();
 }
 
 void Joypad::updateRegister() {
-    uint8_t joyp = memory_.readByte(0xFF00);
-    // Bits 4 and 5 select button groups: 0 = select, 1 = deselect
-    bool selectButtons = (joyp & 0x10) == 0;
-    bool selectDirections = (joyp & 0x20) == 0;
-    uint8_t lowNibble = 0x0F;
-    if (selectButtons) {
-        // Bits 3..0 map to Start, Select, B, A
-        // Buttons are active-low
-        lowNibble &= static_cast<uint8_t>(~((buttonState_ >> 4) & 0x0F));
+    // Memory combines the buttons with the group select bits on every
+    // read, so the guest sees presses made after it selected a group
+    memory_.setJoypadButtons(buttonState_);
+}
+
+void Joypad::noteInput(uint8_t previous) {
+    if (buttonState_ == previous) {
+        return;
     }
-    if (selectDirections) {
-        // Bits 3..0 map to Down, Up, Left, Right
-        lowNibble &= static_cast<uint8_t>(~(buttonState_ & 0x0F));
+    if (InputLatency* probe = memory_.latencyProbe()) {
+        probe->inputChanged(previous, buttonState_);
     }
-    // Bits 4 and 5 remain as written by CPU
-    joyp = static_cast<uint8_t>((joyp & 0x30) | (lowNibble & 0x0F) | 0xC0);
-    memory_.writeByte(0xFF00, joyp);
 }
 
 } // namespace gblator
\ No newline at end of file
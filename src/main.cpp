@@ -2,33 +2,472 @@
 // Entry point for the GBLator emulator.
 //
 
-#include "mmu/memory.h"
-#include "cpu/cpu.h"
+#include "core/core.h"
+#include "core/determinism_audit.h"
+#include "core/engine_select.h"
+#include "core/guest_trace.h"
+#include "core/state_diff.h"
+#include "explore/explorer.h"
+#include "server/env_server.h"
+#include "server/fork_server.h"
+#include "sched/edf_scheduler.h"
+#include "serial/link_cable.h"
+#include "serial/link_session.h"
+#include "utils/diagnostics.h"
+#include "utils/profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+void printUsage(const char* program) {
+    std::cerr << "Usage: " << program << " <ROM file> [--frames N] [--realtime] [--counters json|prometheus] [--hw-counters]\n"
+              << "           [--trace FILE] [--guest-trace FILE] [--watch-io ADDR]... [--memory-stats]\n"
+              << "           [--instances N] [--workers N] [--link ROM] [--engine NAME|auto] [--engine-cache FILE]\n"
+              << "           [--link-listen SOCKET | --link-connect SOCKET] [--save-state FILE]\n"
+              << "       " << program << " <ROM file> --diff-states STATE STATE\n"
+              << "       " << program << " <ROM file> --audit INPUTS [--frames N]\n"
+              << "       " << program << " <ROM file> --serve NAME [--envs N] [--threads N] [--frame-skip N]\n"
+              << "           [--warmup N] [--reward-addr ADDR] [--done-addr ADDR] [--max-frames N]\n"
+              << "       " << program << " <ROM file> --fork-server [--warmup N] [--timeout SECONDS]\n"
+              << "       " << program << " <ROM file> --explore GENERATIONS [--threads N] [--warmup N]\n"
+              << "           [--burst-frames N] [--cell-addr ADDR]...\n";
+}
+
+// Read a whole file; returns false if it cannot be opened or is empty
+bool readFile(const char* path, std::vector<uint8_t>& data) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    data.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return !data.empty();
+}
+
+// Apply the named engine, or with "auto" the fastest correct one for the
+// ROM, remembered in the cache file if one is given
+bool selectEngine(gblator::GameBoy& gb, const std::string& name, const std::string& cachePath) {
+    if (name != "auto") {
+        gblator::CpuEngine engine;
+        if (!gblator::parseCpuEngine(name, engine) || !gb.setEngine(engine)) {
+            std::cerr << "Unknown or unavailable engine: " << name << "\n";
+            return false;
+        }
+        return true;
+    }
+    gblator::EngineSelector selector;
+    if (!cachePath.empty() && !selector.loadCache(cachePath)) {
+        std::cerr << "Ignoring malformed engine cache: " << cachePath << "\n";
+    }
+    gblator::EngineChoice choice = selector.select(gb);
+    for (const gblator::EngineTrial& trial : choice.trials) {
+        std::cerr << "Engine " << gblator::cpuEngineName(trial.engine) << ": " << trial.bestFrameNs
+                  << " ns/frame" << (trial.agrees ? "" : " (state differs, rejected)") << "\n";
+    }
+    std::cerr << "Using engine " << gblator::cpuEngineName(choice.engine) << (choice.cached ? " (cached)" : "")
+              << "\n";
+    if (!cachePath.empty() && !choice.cached && !selector.saveCache(cachePath)) {
+        std::cerr << "Failed to write engine cache: " << cachePath << "\n";
+    }
+    return true;
+}
+
+// Serve environments over the shared memory segment /name until a client
+// asks the server to shut down
+int runServer(const char* romPath, const std::string& name, const gblator::EnvConfig& config) {
+    std::vector<uint8_t> rom;
+    if (!readFile(romPath, rom)) {
+        std::cerr << "Failed to load ROM file: " << romPath << "\n";
+        return 1;
+    }
+    gblator::EnvServer server;
+    if (!server.open(name, rom.data(), rom.size(), config)) {
+        std::cerr << "Failed to create environment server " << name << "\n";
+        return 1;
+    }
+    server.serve();
+    server.close();
+    return 0;
+}
+
+// Fork one child per job read from stdin, replying on stdout
+int runForkServer(const char* romPath, const gblator::ForkServerConfig& config) {
+    std::vector<uint8_t> rom;
+    if (!readFile(romPath, rom)) {
+        std::cerr << "Failed to load ROM file: " << romPath << "\n";
+        return 1;
+    }
+    gblator::ForkServer server;
+    if (!server.open(rom.data(), rom.size(), config)) {
+        std::cerr << "Failed to start fork server\n";
+        return 1;
+    }
+    server.serve(std::cin, std::cout);
+    return 0;
+}
+
+// Run several real-time instances of the ROM on a few scheduler workers
+// for the given number of frame periods, then report deadline misses
+int runInstances(const char* romPath, int instances, int workers, int frames) {
+    std::vector<uint8_t> rom;
+    if (!readFile(romPath, rom)) {
+        std::cerr << "Failed to load ROM file: " << romPath << "\n";
+        return 1;
+    }
+    std::vector<std::unique_ptr<gblator::GameBoy>> consoles;
+    for (int i = 0; i < instances; ++i) {
+        consoles.emplace_back(new gblator::GameBoy());
+        if (!consoles.back()->loadROM(rom.data(), rom.size())) {
+            std::cerr << "Failed to load ROM file: " << romPath << "\n";
+            return 1;
+        }
+    }
+    // Declared before the scheduler so that it outlives the frames it logs
+    gblator::DiagnosticLogger logger(std::cerr);
+    for (size_t i = 0; i < consoles.size(); ++i) {
+        logger.attach(consoles[i]->cpu().diagnostics(), "instance " + std::to_string(i));
+    }
+    gblator::EdfScheduler scheduler(workers);
+    std::vector<int> ids;
+    for (auto& gb : consoles) {
+        ids.push_back(scheduler.add(*gb));
+    }
+    std::this_thread::sleep_for(gblator::EdfScheduler::framePeriod() * frames);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        scheduler.remove(ids[i]);
+        gblator::EdfStats stats = scheduler.stats(ids[i]);
+        std::cout << "instance " << i << ": " << stats.framesRun << " frames, " << stats.deadlineMisses
+                  << " deadline misses, " << stats.resyncs << " resyncs, worst lateness "
+                  << stats.maxLatenessNs / 1000 << " us\n";
+    }
+    return 0;
+}
+
+// Run two consoles connected by a link cable and report the bytes exchanged
+int runLinked(const char* romPath, const char* peerPath, int frames) {
+    gblator::GameBoy first;
+    gblator::GameBoy second;
+    if (!first.loadROM(romPath) || !second.loadROM(peerPath)) {
+        std::cerr << "Failed to load ROM files: " << romPath << ", " << peerPath << "\n";
+        return 1;
+    }
+    gblator::LinkCable cable(first, second);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; ++i) {
+        cable.runFrame();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << frames << " linked frames, " << cable.exchanges() << " bytes exchanged, " << cable.slices()
+              << " slices (" << static_cast<uint64_t>(frames / std::max(seconds, 1e-9)) << " frames/s)\n";
+    return 0;
+}
+
+// Run the ROM linked to a console in another process over a Unix socket
+int runLinkSession(const char* romPath, const std::string& socketPath, bool listen, int frames) {
+    gblator::GameBoy gb;
+    if (!gb.loadROM(romPath)) {
+        std::cerr << "Failed to load ROM file: " << romPath << "\n";
+        return 1;
+    }
+    gblator::LinkSession session;
+    bool connected = listen ? session.listen(socketPath, gb) : session.connect(socketPath, gb);
+    if (!connected) {
+        std::cerr << "Failed to link over " << socketPath << "\n";
+        return 1;
+    }
+    for (int i = 0; i < frames; ++i) {
+        if (!session.runFrame()) {
+            // Usually the peer finished first; it may be a few frames ahead
+            std::cerr << "Link session ended by the peer after " << i << " frames\n";
+            break;
+        }
+    }
+    const gblator::LinkSessionStats& stats = session.stats();
+    std::cout << stats.slices << " slices (" << stats.predictedSlices << " predicted), " << stats.rollbacks
+              << " rollbacks re-simulating " << stats.resimulatedSlices << " slices, " << stats.stalls
+              << " stalls (" << stats.stallNs / 1000 << " us)\n";
+    return 0;
+}
+
+// Compare two save states of the ROM region by region; exits with 2 if they differ
+int runDiffStates(const char* romPath, const char* firstPath, const char* secondPath) {
+    gblator::GameBoy gb;
+    if (!gb.loadROM(romPath)) {
+        std::cerr << "Failed to load ROM file: " << romPath << "\n";
+        return 1;
+    }
+    std::vector<uint8_t> first;
+    std::vector<uint8_t> second;
+    if (!readFile(firstPath, first) || !readFile(secondPath, second)) {
+        std::cerr << "Failed to read save states: " << firstPath << ", " << secondPath << "\n";
+        return 1;
+    }
+    gblator::StateDiff diff = gblator::diffStates(gb.stateLayout(), first, second);
+    gblator::writeStateDiff(diff, std::cout);
+    if (!diff.comparable) {
+        return 1;
+    }
+    return diff.bytes == 0 ? 0 : 2;
+}
+
+// Replay the input file (one button mask per frame) on two consoles in
+// parallel and report the first frame at which their states diverge;
+// frames, if non-zero, overrides the replay length, pressing nothing past
+// the end of the file. Exits with 2 on a divergence
+int runAudit(const char* romPath, const char* inputPath, int frames) {
+    std::vector<uint8_t> rom;
+    std::vector<uint8_t> inputs;
+    if (!readFile(romPath, rom)) {
+        std::cerr << "Failed to load ROM file: " << romPath << "\n";
+        return 1;
+    }
+    if (!readFile(inputPath, inputs)) {
+        std::cerr << "Failed to read input file: " << inputPath << "\n";
+        return 1;
+    }
+    gblator::AuditConfig config;
+    config.frames = frames;
+    gblator::AuditResult result = gblator::auditDeterminism(rom, inputs, config);
+    if (!result.ok) {
+        std::cerr << "Failed to start the audit\n";
+        return 1;
+    }
+    if (result.divergedFrame < 0) {
+        std::cout << "Deterministic over " << result.framesCompared << " frames\n";
+        return 0;
+    }
+    std::cout << "States diverge after frame " << result.divergedFrame << "\n";
+    gblator::writeStateDiff(result.diff, std::cout);
+    return 2;
+}
+
+// Explore the ROM's state space and report the archive growth
+int runExplorer(const char* romPath, int generations, const gblator::ExploreConfig& config) {
+    std::vector<uint8_t> rom;
+    if (!readFile(romPath, rom)) {
+        std::cerr << "Failed to load ROM file: " << romPath << "\n";
+        return 1;
+    }
+    gblator::Explorer explorer;
+    if (!explorer.open(rom.data(), rom.size(), config)) {
+        std::cerr << "Failed to start explorer\n";
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < generations; ++i) {
+        explorer.runGeneration();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << explorer.cellCount() << " cells after " << explorer.generations() << " generations, "
+              << explorer.framesRun() << " frames ("
+              << static_cast<uint64_t>(explorer.framesRun() / std::max(seconds, 1e-9)) << " frames/s)\n";
+    return 0;
+}
+
+} // namespace
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <ROM file>\n";
+        printUsage(argv[0]);
         return 1;
     }
     const char* romPath = argv[1];
+    int frames = 60;
+    bool framesGiven = false;
+    bool realTime = false;
+    std::string serveName;
+    bool forkServer = false;
+    int timeoutSeconds = 0;
+    int instances = 1;
+    int workers = 1;
+    int exploreGenerations = 0;
+    const char* linkPath = nullptr;
+    std::string linkSocket;
+    bool linkListen = false;
+    std::string countersFormat;
+    bool hwCounters = false;
+    std::string tracePath;
+    std::string guestTracePath;
+    std::vector<uint16_t> watchedRegisters;
+    bool memoryStats = false;
+    std::string engineName = "interpreter";
+    std::string engineCachePath;
+    std::string saveStatePath;
+    const char* diffPaths[2] = {nullptr, nullptr};
+    const char* auditPath = nullptr;
+    gblator::ExploreConfig exploreConfig;
+    gblator::EnvConfig envConfig;
+    for (int i = 2; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--frames") == 0 && hasValue) {
+            frames = std::atoi(argv[++i]);
+            framesGiven = true;
+        } else if (std::strcmp(argv[i], "--realtime") == 0) {
+            realTime = true;
+        } else if (std::strcmp(argv[i], "--counters") == 0 && hasValue) {
+            countersFormat = argv[++i];
+        } else if (std::strcmp(argv[i], "--hw-counters") == 0) {
+            hwCounters = true;
+        } else if (std::strcmp(argv[i], "--trace") == 0 && hasValue) {
+            tracePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--guest-trace") == 0 && hasValue) {
+            guestTracePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--watch-io") == 0 && hasValue) {
+            watchedRegisters.push_back(static_cast<uint16_t>(std::strtol(argv[++i], nullptr, 0)));
+        } else if (std::strcmp(argv[i], "--memory-stats") == 0) {
+            memoryStats = true;
+        } else if (std::strcmp(argv[i], "--engine") == 0 && hasValue) {
+            engineName = argv[++i];
+        } else if (std::strcmp(argv[i], "--engine-cache") == 0 && hasValue) {
+            engineCachePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--save-state") == 0 && hasValue) {
+            saveStatePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--diff-states") == 0 && i + 2 < argc) {
+            diffPaths[0] = argv[++i];
+            diffPaths[1] = argv[++i];
+        } else if (std::strcmp(argv[i], "--audit") == 0 && hasValue) {
+            auditPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--instances") == 0 && hasValue) {
+            instances = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--workers") == 0 && hasValue) {
+            workers = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--link") == 0 && hasValue) {
+            linkPath = argv[++i];
+        } else if ((std::strcmp(argv[i], "--link-listen") == 0 || std::strcmp(argv[i], "--link-connect") == 0) &&
+                   hasValue) {
+            linkListen = std::strcmp(argv[i], "--link-listen") == 0;
+            linkSocket = argv[++i];
+        } else if (std::strcmp(argv[i], "--explore") == 0 && hasValue) {
+            exploreGenerations = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--burst-frames") == 0 && hasValue) {
+            exploreConfig.burstFrames = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--cell-addr") == 0 && hasValue) {
+            exploreConfig.cellAddresses.push_back(static_cast<uint16_t>(std::strtol(argv[++i], nullptr, 0)));
+        } else if (std::strcmp(argv[i], "--serve") == 0 && hasValue) {
+            serveName = argv[++i];
+        } else if (std::strcmp(argv[i], "--envs") == 0 && hasValue) {
+            envConfig.numEnvs = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+            envConfig.numThreads = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--frame-skip") == 0 && hasValue) {
+            envConfig.frameSkip = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--warmup") == 0 && hasValue) {
+            envConfig.warmupFrames = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--reward-addr") == 0 && hasValue) {
+            envConfig.rewardAddress = static_cast<int>(std::strtol(argv[++i], nullptr, 0));
+        } else if (std::strcmp(argv[i], "--done-addr") == 0 && hasValue) {
+            envConfig.doneAddress = static_cast<int>(std::strtol(argv[++i], nullptr, 0));
+        } else if (std::strcmp(argv[i], "--max-frames") == 0 && hasValue) {
+            envConfig.maxEpisodeFrames = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--fork-server") == 0) {
+            forkServer = true;
+        } else if (std::strcmp(argv[i], "--timeout") == 0 && hasValue) {
+            timeoutSeconds = std::atoi(argv[++i]);
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << "\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (diffPaths[0] != nullptr) {
+        return runDiffStates(romPath, diffPaths[0], diffPaths[1]);
+    }
+    if (auditPath != nullptr) {
+        return runAudit(romPath, auditPath, framesGiven ? frames : 0);
+    }
+    if (!serveName.empty()) {
+        return runServer(romPath, serveName, envConfig);
+    }
+    if (forkServer) {
+        gblator::ForkServerConfig forkConfig;
+        forkConfig.warmupFrames = envConfig.warmupFrames;
+        forkConfig.timeoutSeconds = timeoutSeconds;
+        return runForkServer(romPath, forkConfig);
+    }
+    if (exploreGenerations > 0) {
+        exploreConfig.numThreads = envConfig.numThreads;
+        exploreConfig.warmupFrames = envConfig.warmupFrames;
+        return runExplorer(romPath, exploreGenerations, exploreConfig);
+    }
+    if (instances > 1) {
+        return runInstances(romPath, instances, workers, frames);
+    }
+    if (linkPath != nullptr) {
+        return runLinked(romPath, linkPath, frames);
+    }
+    if (!linkSocket.empty()) {
+        return runLinkSession(romPath, linkSocket, linkListen, frames);
+    }
 
-    // Create memory and load the ROM into it
-    gblator::Memory memory;
-    if (!memory.loadROM(romPath)) {
+    // Create the console and load the ROM into it
+    gblator::GameBoy gb;
+    if (!gb.loadROM(romPath)) {
         std::cerr << "Failed to load ROM file: " << romPath << "\n";
         return 1;
     }
+    if (!selectEngine(gb, engineName, engineCachePath)) {
+        return 1;
+    }
 
-    // Create CPU attached to memory and reset it
-    gblator::CPU cpu(memory);
-    cpu.reset();
+    // Run the requested number of frames, paced to 59.73 Hz in real-time
+    // mode. A halted guest lets the host thread sleep instead of spinning.
+    gb.setRealTime(realTime);
+    gblator::DiagnosticLogger logger(std::cerr);
+    logger.attach(gb.cpu().diagnostics(), romPath);
+    gblator::GuestTrace guestTrace;
+    for (uint16_t address : watchedRegisters) {
+        guestTrace.watchRegister(address);
+    }
+    if (!guestTracePath.empty()) {
+        gb.setTrace(&guestTrace);
+    }
+    if (hwCounters && !gb.enableHardwareCounters()) {
+        std::cerr << "Hardware counters are not available; continuing without them\n";
+    }
+    for (int i = 0; i < frames; ++i) {
+        gb.runFrame();
+    }
 
-    // Execute a limited number of instructions to demonstrate the setup
-    // In a full emulator this loop would continue until the program ends
-    for (int i = 0; i < 50; ++i) {
-        cpu.step();
+    if (countersFormat == "json") {
+        gblator::writeCountersJson(gb.counters(), std::cout);
+        std::cout << "\n";
+    } else if (countersFormat == "prometheus") {
+        gblator::writeCountersPrometheus(gb.counters(), std::cout);
+    }
+    // Access counts are only gathered in builds configured with GBLATOR_MEMORY_STATS
+    if (memoryStats) {
+        gblator::writeAccessStatsJson(gb.memory().accessStats(), static_cast<uint64_t>(frames), std::cout);
+        std::cout << "\n";
+    }
+    if (!guestTracePath.empty()) {
+        std::ofstream trace(guestTracePath);
+        guestTrace.writePerfettoJson(trace);
+    }
+    if (!saveStatePath.empty()) {
+        std::vector<uint8_t> state(gb.stateSize());
+        gb.saveState(state.data(), state.size());
+        std::ofstream file(saveStatePath, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(state.data()), static_cast<std::streamsize>(state.size()));
+        if (!file) {
+            std::cerr << "Failed to write save state: " << saveStatePath << "\n";
+            return 1;
+        }
+    }
+    // Zones are only recorded in builds configured with GBLATOR_PROFILE
+    if (!tracePath.empty()) {
+        std::ofstream trace(tracePath);
+        gblator::writeChromeTrace(trace);
     }
 
     return 0;
-}
\ No newline at end of file
+}
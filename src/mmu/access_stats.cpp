@@ -0,0 +1,67 @@
+//
+// Implementation of the memory access statistics helpers.
+//
+
+#include "mmu/access_stats.h"
+#include <ostream>
+
+namespace gblator {
+
+namespace {
+
+const char* const kRegionNames[kAccessRegions] = {
+    "ROM0", "ROMX", "VRAM", "ERAM", "WRAM0", "WRAMX", "Echo", "OAM", "Unusable", "IO", "HRAM", "IE",
+};
+
+void writeCount(std::ostream& out, uint64_t reads, uint64_t writes, uint64_t frames) {
+    out << "{\"reads\":" << reads << ",\"writes\":" << writes;
+    if (frames > 0) {
+        out << ",\"reads_per_frame\":" << static_cast<double>(reads) / static_cast<double>(frames)
+            << ",\"writes_per_frame\":" << static_cast<double>(writes) / static_cast<double>(frames);
+    }
+    out << '}';
+}
+
+} // namespace
+
+AccessRegion accessRegion(uint16_t address) {
+    if (address < 0x4000) return AccessRegion::ROM0;
+    if (address < 0x8000) return AccessRegion::ROMX;
+    if (address < 0xA000) return AccessRegion::VRAM;
+    if (address < 0xC000) return AccessRegion::ERAM;
+    if (address < 0xD000) return AccessRegion::WRAM0;
+    if (address < 0xE000) return AccessRegion::WRAMX;
+    if (address < 0xFE00) return AccessRegion::Echo;
+    if (address < 0xFEA0) return AccessRegion::OAM;
+    if (address < 0xFF00) return AccessRegion::Unusable;
+    if (address < 0xFF80) return AccessRegion::IO;
+    if (address < 0xFFFF) return AccessRegion::HRAM;
+    return AccessRegion::IE;
+}
+
+const char* accessRegionName(AccessRegion region) {
+    int index = static_cast<int>(region);
+    return index >= 0 && index < kAccessRegions ? kRegionNames[index] : "?";
+}
+
+void writeAccessStatsJson(const MemoryAccessStats& stats, uint64_t frames, std::ostream& out) {
+    out << "{\"frames\":" << frames << ",\"regions\":{";
+    for (int i = 0; i < kAccessRegions; ++i) {
+        out << (i == 0 ? "" : ",") << '"' << kRegionNames[i] << "\":";
+        writeCount(out, stats.reads[i], stats.writes[i], frames);
+    }
+    out << "},\"io\":{";
+    bool first = true;
+    static const char kDigits[] = "0123456789ABCDEF";
+    for (int i = 0; i < 0x80; ++i) {
+        if (stats.ioReads[i] == 0 && stats.ioWrites[i] == 0) {
+            continue;
+        }
+        out << (first ? "" : ",") << "\"0xFF" << kDigits[i >> 4] << kDigits[i & 0xF] << "\":";
+        writeCount(out, stats.ioReads[i], stats.ioWrites[i], frames);
+        first = false;
+    }
+    out << "}}";
+}
+
+} // namespace gblator
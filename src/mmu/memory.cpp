@@ -3,25 +3,42 @@
 //
 
 #include "mmu/memory.h"
+#include "core/guest_trace.h"
+#include "core/input_latency.h"
+#include "core/state.h"
+#include "sched/cycle_scheduler.h"
+#include "utils/profiler.h"
 #include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <fstream>
 #include <iterator>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace gblator {
 
 Memory::Memory()
-    : romBankLow_(1), romBankHigh_(0), bankingMode_(0), ramEnabled_(false),
-      vramBank_(0), wramBank_(1), cartType_(0), numRomBanks_(0), numRamBanks_(0) {
-    // Allocate and zero-initialise RAM regions
-    vram0_.assign(0x2000, 0);  // 8 KiB VRAM bank 0
-    vram1_.assign(0x2000, 0);  // 8 KiB VRAM bank 1 (used only in CGB)
-    wram_.assign(8 * 0x1000, 0);  // 8 banks of 4 KiB work RAM
+    : rom_(nullptr), romSize_(0), romBankLow_(1), romBankHigh_(0), bankingMode_(0), ramEnabled_(false),
+      vramBank_(0), wramBank_(1), cartType_(0), numRomBanks_(0), numRamBanks_(0),
+      bankSwitches_(0), dmaTransfers_(0), trace_(nullptr), latency_(nullptr),
+      scheduler_(nullptr), cpuAccess_(false) {
+#if defined(GBLATOR_MEMORY_STATS)
+    accessCounting_ = true;
+#endif
+    // Zero-initialise RAM regions
+    vram0_.fill(0);
+    vram1_.fill(0);
+    wram_.fill(0);
     eram_.clear();                // External RAM allocated when ROM is loaded
-    oam_.assign(0xA0, 0);         // 160 bytes of OAM
+    oam_.fill(0);
     std::fill(std::begin(ioRegisters_), std::end(ioRegisters_), 0);
-    hram_.assign(0x7F, 0);        // 127 bytes of HRAM
+    hram_.fill(0);
     ieRegister_ = 0;
+    joypadButtons_ = 0;
 }
 
 bool Memory::loadROM(const std::string &filepath) {
@@ -30,16 +47,98 @@ bool Memory::loadROM(const std::string &filepath) {
         return false;
     }
     // Load entire ROM into memory
-    romData_.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::vector<uint8_t> image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
     file.close();
-    if (romData_.empty()) {
+    if (image.empty()) {
+        return false;
+    }
+    romData_ = std::move(image);
+    rom_ = romData_.data();
+    romSize_ = romData_.size();
+    initCartridge();
+    return true;
+}
+
+bool Memory::loadROM(const uint8_t* data, size_t size) {
+    if (data == nullptr) {
+        return false;
+    }
+    return loadROM(std::span<const uint8_t>(data, size));
+}
+
+bool Memory::loadROM(std::span<const uint8_t> rom, RomOwnership ownership) {
+    if (rom.empty()) {
         return false;
     }
+    if (ownership == RomOwnership::Copy) {
+        romData_.assign(rom.begin(), rom.end());
+        rom_ = romData_.data();
+    } else {
+        // Release a previously copied image; the caller's buffer is used instead
+        std::vector<uint8_t>().swap(romData_);
+        rom_ = rom.data();
+    }
+    romSize_ = rom.size();
+    initCartridge();
+    return true;
+}
+
+bool Memory::loadROMFromFd(int fd) {
+#if defined(__unix__) || defined(__APPLE__)
+    std::vector<uint8_t> image;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+        // Regular file: one read of the known size, leaving the offset alone
+        image.resize(static_cast<size_t>(info.st_size));
+        size_t done = 0;
+        while (done < image.size()) {
+            ssize_t n = pread(fd, image.data() + done, image.size() - done, static_cast<off_t>(done));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            done += static_cast<size_t>(n);
+        }
+    } else {
+        // Pipe or socket: read until the writer closes its end
+        uint8_t chunk[16384];
+        for (;;) {
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                return false;
+            }
+            if (n == 0) {
+                break;
+            }
+            image.insert(image.end(), chunk, chunk + n);
+        }
+    }
+    if (image.empty()) {
+        return false;
+    }
+    romData_ = std::move(image);
+    rom_ = romData_.data();
+    romSize_ = romData_.size();
+    initCartridge();
+    return true;
+#else
+    (void)fd;
+    return false;
+#endif
+}
+
+void Memory::initCartridge() {
+    const uint8_t* romData = rom_;
     // Ensure there is at least a header to read cartridge info
-    if (romData_.size() >= 0x150) {
-        cartType_ = romData_[0x0147];
-        uint8_t romSizeCode = romData_[0x0148];
-        uint8_t ramSizeCode = romData_[0x0149];
+    if (romSize_ >= 0x150) {
+        cartType_ = romData[0x0147];
+        uint8_t romSizeCode = romData[0x0148];
+        uint8_t ramSizeCode = romData[0x0149];
         // Determine number of ROM banks using the ROM size code
         switch (romSizeCode) {
         case 0x00:
@@ -80,7 +179,7 @@ bool Memory::loadROM(const std::string &filepath) {
             break; // 1.5 MiB (unofficial)
         default:
             // Fallback: compute from file size (16 KiB per bank)
-            numRomBanks_ = romData_.size() / 0x4000;
+            numRomBanks_ = romSize_ / 0x4000;
             break;
         }
         if (numRomBanks_ == 0) {
@@ -113,7 +212,7 @@ bool Memory::loadROM(const std::string &filepath) {
     } else {
         // If header is missing, assume simplest ROM: 2 banks, no external RAM
         cartType_ = 0x00;
-        numRomBanks_ = romData_.size() / 0x4000;
+        numRomBanks_ = romSize_ / 0x4000;
         if (numRomBanks_ == 0) numRomBanks_ = 1;
         numRamBanks_ = 0;
     }
@@ -121,7 +220,6 @@ bool Memory::loadROM(const std::string &filepath) {
     eram_.assign(numRamBanks_ * 0x2000, 0);
     // Reset state to initial values
     reset();
-    return true;
 }
 
 void Memory::reset() {
@@ -134,6 +232,7 @@ void Memory::reset() {
     std::fill(std::begin(ioRegisters_), std::end(ioRegisters_), 0);
     std::fill(hram_.begin(), hram_.end(), 0);
     ieRegister_ = 0;
+    joypadButtons_ = 0;
     // Reset bank registers
     romBankLow_ = 1;
     romBankHigh_ = 0;
@@ -168,19 +267,22 @@ uint8_t Memory::currentRAMBank() const {
 }
 
 uint8_t Memory::readByte(uint16_t address) const {
+#if defined(GBLATOR_MEMORY_STATS)
+    countAccess(address, false);
+#endif
     if (address < 0x4000) {
         // Fixed ROM bank (00)
         size_t idx = address;
-        if (idx < romData_.size()) {
-            return romData_[idx];
+        if (idx < romSize_) {
+            return rom_[idx];
         }
         return 0xFF;
     } else if (address < 0x8000) {
         // Switchable ROM bank
         uint8_t bank = currentROMBank();
         size_t offset = (bank * 0x4000) + (address - 0x4000);
-        if (offset < romData_.size()) {
-            return romData_[offset];
+        if (offset < romSize_) {
+            return rom_[offset];
         }
         return 0xFF;
     } else if (address < 0xA000) {
@@ -230,6 +332,8 @@ uint8_t Memory::readByte(uint16_t address) const {
         uint8_t index = static_cast<uint8_t>(address - 0xFF00);
         // Some registers return certain bits set or cleared
         switch (address) {
+        case 0xFF00: // P1/JOYP - reflects the buttons at the time of the read
+            return joypadRegister();
         case 0xFF4F: // VBK - VRAM bank select
             // Bit 0 holds the bank number; upper bits often return 1
             return static_cast<uint8_t>(0xFE | (vramBank_ & 0x01));
@@ -250,6 +354,9 @@ uint8_t Memory::readByte(uint16_t address) const {
 }
 
 void Memory::writeByte(uint16_t address, uint8_t value) {
+#if defined(GBLATOR_MEMORY_STATS)
+    countAccess(address, true);
+#endif
     if (address < 0x2000) {
         // 0000–1FFF: RAM enable (MBC1). Only lower 4 bits are significant.
         // For ROM only carts, this has no effect.
@@ -260,22 +367,34 @@ void Memory::writeByte(uint16_t address, uint8_t value) {
     } else if (address < 0x4000) {
         // 2000–3FFF: ROM bank number (MBC1)
         if (cartType_ == 0x01 || cartType_ == 0x02 || cartType_ == 0x03) {
+            uint8_t previous = romBankLow_;
             romBankLow_ = value & 0x1F;
             // Bank number 0 maps to 1
             if ((romBankLow_ & 0x1F) == 0) {
                 romBankLow_ = 1;
             }
+            if (romBankLow_ != previous) {
+                noteBankSwitch(address, romBankLow_);
+            }
         }
         // else ignore
     } else if (address < 0x6000) {
         // 4000–5FFF: RAM bank number or upper bits of ROM bank number (MBC1)
         if (cartType_ == 0x01 || cartType_ == 0x02 || cartType_ == 0x03) {
+            uint8_t previous = romBankHigh_;
             romBankHigh_ = value & 0x03;
+            if (romBankHigh_ != previous) {
+                noteBankSwitch(address, romBankHigh_);
+            }
         }
     } else if (address < 0x8000) {
         // 6000–7FFF: Banking mode select (MBC1)
         if (cartType_ == 0x01 || cartType_ == 0x02 || cartType_ == 0x03) {
+            bool previous = bankingMode_;
             bankingMode_ = (value & 0x01);
+            if (bankingMode_ != previous) {
+                noteBankSwitch(address, bankingMode_);
+            }
         }
     } else if (address < 0xA000) {
         // 8000–9FFF: VRAM
@@ -323,39 +442,62 @@ void Memory::writeByte(uint16_t address, uint8_t value) {
     } else if (address < 0xFF80) {
         // FF00–FF7F: I/O registers
         uint8_t index = static_cast<uint8_t>(address - 0xFF00);
+        if (trace_ != nullptr) {
+            traceIoWrite(address, value);
+        }
+        if (scheduler_ != nullptr && (address == 0xFF07 || address == 0xFF40 || address == 0xFF41 ||
+                                      address == 0xFF44 || address == 0xFF45)) {
+            // The PPU and timer sleep until their next change, computed
+            // from TAC, LCDC, STAT, LY and LYC; catch them up first
+            scheduler_->invalidate();
+        }
         switch (address) {
         case 0xFF04:
             // DIV register: writing resets to 0 regardless of value
             resetDIV();
             break;
         case 0xFF00:
-            // Joypad input (P1): lower 4 bits reflect button states; just store for now
-            ioRegisters_[index] = value;
+            // Joypad input (P1): only the group select bits are writable;
+            // the lower 4 bits are computed on read
+            ioRegisters_[index] = static_cast<uint8_t>(0xCF | (value & 0x30));
             break;
         case 0xFF46: {
             // DMA transfer: writing a byte triggers a transfer from
             // (value << 8) to OAM. Copy 160 bytes.
+            GBLATOR_ZONE("oam_dma");
             uint16_t source = static_cast<uint16_t>(value) << 8;
             for (uint16_t i = 0; i < 0xA0; ++i) {
                 uint16_t srcAddr = source + i;
                 oam_[i] = readByte(srcAddr);
             }
+            ++dmaTransfers_;
+            if (trace_ != nullptr) {
+                trace_->record(GuestEvent::OamDma, 0, source);
+            }
             ioRegisters_[index] = value;
             break;
         }
         case 0xFF4F:
             // VBK: VRAM bank select
+            if ((value & 0x01) != vramBank_) {
+                noteBankSwitch(address, value & 0x01);
+            }
             vramBank_ = value & 0x01;
             ioRegisters_[index] = value;
             break;
-        case 0xFF70:
+        case 0xFF70: {
             // SVBK: WRAM bank select; 0->1
+            uint8_t previous = wramBank_;
             wramBank_ = value & 0x07;
             if (wramBank_ == 0) {
                 wramBank_ = 1;
             }
+            if (wramBank_ != previous) {
+                noteBankSwitch(address, wramBank_);
+            }
             ioRegisters_[index] = value;
             break;
+        }
         case 0xFF50:
             // Boot ROM disable; just store value
             ioRegisters_[index] = value;
@@ -394,4 +536,220 @@ void Memory::resetDIV() {
     // Reset the DIV register to zero. This is called when the CPU writes to FF04.
     ioRegisters_[0x04] = 0;
 }
+
+uint8_t Memory::pendingInterrupts() const {
+    return static_cast<uint8_t>(ieRegister_ & ioRegisters_[0x0F] & 0x1F);
+}
+
+uint8_t Memory::serialControl() const {
+    return ioRegisters_[0x02];
+}
+
+const MemoryAccessStats& Memory::accessStats() const {
+#if defined(GBLATOR_MEMORY_STATS)
+    return accessStats_;
+#else
+    static const MemoryAccessStats kEmpty;
+    return kEmpty;
+#endif
+}
+
+void Memory::clearAccessStats() {
+#if defined(GBLATOR_MEMORY_STATS)
+    accessStats_ = MemoryAccessStats();
+#endif
+}
+
+void Memory::setAccessCounting(bool enabled) {
+#if defined(GBLATOR_MEMORY_STATS)
+    accessCounting_ = enabled;
+#else
+    (void)enabled;
+#endif
+}
+
+#if defined(GBLATOR_MEMORY_STATS)
+void Memory::countAccess(uint16_t address, bool write) const {
+    if (!accessCounting_) {
+        return;
+    }
+    int region = static_cast<int>(accessRegion(address));
+    (write ? accessStats_.writes : accessStats_.reads)[region]++;
+    if (address >= 0xFF00 && address < 0xFF80) {
+        (write ? accessStats_.ioWrites : accessStats_.ioReads)[address - 0xFF00]++;
+    }
+}
+#endif
+
+void Memory::setTrace(GuestTrace* trace) {
+    trace_ = trace;
+}
+
+GuestTrace* Memory::trace() const {
+    return trace_;
+}
+
+void Memory::setLatencyProbe(InputLatency* probe) {
+    latency_ = probe;
+}
+
+InputLatency* Memory::latencyProbe() const {
+    return latency_;
+}
+
+void Memory::setCpuAccess(bool cpu) {
+    cpuAccess_ = cpu;
+}
+
+void Memory::setScheduler(CycleScheduler* scheduler) {
+    scheduler_ = scheduler;
+}
+
+void Memory::setJoypadButtons(uint8_t buttons) {
+    joypadButtons_ = buttons;
+}
+
+uint8_t Memory::joypadRegister() const {
+    uint8_t select = ioRegisters_[0x00];
+    // Bits 4 and 5 select button groups: 0 = select, 1 = deselect
+    uint8_t visible = 0;
+    if ((select & 0x10) == 0) {
+        visible |= 0xF0; // Start, Select, B, A
+    }
+    if ((select & 0x20) == 0) {
+        visible |= 0x0F; // Down, Up, Left, Right
+    }
+    if (latency_ != nullptr && cpuAccess_) {
+        latency_->joypadRead(visible);
+    }
+    uint8_t pressed = joypadButtons_ & visible;
+    // Both groups share bits 3..0; buttons are active-low
+    uint8_t lowNibble = static_cast<uint8_t>(~((pressed >> 4) | pressed) & 0x0F);
+    return static_cast<uint8_t>(0xC0 | (select & 0x30) | lowNibble);
+}
+
+void Memory::noteBankSwitch(uint16_t address, uint8_t bank) {
+    ++bankSwitches_;
+    if (trace_ != nullptr) {
+        trace_->record(GuestEvent::BankSwitch, bank, address);
+    }
+}
+
+void Memory::traceIoWrite(uint16_t address, uint8_t value) {
+    uint8_t previous = ioRegisters_[address - 0xFF00];
+    if (address == 0xFF0F) {
+        // Every interrupt source requests through IF, so newly set bits
+        // are the requests
+        uint8_t raised = static_cast<uint8_t>(value & ~previous & 0x1F);
+        for (uint8_t bit = 0; bit < 5; ++bit) {
+            if (raised & (1 << bit)) {
+                trace_->record(GuestEvent::InterruptRequested, bit);
+            }
+        }
+    } else if (address == 0xFF40 && ((value ^ previous) & 0x80) != 0) {
+        trace_->record((value & 0x80) ? GuestEvent::LcdOn : GuestEvent::LcdOff);
+    }
+    trace_->record(GuestEvent::IoWrite, value, address);
+}
+
+uint64_t Memory::bankSwitches() const {
+    return bankSwitches_;
+}
+
+uint64_t Memory::dmaTransfers() const {
+    return dmaTransfers_;
+}
+
+std::span<const uint8_t> Memory::romImage() const {
+    return std::span<const uint8_t>(rom_, romSize_);
+}
+
+uint8_t* Memory::regionData(Region region, size_t& size) {
+    switch (region) {
+    case Region::VRAM0: size = vram0_.size(); return vram0_.data();
+    case Region::VRAM1: size = vram1_.size(); return vram1_.data();
+    case Region::WRAM:  size = wram_.size(); return wram_.data();
+    case Region::OAM:   size = oam_.size(); return oam_.data();
+    case Region::HRAM:  size = hram_.size(); return hram_.data();
+    case Region::IO:    size = sizeof(ioRegisters_); return ioRegisters_;
+    case Region::ERAM:
+        if (!eram_.empty()) {
+            size = eram_.size();
+            return eram_.data();
+        }
+        break;
+    }
+    size = 0;
+    return nullptr;
+}
+
+// -----------------------------------------------------------------------------
+// Save states
+//
+// The RAM regions have fixed sizes except cartridge RAM, whose size is
+// written first so a state cannot be restored onto a different cartridge.
+
+void Memory::saveState(StateWriter& writer) const {
+    writer.section("Cartridge RAM size");
+    uint32_t eramSize = static_cast<uint32_t>(eram_.size());
+    writer.value(eramSize);
+    // Banked regions are written one bank at a time so a layout can
+    // report guest addresses; the bytes are the same as in one write
+    for (size_t offset = 0; offset < eram_.size(); offset += 0x2000) {
+        writer.section("ERAM", 0xA000, static_cast<int>(offset / 0x2000));
+        writer.write(eram_.data() + offset, std::min<size_t>(0x2000, eram_.size() - offset));
+    }
+    for (size_t offset = 0; offset < wram_.size(); offset += 0x1000) {
+        writer.section("WRAM", offset == 0 ? 0xC000 : 0xD000, static_cast<int>(offset / 0x1000));
+        writer.write(wram_.data() + offset, 0x1000);
+    }
+    writer.section("VRAM", 0x8000, 0);
+    writer.write(vram0_.data(), vram0_.size());
+    writer.section("VRAM", 0x8000, 1);
+    writer.write(vram1_.data(), vram1_.size());
+    writer.section("OAM", 0xFE00);
+    writer.write(oam_.data(), oam_.size());
+    writer.section("IO", 0xFF00);
+    writer.write(ioRegisters_, sizeof(ioRegisters_));
+    writer.section("HRAM", 0xFF80);
+    writer.write(hram_.data(), hram_.size());
+    writer.section("IE", 0xFFFF);
+    writer.value(ieRegister_);
+    writer.section("Banking registers");
+    writer.value(romBankLow_);
+    writer.value(romBankHigh_);
+    writer.value(bankingMode_);
+    writer.value(ramEnabled_);
+    writer.value(vramBank_);
+    writer.value(wramBank_);
+}
+
+bool Memory::acceptsState(StateReader reader) const {
+    uint32_t eramSize = 0;
+    reader.value(eramSize);
+    return reader.ok() && eramSize == eram_.size();
+}
+
+void Memory::loadState(StateReader& reader) {
+    uint32_t eramSize = 0;
+    reader.value(eramSize);
+    if (eramSize != eram_.size()) {
+        reader.fail();
+        return;
+    }
+    reader.read(eram_.data(), eram_.size());
+    reader.read(wram_.data(), wram_.size());
+    reader.read(vram0_.data(), vram0_.size());
+    reader.read(vram1_.data(), vram1_.size());
+    reader.read(oam_.data(), oam_.size());
+    reader.read(ioRegisters_, sizeof(ioRegisters_));
+    reader.read(hram_.data(), hram_.size());
+    reader.value(ieRegister_);
+    reader.value(romBankLow_);
+    reader.value(romBankHigh_);
+    reader.value(bankingMode_);
+    reader.value(ramEnabled_);
+    reader.value(vramBank_);
+    reader.value(wramBank_);
+}
 } // namespace gblator
\ No newline at end of file
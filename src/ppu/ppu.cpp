@@ -4,11 +4,19 @@
 
 #include "ppu/ppu.h"
 #include "mmu/memory.h"
+#include "core/guest_trace.h"
+#include "core/input_latency.h"
+#include "core/state.h"
+#include "utils/profiler.h"
+#include <climits>
+#include <cstring>
 
 namespace gblator {
 
 PPU::PPU(Memory& memory)
-    : memory_(memory), dotCounter_(0), ly_(0), mode_(2), vblankTriggered_(false) {
+    : memory_(memory), dotCounter_(0), ly_(0), mode_(2), vblankTriggered_(false),
+      windowLine_(0), frontBuffer_(0), frameCount_(0) {
+    std::memset(frameBuffers_, 0, sizeof(frameBuffers_));
 }
 
 void PPU::reset() {
@@ -16,6 +24,10 @@ void PPU::reset() {
     ly_ = 0;
     mode_ = 2; // Mode 2 (OAM search) at start of frame
     vblankTriggered_ = false;
+    windowLine_ = 0;
+    frontBuffer_ = 0;
+    frameCount_ = 0;
+    std::memset(frameBuffers_, 0, sizeof(frameBuffers_));
     // Write initial LY value to memory
     memory_.writeByte(0xFF44, ly_);
     updateSTAT();
@@ -24,6 +36,7 @@ void PPU::reset() {
 void PPU::updateSTAT() {
     // Read current STAT register
     uint8_t stat = memory_.readByte(0xFF41);
+    uint8_t previous = stat;
     // Set the lower two bits to the current PPU mode
     stat = static_cast<uint8_t>((stat & 0xFC) | (mode_ & 0x03));
     // Set or clear the LYC=LY flag (bit 2)
@@ -33,9 +46,191 @@ void PPU::updateSTAT() {
     } else {
         stat &= static_cast<uint8_t>(~0x04);
     }
+    if (GuestTrace* trace = memory_.trace()) {
+        if (((stat ^ previous) & 0x03) != 0) {
+            trace->record(GuestEvent::PpuMode, mode_, ly_);
+        }
+        if ((stat & ~previous & 0x04) != 0) {
+            trace->record(GuestEvent::LycMatch, 0, ly_);
+        }
+    }
     memory_.writeByte(0xFF41, stat);
 }
 
+const uint8_t* PPU::frameBuffer() const {
+    return frameBuffers_[frontBuffer_];
+}
+
+uint64_t PPU::frameCount() const {
+    return frameCount_;
+}
+
+void PPU::renderScanline() {
+    GBLATOR_ZONE("ppu_line");
+    uint8_t* line = frameBuffers_[1 - frontBuffer_] + ly_ * kScreenWidth;
+    uint8_t lcdc = memory_.readByte(0xFF40);
+    // Raw background/window colour numbers, needed for object priority
+    uint8_t colors[kScreenWidth] = {};
+
+    // Colour number (0-3) of pixel (px, py) of the 256×256 tile map at mapBase
+    auto tilePixel = [&](uint16_t mapBase, uint8_t px, uint8_t py) -> uint8_t {
+        uint8_t tileIndex = memory_.readByte(static_cast<uint16_t>(mapBase + (py / 8) * 32 + (px / 8)));
+        uint16_t tileAddr;
+        if (lcdc & 0x10) {
+            // 8000 addressing: unsigned tile index
+            tileAddr = static_cast<uint16_t>(0x8000 + tileIndex * 16);
+        } else {
+            // 8800 addressing: signed tile index relative to 9000
+            tileAddr = static_cast<uint16_t>(0x9000 + static_cast<int8_t>(tileIndex) * 16);
+        }
+        uint16_t rowAddr = static_cast<uint16_t>(tileAddr + (py % 8) * 2);
+        uint8_t lo = memory_.readByte(rowAddr);
+        uint8_t hi = memory_.readByte(static_cast<uint16_t>(rowAddr + 1));
+        int bit = 7 - (px % 8);
+        return static_cast<uint8_t>(((lo >> bit) & 1) | (((hi >> bit) & 1) << 1));
+    };
+
+    // Background and window (LCDC bit 0 disables both on DMG)
+    if (lcdc & 0x01) {
+        uint8_t scy = memory_.readByte(0xFF42);
+        uint8_t scx = memory_.readByte(0xFF43);
+        uint16_t bgMap = (lcdc & 0x08) ? 0x9C00 : 0x9800;
+        uint8_t y = static_cast<uint8_t>(ly_ + scy);
+        for (int x = 0; x < kScreenWidth; ++x) {
+            colors[x] = tilePixel(bgMap, static_cast<uint8_t>(x + scx), y);
+        }
+        uint8_t wy = memory_.readByte(0xFF4A);
+        int wx = memory_.readByte(0xFF4B) - 7;
+        if ((lcdc & 0x20) && ly_ >= wy && wx < kScreenWidth) {
+            uint16_t winMap = (lcdc & 0x40) ? 0x9C00 : 0x9800;
+            for (int x = wx < 0 ? 0 : wx; x < kScreenWidth; ++x) {
+                colors[x] = tilePixel(winMap, static_cast<uint8_t>(x - wx), windowLine_);
+            }
+            ++windowLine_;
+        }
+    }
+    uint8_t bgp = memory_.readByte(0xFF47);
+    for (int x = 0; x < kScreenWidth; ++x) {
+        line[x] = static_cast<uint8_t>((bgp >> (colors[x] * 2)) & 0x03);
+    }
+
+    // Objects (sprites)
+    if ((lcdc & 0x02) == 0) {
+        return;
+    }
+    int height = (lcdc & 0x04) ? 16 : 8;
+    // Select the first ten objects in OAM that overlap this line
+    int selected[10];
+    int count = 0;
+    for (int i = 0; i < 40 && count < 10; ++i) {
+        int y = memory_.readByte(static_cast<uint16_t>(0xFE00 + i * 4)) - 16;
+        if (ly_ >= y && ly_ < y + height) {
+            selected[count++] = i;
+        }
+    }
+    // Order by X coordinate (ties keep OAM order), lowest X has priority
+    for (int i = 1; i < count; ++i) {
+        int obj = selected[i];
+        uint8_t objX = memory_.readByte(static_cast<uint16_t>(0xFE00 + obj * 4 + 1));
+        int j = i - 1;
+        while (j >= 0 && memory_.readByte(static_cast<uint16_t>(0xFE00 + selected[j] * 4 + 1)) > objX) {
+            selected[j + 1] = selected[j];
+            --j;
+        }
+        selected[j + 1] = obj;
+    }
+    // Draw from lowest to highest priority so the latter ends on top
+    for (int i = count - 1; i >= 0; --i) {
+        uint16_t base = static_cast<uint16_t>(0xFE00 + selected[i] * 4);
+        int y = memory_.readByte(base) - 16;
+        int x = memory_.readByte(static_cast<uint16_t>(base + 1)) - 8;
+        uint8_t tile = memory_.readByte(static_cast<uint16_t>(base + 2));
+        uint8_t attrs = memory_.readByte(static_cast<uint16_t>(base + 3));
+        if (height == 16) {
+            tile &= 0xFE;
+        }
+        int row = ly_ - y;
+        if (attrs & 0x40) {
+            row = height - 1 - row; // Y flip
+        }
+        uint16_t rowAddr = static_cast<uint16_t>(0x8000 + tile * 16 + row * 2);
+        uint8_t lo = memory_.readByte(rowAddr);
+        uint8_t hi = memory_.readByte(static_cast<uint16_t>(rowAddr + 1));
+        uint8_t palette = memory_.readByte((attrs & 0x10) ? 0xFF49 : 0xFF48);
+        for (int col = 0; col < 8; ++col) {
+            int sx = x + col;
+            if (sx < 0 || sx >= kScreenWidth) {
+                continue;
+            }
+            int bit = (attrs & 0x20) ? col : 7 - col; // X flip
+            uint8_t color = static_cast<uint8_t>(((lo >> bit) & 1) | (((hi >> bit) & 1) << 1));
+            if (color == 0) {
+                continue; // transparent
+            }
+            if ((attrs & 0x80) && colors[sx] != 0) {
+                continue; // behind non-zero background colours
+            }
+            line[sx] = static_cast<uint8_t>((palette >> (color * 2)) & 0x03);
+        }
+    }
+}
+
+void PPU::saveState(StateWriter& writer) const {
+    writer.value(dotCounter_);
+    writer.value(ly_);
+    writer.value(mode_);
+    writer.value(vblankTriggered_);
+    writer.value(windowLine_);
+    writer.value(frontBuffer_);
+    writer.value(frameCount_);
+    writer.section("PPU frame buffers");
+    writer.write(frameBuffers_, sizeof(frameBuffers_));
+}
+
+void PPU::loadState(StateReader& reader) {
+    reader.value(dotCounter_);
+    reader.value(ly_);
+    reader.value(mode_);
+    reader.value(vblankTriggered_);
+    reader.value(windowLine_);
+    reader.value(frontBuffer_);
+    reader.value(frameCount_);
+    reader.read(frameBuffers_, sizeof(frameBuffers_));
+    frontBuffer_ &= 1;
+}
+
+int PPU::cyclesUntilNextEvent() const {
+    uint8_t lcdc = memory_.readByte(0xFF40);
+    if ((lcdc & 0x80) == 0) {
+        return INT_MAX;
+    }
+    // Dots remaining until LY reaches 144, wrapping into the next frame
+    // when VBlank has already started
+    int dots = (144 - ly_) * 456 - dotCounter_;
+    if (ly_ >= 144) {
+        dots += 154 * 456;
+    }
+    // Round up to whole CPU cycles (4 dots each)
+    return (dots + 3) / 4;
+}
+
+int PPU::cyclesUntilNextChange() const {
+    uint8_t lcdc = memory_.readByte(0xFF40);
+    if ((lcdc & 0x80) == 0) {
+        return INT_MAX;
+    }
+    // Visible lines change mode at dots 80 and 252; every line ends at 456
+    int boundary = 456;
+    if (ly_ < 144) {
+        if (dotCounter_ < 80) {
+            boundary = 80;
+        } else if (dotCounter_ < 80 + 172) {
+            boundary = 80 + 172;
+        }
+    }
+    return (boundary - dotCounter_ + 3) / 4;
+}
+
 void PPU::step(int cycles) {
     // Convert CPU cycles to PPU dots; 1 CPU cycle = 4 dots at single speed
     int dots = cycles * 4;
@@ -55,10 +250,20 @@ void PPU::step(int cycles) {
     // Process dots, potentially advancing multiple scanlines
     while (dotCounter_ >= 456) {
         dotCounter_ -= 456;
+        if (ly_ < 144) {
+            // The visible line is complete; draw it
+            renderScanline();
+        }
         ly_++;
         if (ly_ == 144) {
-            // Enter VBlank
+            // Enter VBlank and present the finished frame
             mode_ = 1;
+            frontBuffer_ = 1 - frontBuffer_;
+            ++frameCount_;
+            if (InputLatency* probe = memory_.latencyProbe()) {
+                probe->framePresented(frameBuffers_[frontBuffer_], frameBuffers_[1 - frontBuffer_],
+                                      sizeof(frameBuffers_[0]));
+            }
             // Request VBlank interrupt if not already triggered
             if (!vblankTriggered_) {
                 uint8_t iflags = memory_.readByte(0xFF0F);
@@ -71,6 +276,7 @@ void PPU::step(int cycles) {
             ly_ = 0;
             mode_ = 2;
             vblankTriggered_ = false;
+            windowLine_ = 0;
         } else if (ly_ < 144) {
             // Visible scanlines start in mode 2
             mode_ = 2;
@@ -0,0 +1,150 @@
+//
+// Implementation of the CycleScheduler class.
+//
+
+#include "sched/cycle_scheduler.h"
+#include <climits>
+
+namespace gblator {
+
+ComponentTask::~ComponentTask() {
+    if (handle_) {
+        handle_.destroy();
+    }
+}
+
+void CycleScheduler::Sleep::await_suspend(ComponentTask::Handle handle) noexcept {
+    slot_ = handle.promise().slot;
+    Slot& slot = scheduler_.slots_[slot_];
+    slot.due = cycles_ == INT_MAX ? UINT64_MAX : scheduler_.now_ + static_cast<uint64_t>(cycles_ > 1 ? cycles_ : 1);
+}
+
+int CycleScheduler::Sleep::await_resume() noexcept {
+    Slot& slot = scheduler_.slots_[slot_];
+    uint64_t elapsed = scheduler_.now_ - slot.lastRun;
+    slot.lastRun = scheduler_.now_;
+    return elapsed > INT_MAX ? INT_MAX : static_cast<int>(elapsed);
+}
+
+CycleScheduler::CycleScheduler()
+    : count_(0), now_(0), nextDue_(UINT64_MAX), resumes_(0), resuming_(false), resyncPending_(false),
+      arenaUsed_(0) {
+}
+
+CycleScheduler::~CycleScheduler() {
+    for (int i = 0; i < count_; ++i) {
+        slots_[i].handle.destroy();
+    }
+}
+
+void* CycleScheduler::allocate(size_t size) noexcept {
+    // Keep every frame aligned like the arena itself
+    constexpr size_t kAlign = alignof(std::max_align_t);
+    size_t rounded = (size + kAlign - 1) & ~(kAlign - 1);
+    if (rounded > kArenaSize - arenaUsed_) {
+        return nullptr;
+    }
+    void* frame = arena_ + arenaUsed_;
+    arenaUsed_ += rounded;
+    return frame;
+}
+
+bool CycleScheduler::spawn(ComponentTask task) {
+    if (!task.handle_ || count_ == kMaxTasks) {
+        return false;
+    }
+    int index = count_++;
+    Slot& slot = slots_[index];
+    slot.handle = task.handle_;
+    slot.lastRun = now_;
+    task.handle_ = nullptr;
+    slot.handle.promise().slot = index;
+    // Run the body up to its first sleep, which sets the due cycle
+    resume(index);
+    updateNextDue();
+    return true;
+}
+
+void CycleScheduler::resume(int slot) {
+    bool nested = resuming_;
+    resuming_ = true;
+    ++resumes_;
+    slots_[slot].handle.resume();
+    resuming_ = nested;
+}
+
+void CycleScheduler::resumeAll() {
+    for (int i = 0; i < count_; ++i) {
+        resume(i);
+    }
+}
+
+void CycleScheduler::runUntil(uint64_t now) {
+    if (resyncPending_) {
+        // A timing register changed during the last instruction: step
+        // every component over it, as if each instruction were ticked
+        resyncPending_ = false;
+        now_ = now;
+        resumeAll();
+    } else {
+        for (;;) {
+            int next = -1;
+            for (int i = 0; i < count_; ++i) {
+                if (slots_[i].due <= now && (next < 0 || slots_[i].due < slots_[next].due)) {
+                    next = i;
+                }
+            }
+            if (next < 0) {
+                break;
+            }
+            now_ = slots_[next].due;
+            resume(next);
+        }
+        now_ = now;
+    }
+    updateNextDue();
+}
+
+void CycleScheduler::jumpTo(uint64_t now) {
+    resyncPending_ = false;
+    now_ = now;
+    resumeAll();
+    updateNextDue();
+}
+
+void CycleScheduler::syncAll() {
+    if (resuming_) {
+        return;
+    }
+    resumeAll();
+    updateNextDue();
+}
+
+void CycleScheduler::invalidate() {
+    if (resuming_) {
+        return;
+    }
+    resumeAll();
+    resyncPending_ = true;
+    nextDue_ = 0;
+}
+
+void CycleScheduler::restart() {
+    for (int i = 0; i < count_; ++i) {
+        slots_[i].lastRun = now_;
+    }
+    resumeAll();
+    resyncPending_ = true;
+    nextDue_ = 0;
+}
+
+void CycleScheduler::updateNextDue() {
+    nextDue_ = resyncPending_ ? 0 : UINT64_MAX;
+    for (int i = 0; i < count_; ++i) {
+        if (slots_[i].due < nextDue_) {
+            nextDue_ = slots_[i].due;
+        }
+    }
+}
+
+} // namespace gblator
@@ -0,0 +1,158 @@
+//
+// Implementation of the EdfScheduler class.
+//
+
+#include "sched/edf_scheduler.h"
+#include "core/core.h"
+#include "joypad/joypad.h"
+#include "utils/affinity.h"
+#include "utils/profiler.h"
+#include <algorithm>
+
+namespace gblator {
+
+namespace {
+
+// Heap ordering: the entry with the earliest deadline on top
+struct LaterDeadline {
+    template <typename Entry>
+    bool operator()(const Entry* a, const Entry* b) const {
+        return a->deadline > b->deadline;
+    }
+};
+
+} // namespace
+
+EdfScheduler::Clock::duration EdfScheduler::framePeriod() {
+    int64_t ns = static_cast<int64_t>(GameBoy::kCyclesPerFrame) * 1000000000 / GameBoy::kCyclesPerSecond;
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(ns));
+}
+
+EdfScheduler::EdfScheduler(int workers, bool pinThreads) : stopping_(false) {
+    unsigned cpus = cpuCount();
+    for (int i = 0; i < std::max(1, workers); ++i) {
+        workers_.emplace_back(&EdfScheduler::workerLoop, this);
+        if (pinThreads) {
+            pinThread(workers_.back(), static_cast<unsigned>(i) % cpus);
+        }
+    }
+}
+
+EdfScheduler::~EdfScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+int EdfScheduler::add(GameBoy& gb, FrameCallback onFrame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unique_ptr<Entry> entry(new Entry());
+    entry->gb = &gb;
+    entry->onFrame = std::move(onFrame);
+    entry->release = Clock::now();
+    entry->deadline = entry->release + framePeriod();
+    entry->active = true;
+    entries_.push_back(std::move(entry));
+    push(entries_.back().get());
+    wake_.notify_one();
+    return static_cast<int>(entries_.size() - 1);
+}
+
+void EdfScheduler::remove(int id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    Entry* entry = entries_[static_cast<size_t>(id)].get();
+    entry->active = false;
+    // Queued entries are discarded lazily by the workers; only a frame in
+    // progress has to be waited for
+    finished_.wait(lock, [entry]() { return !entry->running; });
+}
+
+void EdfScheduler::setInput(int id, uint8_t buttons) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[static_cast<size_t>(id)]->input.store(buttons, std::memory_order_relaxed);
+}
+
+EdfStats EdfScheduler::stats(int id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_[static_cast<size_t>(id)]->stats;
+}
+
+void EdfScheduler::push(Entry* entry) {
+    entry->queued = true;
+    heap_.push_back(entry);
+    std::push_heap(heap_.begin(), heap_.end(), LaterDeadline());
+}
+
+EdfScheduler::Entry* EdfScheduler::popEarliest() {
+    std::pop_heap(heap_.begin(), heap_.end(), LaterDeadline());
+    Entry* entry = heap_.back();
+    heap_.pop_back();
+    entry->queued = false;
+    return entry;
+}
+
+void EdfScheduler::workerLoop() {
+    const Clock::duration period = framePeriod();
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (heap_.empty()) {
+            wake_.wait(lock);
+            continue;
+        }
+        Entry* entry = heap_.front();
+        if (!entry->active) {
+            popEarliest();
+            continue;
+        }
+        // All instances share one period, so the earliest deadline is also
+        // the earliest release; sleep until it (or until the heap changes)
+        if (entry->release > Clock::now()) {
+            wake_.wait_until(lock, entry->release);
+            continue;
+        }
+        popEarliest();
+        entry->running = true;
+        lock.unlock();
+
+        // One whole frame is the unit of work
+        entry->gb->joypad().setButtons(entry->input.load(std::memory_order_relaxed));
+        entry->gb->runFrame();
+        if (entry->onFrame) {
+            GBLATOR_ZONE("frame_handoff");
+            entry->onFrame(*entry->gb);
+        }
+        Clock::time_point finished = Clock::now();
+
+        lock.lock();
+        EdfStats& stats = entry->stats;
+        ++stats.framesRun;
+        if (finished > entry->deadline) {
+            ++stats.deadlineMisses;
+            int64_t lateness = std::chrono::duration_cast<std::chrono::nanoseconds>(finished - entry->deadline).count();
+            stats.maxLatenessNs = std::max(stats.maxLatenessNs, lateness);
+        }
+        entry->release += period;
+        entry->deadline += period;
+        if (finished > entry->deadline) {
+            // More than a period behind: re-phase instead of bursting
+            // through frames to catch up
+            entry->release = finished;
+            entry->deadline = finished + period;
+            ++stats.resyncs;
+        }
+        entry->running = false;
+        if (entry->active) {
+            push(entry);
+            wake_.notify_one();
+        } else {
+            finished_.notify_all();
+        }
+    }
+}
+
+} // namespace gblator
@@ -0,0 +1,81 @@
+//
+// Implementation of the LinkCable class.
+//
+
+#include "serial/link_cable.h"
+#include "core/core.h"
+#include "serial/serial.h"
+#include "utils/profiler.h"
+#include <algorithm>
+#include <climits>
+
+namespace gblator {
+
+namespace {
+
+// Frame cycle at which the console's running transfer completes, or INT_MAX
+int completionCycle(GameBoy& gb) {
+    int remaining = gb.serial().cyclesUntilNextEvent();
+    return remaining == INT_MAX ? INT_MAX : gb.frameCycle() + remaining;
+}
+
+} // namespace
+
+LinkCable::LinkCable(GameBoy& first, GameBoy& second)
+    : first_(first), second_(second), exchanges_(0), slices_(0) {
+    first_.serial().setLinked(true);
+    second_.serial().setLinked(true);
+}
+
+LinkCable::~LinkCable() {
+    first_.serial().setLinked(false);
+    second_.serial().setLinked(false);
+}
+
+void LinkCable::runFrame() {
+    GBLATOR_ZONE("link_frame");
+    for (;;) {
+        int now = std::min(first_.frameCycle(), second_.frameCycle());
+        if (now >= GameBoy::kCyclesPerFrame) {
+            break;
+        }
+        // A transfer starting in this slice completes at or after its end,
+        // so neither console can need the other's state from the future
+        int target = now + Serial::kTransferCycles;
+        target = std::min(target, completionCycle(first_));
+        target = std::min(target, completionCycle(second_));
+        target = std::max(target, now + 1);
+        first_.runFrameUntil(target);
+        second_.runFrameUntil(target);
+        ++slices_;
+        exchange(first_.serial(), second_.serial());
+        exchange(second_.serial(), first_.serial());
+    }
+    // Both have reached the end of the frame; this only does the bookkeeping
+    first_.runFrame();
+    second_.runFrame();
+}
+
+void LinkCable::exchange(Serial& master, Serial& other) {
+    if (!master.transferDone()) {
+        return;
+    }
+    uint8_t sent = master.data();
+    if (other.waitingForClock()) {
+        master.completeTransfer(other.data());
+        other.completeTransfer(sent);
+        ++exchanges_;
+    } else {
+        master.completeTransfer(0xFF);
+    }
+}
+
+uint64_t LinkCable::exchanges() const {
+    return exchanges_;
+}
+
+uint64_t LinkCable::slices() const {
+    return slices_;
+}
+
+} // namespace gblator
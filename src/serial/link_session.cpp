@@ -0,0 +1,445 @@
+//
+// Implementation of the LinkSession class.
+//
+
+#include "serial/link_session.h"
+#include "core/core.h"
+#include "joypad/joypad.h"
+#include "serial/serial.h"
+#include "utils/profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define GBLATOR_HAVE_UNIX_SOCKETS 1
+#endif
+
+namespace gblator {
+
+namespace {
+
+// Record flags
+constexpr uint8_t kDone = 0x01;     // Internal clock transfer shifted out
+constexpr uint8_t kWaiting = 0x02;  // External clock transfer armed
+
+// Message kinds. A message is 16 bytes in host byte order (both ends
+// share the machine): kind, flags, SB, 5 bytes padding, 64-bit payload.
+constexpr uint8_t kHelloMessage = 1;   // Payload: protocol version, slices per frame, frames ahead
+constexpr uint8_t kRecordMessage = 2;  // Payload: boundary number
+constexpr size_t kMessageSize = 16;
+constexpr int64_t kProtocolVersion = 1;
+
+int64_t helloPayload(const LinkSessionConfig& config) {
+    return (kProtocolVersion << 48) | (static_cast<int64_t>(config.slicesPerFrame) << 24) |
+           static_cast<int64_t>(config.maxAheadFrames);
+}
+
+} // namespace
+
+LinkSession::LinkSession()
+    : gb_(nullptr), fd_(-1), sliceCycles_(0), agreed_(false), next_(0), remoteKnown_(-1), rollbackTo_(-1) {
+}
+
+LinkSession::~LinkSession() {
+    close();
+}
+
+bool LinkSession::isOpen() const {
+    return fd_ >= 0;
+}
+
+const LinkSessionStats& LinkSession::stats() const {
+    return stats_;
+}
+
+int LinkSession::exchangeResult(const Record& local, const Record& remote) {
+    // Same rule as LinkCable::exchange(), seen from this end
+    if (local.flags & kDone) {
+        return (remote.flags & kWaiting) ? remote.data : 0xFF;
+    }
+    if ((local.flags & kWaiting) && (remote.flags & kDone)) {
+        return remote.data;
+    }
+    return -1;
+}
+
+LinkSession::Record LinkSession::remoteRecord(int64_t boundary) const {
+    if (remoteKnown_ < 0) {
+        // Nothing received yet: predict the state after reset
+        return Record();
+    }
+    int64_t index = std::min(boundary, remoteKnown_);
+    const Remote& remote = remote_[static_cast<size_t>(index) % remote_.size()];
+    return remote.index == index ? remote.record : Record();
+}
+
+void LinkSession::queueRecord(int64_t boundary, const Record& record) {
+    uint8_t message[kMessageSize] = {kRecordMessage, record.flags, record.data};
+    std::memcpy(message + 8, &boundary, sizeof(boundary));
+    outbox_.insert(outbox_.end(), message, message + kMessageSize);
+}
+
+bool LinkSession::fail() {
+    close();
+    return false;
+}
+
+void LinkSession::simulateSlice(bool fresh, uint8_t buttons) {
+    const int64_t slicesPerFrame = config_.slicesPerFrame;
+    const int64_t boundary = next_;
+    const int slice = static_cast<int>(boundary % slicesPerFrame);
+    if (slice == 0) {
+        // Frame start: remember the input and take the state rollbacks return to
+        Frame& frame = frames_[static_cast<size_t>(boundary / slicesPerFrame) % frames_.size()];
+        if (fresh) {
+            frame.index = boundary / slicesPerFrame;
+            frame.buttons = buttons;
+        }
+        gb_->joypad().setButtons(frame.buttons);
+        gb_->saveState(frame.state.data(), frame.state.size());
+    }
+    Serial& serial = gb_->serial();
+    Record local;
+    local.flags = static_cast<uint8_t>((serial.transferDone() ? kDone : 0) | (serial.waitingForClock() ? kWaiting : 0));
+    local.data = serial.data();
+    Boundary& entry = boundaries_[static_cast<size_t>(boundary) % boundaries_.size()];
+    if (fresh) {
+        ++stats_.slices;
+        if (boundary > remoteKnown_) {
+            ++stats_.predictedSlices;
+        }
+        entry.index = boundary;
+        queueRecord(boundary, local);
+    } else if (local != entry.local) {
+        ++stats_.corrections;
+        queueRecord(boundary, local);
+    }
+    entry.local = local;
+    entry.result = exchangeResult(local, remoteRecord(boundary));
+    if (entry.result >= 0) {
+        serial.completeTransfer(static_cast<uint8_t>(entry.result));
+    }
+    gb_->runFrameUntil((slice + 1) * sliceCycles_);
+    if (slice == slicesPerFrame - 1) {
+        // The frame is complete; this only does its bookkeeping
+        gb_->runFrame();
+    }
+    ++next_;
+}
+
+bool LinkSession::rollback() {
+    GBLATOR_ZONE("link_rollback");
+    const int64_t slicesPerFrame = config_.slicesPerFrame;
+    int64_t frameIndex = rollbackTo_ / slicesPerFrame;
+    rollbackTo_ = -1;
+    const Frame& frame = frames_[static_cast<size_t>(frameIndex) % frames_.size()];
+    if (frame.index != frameIndex || !gb_->loadState(frame.state.data(), frame.state.size())) {
+        // The frame has left the history: the two ends can no longer agree
+        return false;
+    }
+    ++stats_.rollbacks;
+    int64_t end = next_;
+    next_ = frameIndex * slicesPerFrame;
+    while (next_ < end) {
+        simulateSlice(false, 0);
+        ++stats_.resimulatedSlices;
+    }
+    return true;
+}
+
+bool LinkSession::handleMessage(const uint8_t* bytes) {
+    int64_t payload;
+    std::memcpy(&payload, bytes + 8, sizeof(payload));
+    if (bytes[0] == kHelloMessage) {
+        if (agreed_ || payload != helloPayload(config_)) {
+            return false;
+        }
+        agreed_ = true;
+        return true;
+    }
+    // Records arrive in order; only corrections refer to the past
+    if (bytes[0] != kRecordMessage || !agreed_ || payload < 0 || payload > remoteKnown_ + 1) {
+        return false;
+    }
+    const int64_t boundary = payload;
+    Remote& remote = remote_[static_cast<size_t>(boundary) % remote_.size()];
+    remote.index = boundary;
+    remote.record.flags = bytes[1];
+    remote.record.data = bytes[2];
+    remoteKnown_ = std::max(remoteKnown_, boundary);
+    // The record also serves as the prediction for later boundaries
+    // without one; find the first exchange it changes
+    for (int64_t v = boundary; v < next_; ++v) {
+        if (v > boundary && v <= remoteKnown_) {
+            break;
+        }
+        const Boundary& entry = boundaries_[static_cast<size_t>(v) % boundaries_.size()];
+        if (entry.index != v) {
+            return false;
+        }
+        if (exchangeResult(entry.local, remote.record) != entry.result) {
+            if (rollbackTo_ < 0 || v < rollbackTo_) {
+                rollbackTo_ = v;
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+bool LinkSession::runFrame() {
+    if (fd_ < 0) {
+        return false;
+    }
+    GBLATOR_ZONE("link_frame");
+    // Input is sampled once; rolling back must not replace it
+    const uint8_t buttons = gb_->joypad().buttons();
+    const int64_t window = static_cast<int64_t>(config_.maxAheadFrames) * config_.slicesPerFrame;
+    if (!receive(false)) {
+        return fail();
+    }
+    for (int slice = 0; slice < config_.slicesPerFrame; ++slice) {
+        if (next_ - remoteKnown_ > window) {
+            // Too far past the peer: hand over our records and wait for theirs
+            ++stats_.stalls;
+            auto start = std::chrono::steady_clock::now();
+            if (!flush()) {
+                return fail();
+            }
+            while (next_ - remoteKnown_ > window) {
+                if (!receive(true)) {
+                    return fail();
+                }
+            }
+            stats_.stallNs += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+        }
+        if (rollbackTo_ >= 0 && !rollback()) {
+            return fail();
+        }
+        simulateSlice(true, buttons);
+    }
+    return flush() || fail();
+}
+
+#if defined(GBLATOR_HAVE_UNIX_SOCKETS)
+
+bool LinkSession::flush() {
+    size_t sent = 0;
+    while (sent < outbox_.size()) {
+#if defined(MSG_NOSIGNAL)
+        ssize_t n = send(fd_, outbox_.data() + sent, outbox_.size() - sent, MSG_NOSIGNAL);
+#else
+        ssize_t n = send(fd_, outbox_.data() + sent, outbox_.size() - sent, 0);
+#endif
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    outbox_.clear();
+    return true;
+}
+
+bool LinkSession::receive(bool wait) {
+    if (wait) {
+        pollfd request = {fd_, POLLIN, 0};
+        int ready = poll(&request, 1, config_.timeoutMs);
+        if (ready < 0 && errno == EINTR) {
+            return true;
+        }
+        if (ready <= 0) {
+            return false;
+        }
+    }
+    uint8_t buffer[kMessageSize * 64];
+    for (;;) {
+        ssize_t got = recv(fd_, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        if (got == 0) {
+            // The peer closed its end
+            return false;
+        }
+        size_t used = 0;
+        while (used < static_cast<size_t>(got)) {
+            size_t take = std::min(kMessageSize - inbox_.size(), static_cast<size_t>(got) - used);
+            inbox_.insert(inbox_.end(), buffer + used, buffer + used + take);
+            used += take;
+            if (inbox_.size() == kMessageSize) {
+                if (!handleMessage(inbox_.data())) {
+                    return false;
+                }
+                inbox_.clear();
+            }
+        }
+    }
+}
+
+bool LinkSession::handshake() {
+    uint8_t hello[kMessageSize] = {kHelloMessage};
+    int64_t payload = helloPayload(config_);
+    std::memcpy(hello + 8, &payload, sizeof(payload));
+    outbox_.insert(outbox_.end(), hello, hello + kMessageSize);
+    if (!flush()) {
+        return false;
+    }
+    while (!agreed_) {
+        if (!receive(true)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LinkSession::attach(int fd, GameBoy& gb, const LinkSessionConfig& config) {
+    close();
+    if (fd < 0) {
+        return false;
+    }
+    if (config.slicesPerFrame < 1 || GameBoy::kCyclesPerFrame % config.slicesPerFrame != 0 ||
+        GameBoy::kCyclesPerFrame / config.slicesPerFrame > Serial::kTransferCycles || config.maxAheadFrames < 1 ||
+        config.timeoutMs < 0) {
+        ::close(fd);
+        return false;
+    }
+    gb_ = &gb;
+    fd_ = fd;
+    config_ = config;
+    sliceCycles_ = GameBoy::kCyclesPerFrame / config.slicesPerFrame;
+    agreed_ = false;
+    next_ = 0;
+    remoteKnown_ = -1;
+    rollbackTo_ = -1;
+    stats_ = LinkSessionStats();
+    // History deep enough for a chain of corrections between the two ends;
+    // remote records may run a further window ahead of the local ones
+    const size_t slices = static_cast<size_t>(config.slicesPerFrame);
+    const size_t historyFrames = static_cast<size_t>(config.maxAheadFrames) * 4 + 2;
+    frames_.assign(historyFrames, Frame());
+    for (Frame& frame : frames_) {
+        frame.state.assign(gb.stateSize(), 0);
+    }
+    boundaries_.assign(historyFrames * slices, Boundary());
+    remote_.assign((historyFrames + static_cast<size_t>(config.maxAheadFrames) + 1) * slices, Remote());
+    outbox_.clear();
+    outbox_.reserve(kMessageSize * slices * 4);
+    inbox_.clear();
+    inbox_.reserve(kMessageSize);
+    gb.serial().setLinked(true);
+    if (!handshake()) {
+        return fail();
+    }
+    return true;
+}
+
+bool LinkSession::listen(const std::string& path, GameBoy& gb, const LinkSessionConfig& config) {
+    close();
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        return false;
+    }
+    ::unlink(path.c_str());
+    int fd = -1;
+    if (bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 && ::listen(server, 1) == 0) {
+        pollfd request = {server, POLLIN, 0};
+        if (poll(&request, 1, config.timeoutMs) > 0) {
+            fd = accept(server, nullptr, nullptr);
+        }
+    }
+    ::close(server);
+    ::unlink(path.c_str());
+    return attach(fd, gb, config);
+}
+
+bool LinkSession::connect(const std::string& path, GameBoy& gb, const LinkSessionConfig& config) {
+    close();
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    // The listening end may not have created the socket yet
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(config.timeoutMs);
+    for (;;) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            return false;
+        }
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+            return attach(fd, gb, config);
+        }
+        ::close(fd);
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+void LinkSession::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    if (gb_ != nullptr) {
+        gb_->serial().setLinked(false);
+        gb_ = nullptr;
+    }
+}
+
+#else // !GBLATOR_HAVE_UNIX_SOCKETS
+
+bool LinkSession::flush() {
+    return false;
+}
+
+bool LinkSession::receive(bool) {
+    return false;
+}
+
+bool LinkSession::handshake() {
+    return false;
+}
+
+bool LinkSession::attach(int, GameBoy&, const LinkSessionConfig&) {
+    return false;
+}
+
+bool LinkSession::listen(const std::string&, GameBoy&, const LinkSessionConfig&) {
+    return false;
+}
+
+bool LinkSession::connect(const std::string&, GameBoy&, const LinkSessionConfig&) {
+    return false;
+}
+
+void LinkSession::close() {
+    gb_ = nullptr;
+    fd_ = -1;
+}
+
+#endif
+
+} // namespace gblator
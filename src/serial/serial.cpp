@@ -0,0 +1,97 @@
+//
+// Implementation of the Serial class.
+//
+
+#include "serial/serial.h"
+#include "mmu/memory.h"
+#include "core/state.h"
+#include <climits>
+
+namespace gblator {
+
+Serial::Serial(Memory& memory)
+    : memory_(memory), remaining_(0), done_(false), linked_(false), transfers_(0) {
+}
+
+void Serial::reset() {
+    remaining_ = 0;
+    done_ = false;
+    memory_.writeByte(0xFF01, 0x00);
+    memory_.writeByte(0xFF02, 0x00);
+}
+
+void Serial::step(int cycles) {
+    uint8_t sc = memory_.serialControl();
+    if ((sc & 0x80) == 0) {
+        // No transfer requested, or the program cancelled it
+        remaining_ = 0;
+        done_ = false;
+        return;
+    }
+    if ((sc & 0x01) == 0) {
+        // External clock: the bits arrive from the other console
+        return;
+    }
+    if (!done_) {
+        if (remaining_ == 0) {
+            // SC was written by the instruction these cycles belong to
+            remaining_ = kTransferCycles;
+        }
+        remaining_ -= cycles;
+        if (remaining_ > 0) {
+            return;
+        }
+        remaining_ = 0;
+        done_ = true;
+    }
+    if (!linked_) {
+        // Nothing is plugged in: the input line stays high
+        completeTransfer(0xFF);
+    }
+}
+
+int Serial::cyclesUntilNextEvent() const {
+    return remaining_ > 0 ? remaining_ : INT_MAX;
+}
+
+void Serial::setLinked(bool linked) {
+    linked_ = linked;
+}
+
+bool Serial::transferDone() const {
+    return done_;
+}
+
+bool Serial::waitingForClock() const {
+    return (memory_.serialControl() & 0x81) == 0x80;
+}
+
+uint8_t Serial::data() const {
+    return memory_.readByte(0xFF01);
+}
+
+void Serial::completeTransfer(uint8_t received) {
+    remaining_ = 0;
+    done_ = false;
+    ++transfers_;
+    memory_.writeByte(0xFF01, received);
+    memory_.writeByte(0xFF02, static_cast<uint8_t>(memory_.readByte(0xFF02) & 0x7F));
+    // Request serial interrupt (IF bit 3)
+    memory_.writeByte(0xFF0F, static_cast<uint8_t>(memory_.readByte(0xFF0F) | 0x08));
+}
+
+uint64_t Serial::transfers() const {
+    return transfers_;
+}
+
+void Serial::saveState(StateWriter& writer) const {
+    writer.value(remaining_);
+    writer.value(done_);
+}
+
+void Serial::loadState(StateReader& reader) {
+    reader.value(remaining_);
+    reader.value(done_);
+}
+
+} // namespace gblator
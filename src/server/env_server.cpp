@@ -0,0 +1,298 @@
+//
+// Implementation of the shared-memory environment server.
+//
+
+#include "server/env_server.h"
+
+#if defined(__linux__)
+#include <chrono>
+#include <climits>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace gblator {
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && std::atomic<uint32_t>::is_always_lock_free,
+              "futex words must be plain lock-free 32-bit integers");
+
+#if defined(__linux__)
+
+namespace {
+
+constexpr uint64_t kAlignment = 64;
+
+uint64_t alignUp(uint64_t value) {
+    return (value + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+// The segment is shared between processes, so the non-private futex
+// operations are required. A null timeout waits indefinitely.
+void futexWait(std::atomic<uint32_t>& word, uint32_t expected, const timespec* timeout) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+}
+
+void futexWake(std::atomic<uint32_t>& word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// Wait until word differs from old. Polls first, since the other side
+// usually answers within microseconds, then sleeps on the futex. With a
+// non-negative timeoutMs gives up after that long and returns old.
+uint32_t waitForChange(std::atomic<uint32_t>& word, uint32_t old, int spinIterations, int timeoutMs = -1) {
+    for (int i = 0; i < spinIterations; ++i) {
+        uint32_t value = word.load(std::memory_order_acquire);
+        if (value != old) {
+            return value;
+        }
+    }
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (;;) {
+        uint32_t value = word.load(std::memory_order_acquire);
+        if (value != old) {
+            return value;
+        }
+        if (timeoutMs < 0) {
+            futexWait(word, old, nullptr);
+            continue;
+        }
+        // FUTEX_WAIT takes a relative timeout; recompute it after every wakeup
+        auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - Clock::now()).count();
+        if (remaining <= 0) {
+            return old;
+        }
+        timespec timeout;
+        timeout.tv_sec = static_cast<time_t>(remaining / 1000000000);
+        timeout.tv_nsec = static_cast<long>(remaining % 1000000000);
+        futexWait(word, old, &timeout);
+    }
+}
+
+uint8_t* segmentAt(EnvShmHeader* header, uint64_t offset) {
+    return reinterpret_cast<uint8_t*>(header) + offset;
+}
+
+} // namespace
+
+EnvServer::EnvServer() : header_(nullptr), mappedSize_(0) {
+}
+
+EnvServer::~EnvServer() {
+    close();
+}
+
+bool EnvServer::open(const std::string& name, const uint8_t* rom, size_t romSize, const EnvConfig& config) {
+    close();
+    if (!env_.open(rom, romSize, config)) {
+        return false;
+    }
+
+    // Lay out the segment
+    size_t n = env_.size();
+    uint64_t frameBytes = static_cast<uint64_t>(env_.width()) * env_.height();
+    uint64_t actionsOffset = alignUp(sizeof(EnvShmHeader));
+    uint64_t rewardsOffset = alignUp(actionsOffset + n);
+    uint64_t donesOffset = alignUp(rewardsOffset + n * sizeof(float));
+    uint64_t observationsOffset = alignUp(donesOffset + n);
+    uint64_t totalSize = alignUp(observationsOffset + n * frameBytes);
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(totalSize)) != 0) {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* mapping = mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+    name_ = name;
+    mappedSize_ = totalSize;
+    header_ = new (mapping) EnvShmHeader();
+    header_->numEnvs = static_cast<uint32_t>(n);
+    header_->width = static_cast<uint32_t>(env_.width());
+    header_->height = static_cast<uint32_t>(env_.height());
+    header_->command = 0;
+    header_->request.store(0, std::memory_order_relaxed);
+    header_->response.store(0, std::memory_order_relaxed);
+    header_->actionsOffset = actionsOffset;
+    header_->rewardsOffset = rewardsOffset;
+    header_->donesOffset = donesOffset;
+    header_->observationsOffset = observationsOffset;
+    header_->totalSize = totalSize;
+    header_->version = kEnvShmVersion;
+    // Results are written by the environments straight into the segment
+    env_.setBuffers(segmentAt(header_, observationsOffset),
+                    reinterpret_cast<float*>(segmentAt(header_, rewardsOffset)),
+                    segmentAt(header_, donesOffset));
+    env_.reset();
+    // Publishing the magic last tells clients the segment is ready
+    header_->magic.store(kEnvShmMagic, std::memory_order_release);
+    return true;
+}
+
+void EnvServer::close() {
+    if (header_ != nullptr) {
+        env_.setBuffers(nullptr, nullptr, nullptr);
+        munmap(header_, mappedSize_);
+        shm_unlink(name_.c_str());
+        header_ = nullptr;
+        mappedSize_ = 0;
+    }
+}
+
+void EnvServer::serve() {
+    if (header_ == nullptr) {
+        return;
+    }
+    uint32_t handled = header_->response.load(std::memory_order_acquire);
+    for (;;) {
+        uint32_t request = waitForChange(header_->request, handled, kEnvSpinIterations);
+        EnvCommand command = static_cast<EnvCommand>(header_->command);
+        if (command == EnvCommand::Step) {
+            env_.step(segmentAt(header_, header_->actionsOffset), env_.size());
+        } else if (command == EnvCommand::Reset) {
+            env_.reset();
+        }
+        handled = request;
+        header_->response.store(handled, std::memory_order_release);
+        futexWake(header_->response);
+        if (command == EnvCommand::Shutdown) {
+            return;
+        }
+    }
+}
+
+EnvClient::EnvClient() : header_(nullptr), mappedSize_(0), replyTimeoutMs_(kEnvReplyTimeoutMs) {
+}
+
+EnvClient::~EnvClient() {
+    disconnect();
+}
+
+bool EnvClient::connect(const std::string& name, int replyTimeoutMs) {
+    disconnect();
+    replyTimeoutMs_ = replyTimeoutMs;
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    // Map the header first to learn the full size
+    void* mapping = mmap(nullptr, sizeof(EnvShmHeader), PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    const EnvShmHeader* probe = static_cast<const EnvShmHeader*>(mapping);
+    // Pairs with the server's release store, so the fields below are complete
+    bool valid = probe->magic.load(std::memory_order_acquire) == kEnvShmMagic &&
+                 probe->version == kEnvShmVersion;
+    size_t totalSize = static_cast<size_t>(probe->totalSize);
+    munmap(mapping, sizeof(EnvShmHeader));
+    if (!valid) {
+        ::close(fd);
+        return false;
+    }
+    mapping = mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    header_ = static_cast<EnvShmHeader*>(mapping);
+    mappedSize_ = totalSize;
+    return true;
+}
+
+void EnvClient::disconnect() {
+    if (header_ != nullptr) {
+        munmap(header_, mappedSize_);
+        header_ = nullptr;
+        mappedSize_ = 0;
+    }
+}
+
+size_t EnvClient::numEnvs() const {
+    return header_ != nullptr ? header_->numEnvs : 0;
+}
+
+uint8_t* EnvClient::actions() {
+    return segmentAt(header_, header_->actionsOffset);
+}
+
+const float* EnvClient::rewards() const {
+    return reinterpret_cast<const float*>(segmentAt(header_, header_->rewardsOffset));
+}
+
+const uint8_t* EnvClient::dones() const {
+    return segmentAt(header_, header_->donesOffset);
+}
+
+const uint8_t* EnvClient::observations() const {
+    return segmentAt(header_, header_->observationsOffset);
+}
+
+bool EnvClient::request(EnvCommand command) {
+    header_->command = static_cast<uint32_t>(command);
+    uint32_t sequence = header_->request.load(std::memory_order_relaxed) + 1;
+    header_->request.store(sequence, std::memory_order_release);
+    futexWake(header_->request);
+    // The server only ever stores the sequence it handled, so one change
+    // is the answer
+    uint32_t response = header_->response.load(std::memory_order_acquire);
+    if (response != sequence) {
+        response = waitForChange(header_->response, response, kEnvSpinIterations, replyTimeoutMs_);
+    }
+    return response == sequence;
+}
+
+bool EnvClient::step() {
+    return request(EnvCommand::Step);
+}
+
+bool EnvClient::reset() {
+    return request(EnvCommand::Reset);
+}
+
+bool EnvClient::shutdown() {
+    return request(EnvCommand::Shutdown);
+}
+
+#else // !__linux__
+
+// Shared-memory futex signalling is Linux-specific; other platforms get
+// stubs that refuse to open or connect.
+
+EnvServer::EnvServer() : header_(nullptr), mappedSize_(0) {}
+EnvServer::~EnvServer() {}
+bool EnvServer::open(const std::string&, const uint8_t*, size_t, const EnvConfig&) { return false; }
+void EnvServer::serve() {}
+void EnvServer::close() {}
+
+EnvClient::EnvClient() : header_(nullptr), mappedSize_(0), replyTimeoutMs_(kEnvReplyTimeoutMs) {}
+EnvClient::~EnvClient() {}
+bool EnvClient::connect(const std::string&, int) { return false; }
+void EnvClient::disconnect() {}
+size_t EnvClient::numEnvs() const { return 0; }
+uint8_t* EnvClient::actions() { return nullptr; }
+const float* EnvClient::rewards() const { return nullptr; }
+const uint8_t* EnvClient::dones() const { return nullptr; }
+const uint8_t* EnvClient::observations() const { return nullptr; }
+bool EnvClient::request(EnvCommand) { return false; }
+bool EnvClient::step() { return false; }
+bool EnvClient::reset() { return false; }
+bool EnvClient::shutdown() { return false; }
+
+#endif
+
+} // namespace gblator
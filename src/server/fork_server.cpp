@@ -0,0 +1,194 @@
+//
+// Implementation of the fork server.
+//
+
+#include "server/fork_server.h"
+#include "core/core.h"
+#include "joypad/joypad.h"
+#include "ppu/ppu.h"
+#include "utils/hash.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <istream>
+#include <iterator>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+#define GBLATOR_HAVE_FORK 1
+#endif
+
+namespace gblator {
+
+ForkServer::ForkServer() {
+}
+
+ForkServer::~ForkServer() {
+}
+
+#if defined(GBLATOR_HAVE_FORK)
+
+namespace {
+
+// Write all bytes to fd, retrying on partial writes and signals
+bool writeAll(int fd, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Body of a job child: replay the input file and stream one hash per
+// completed frame into resultFd. Never returns.
+[[noreturn]] void runChild(GameBoy& gb, const std::string& inputPath, int resultFd, int timeoutSeconds) {
+    if (timeoutSeconds > 0) {
+        // The default SIGALRM action terminates the child
+        signal(SIGALRM, SIG_DFL);
+        alarm(static_cast<unsigned>(timeoutSeconds));
+    }
+    std::ifstream file(inputPath, std::ios::binary);
+    if (!file.is_open()) {
+        _exit(2);
+    }
+    std::vector<uint8_t> inputs((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    const size_t frameBytes = PPU::kScreenWidth * PPU::kScreenHeight;
+    for (uint8_t buttons : inputs) {
+        gb.joypad().setButtons(buttons);
+        gb.runFrame();
+        uint64_t hash = hashBytes(gb.ppu().frameBuffer(), frameBytes);
+        if (!writeAll(resultFd, &hash, sizeof(hash))) {
+            _exit(3);
+        }
+    }
+    // Skip atexit handlers and stdio flushing inherited from the parent
+    _exit(0);
+}
+
+} // namespace
+
+bool ForkServer::open(const uint8_t* rom, size_t romSize, const ForkServerConfig& config) {
+    config_ = config;
+    gb_.reset(new GameBoy());
+    if (!gb_->loadROM(rom, romSize)) {
+        gb_.reset();
+        return false;
+    }
+    for (int i = 0; i < config_.warmupFrames; ++i) {
+        gb_->runFrame();
+    }
+    return true;
+}
+
+void ForkServer::serve(std::istream& in, std::ostream& out) {
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        runJob(line, out);
+    }
+}
+
+void ForkServer::runJob(const std::string& inputPath, std::ostream& out) {
+    if (!gb_) {
+        out << "error no ROM loaded" << std::endl;
+        return;
+    }
+    int fds[2];
+    if (pipe(fds) != 0) {
+        out << "error pipe failed" << std::endl;
+        return;
+    }
+    // Anything buffered now would otherwise be written by both processes
+    out.flush();
+    std::fflush(nullptr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        ::close(fds[0]);
+        ::close(fds[1]);
+        out << "error fork failed" << std::endl;
+        return;
+    }
+    if (pid == 0) {
+        ::close(fds[0]);
+        runChild(*gb_, inputPath, fds[1], config_.timeoutSeconds);
+    }
+
+    // Collect hashes until the child exits and closes its end
+    ::close(fds[1]);
+    std::vector<uint64_t> hashes;
+    uint8_t buffer[sizeof(uint64_t) * 64];
+    size_t pending = 0;
+    for (;;) {
+        ssize_t got = read(fds[0], buffer + pending, sizeof(buffer) - pending);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            break;
+        }
+        pending += static_cast<size_t>(got);
+        size_t whole = pending / sizeof(uint64_t);
+        for (size_t i = 0; i < whole; ++i) {
+            uint64_t hash;
+            std::memcpy(&hash, buffer + i * sizeof(uint64_t), sizeof(hash));
+            hashes.push_back(hash);
+        }
+        // Keep a trailing partial hash for the next read
+        size_t used = whole * sizeof(uint64_t);
+        std::memmove(buffer, buffer + used, pending - used);
+        pending -= used;
+    }
+    ::close(fds[0]);
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    if (WIFSIGNALED(status)) {
+        out << "signal " << WTERMSIG(status);
+    } else {
+        out << "exit " << WEXITSTATUS(status);
+    }
+    out << ' ' << hashes.size();
+    std::ios::fmtflags flags = out.flags();
+    char fill = out.fill();
+    for (uint64_t hash : hashes) {
+        out << ' ' << std::hex << std::setw(16) << std::setfill('0') << hash;
+    }
+    out.flags(flags);
+    out.fill(fill);
+    out << std::endl;
+}
+
+#else // !GBLATOR_HAVE_FORK
+
+bool ForkServer::open(const uint8_t*, size_t, const ForkServerConfig&) {
+    return false;
+}
+
+void ForkServer::serve(std::istream&, std::ostream& out) {
+    out << "error fork is not supported on this platform" << std::endl;
+}
+
+void ForkServer::runJob(const std::string&, std::ostream&) {
+}
+
+#endif
+
+} // namespace gblator
@@ -0,0 +1,64 @@
+//
+// Implementation of the thread placement helpers.
+//
+
+#include "utils/affinity.h"
+#include <algorithm>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace gblator {
+
+namespace {
+
+#if defined(__linux__)
+bool pinHandle(pthread_t handle, unsigned cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(handle, sizeof(set), &set) == 0;
+}
+#endif
+
+} // namespace
+
+unsigned cpuCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+bool pinThread(std::thread& thread, unsigned cpu) {
+#if defined(__linux__)
+    return pinHandle(thread.native_handle(), cpu);
+#else
+    (void)thread;
+    (void)cpu;
+    return false;
+#endif
+}
+
+bool pinCurrentThread(unsigned cpu) {
+#if defined(__linux__)
+    return pinHandle(pthread_self(), cpu);
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+int currentNumaNode() {
+#if defined(__linux__) && defined(SYS_getcpu)
+    unsigned cpu = 0;
+    unsigned node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+        return static_cast<int>(node);
+    }
+#endif
+    return -1;
+}
+
+} // namespace gblator
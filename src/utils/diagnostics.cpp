@@ -0,0 +1,216 @@
+//
+// Implementation of the DiagnosticChannel and DiagnosticLogger classes.
+//
+
+#include "utils/diagnostics.h"
+#include <algorithm>
+#include <ostream>
+
+namespace gblator {
+
+namespace {
+
+uint32_t packKey(DiagnosticKind kind, uint8_t opcode, uint16_t pc) {
+    return (static_cast<uint32_t>(kind) << 24) | (static_cast<uint32_t>(opcode) << 16) | pc;
+}
+
+size_t slotFor(uint32_t key) {
+    // Fibonacci hashing spreads neighbouring PCs over the table
+    return static_cast<size_t>((key * 2654435769u) >> 24) % DiagnosticChannel::kTableSize;
+}
+
+const char* kindName(DiagnosticKind kind) {
+    switch (kind) {
+    case DiagnosticKind::UnimplementedOpcode:
+        return "Unimplemented opcode";
+    }
+    return "Diagnostic";
+}
+
+void writeHex(std::ostream& out, unsigned value, int digits) {
+    static const char kDigits[] = "0123456789ABCDEF";
+    out << "0x";
+    for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4) {
+        out << kDigits[(value >> shift) & 0xF];
+    }
+}
+
+} // namespace
+
+DiagnosticChannel::DiagnosticChannel()
+    : ring_(), head_(0), tail_(0), dropped_(0), overflow_(0), logger_(nullptr) {}
+
+DiagnosticChannel::~DiagnosticChannel() {
+    if (DiagnosticLogger* logger = logger_.load()) {
+        logger->detach(*this);
+    }
+}
+
+void DiagnosticChannel::report(DiagnosticKind kind, uint8_t opcode, uint16_t pc) {
+    uint32_t key = packKey(kind, opcode, pc);
+    size_t slot = slotFor(key);
+    for (size_t probe = 0; probe < kTableSize; ++probe) {
+        Entry& entry = table_[(slot + probe) % kTableSize];
+        uint32_t current = entry.key.load(std::memory_order_relaxed);
+        if (current == key) {
+            // Repeat: counted only
+            entry.count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (current != 0) {
+            continue;
+        }
+        // First occurrence: claim the slot and queue it for the logger
+        entry.count.store(1, std::memory_order_relaxed);
+        entry.key.store(key, std::memory_order_release);
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == kRingSize) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        ring_[head % kRingSize] = Diagnostic{kind, opcode, pc};
+        head_.store(head + 1, std::memory_order_release);
+        return;
+    }
+    overflow_.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t DiagnosticChannel::drain(Diagnostic* out, size_t capacity) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    uint32_t head = head_.load(std::memory_order_acquire);
+    size_t count = std::min(static_cast<size_t>(head - tail), capacity);
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = ring_[(tail + i) % kRingSize];
+    }
+    tail_.store(tail + static_cast<uint32_t>(count), std::memory_order_release);
+    return count;
+}
+
+uint64_t DiagnosticChannel::count(DiagnosticKind kind, uint8_t opcode, uint16_t pc) const {
+    uint32_t key = packKey(kind, opcode, pc);
+    size_t slot = slotFor(key);
+    for (size_t probe = 0; probe < kTableSize; ++probe) {
+        const Entry& entry = table_[(slot + probe) % kTableSize];
+        uint32_t current = entry.key.load(std::memory_order_acquire);
+        if (current == key) {
+            return entry.count.load(std::memory_order_relaxed);
+        }
+        if (current == 0) {
+            break;
+        }
+    }
+    return 0;
+}
+
+size_t DiagnosticChannel::distinct() const {
+    size_t total = 0;
+    for (const Entry& entry : table_) {
+        if (entry.key.load(std::memory_order_relaxed) != 0) {
+            ++total;
+        }
+    }
+    return total;
+}
+
+uint64_t DiagnosticChannel::dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+}
+
+uint64_t DiagnosticChannel::overflow() const {
+    return overflow_.load(std::memory_order_relaxed);
+}
+
+DiagnosticLogger::DiagnosticLogger(std::ostream& out, std::chrono::milliseconds interval)
+    : out_(out), interval_(interval), stopping_(false) {
+    thread_ = std::thread(&DiagnosticLogger::run, this);
+}
+
+DiagnosticLogger::~DiagnosticLogger() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Source& source : sources_) {
+        drainLocked(source);
+        summariseLocked(source);
+        source.channel->logger_.store(nullptr);
+    }
+    sources_.clear();
+    out_.flush();
+}
+
+void DiagnosticLogger::attach(DiagnosticChannel& channel, const std::string& label) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    channel.logger_.store(this);
+    sources_.push_back(Source{&channel, label});
+}
+
+void DiagnosticLogger::detach(DiagnosticChannel& channel) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = sources_.begin(); it != sources_.end(); ++it) {
+        if (it->channel == &channel) {
+            drainLocked(*it);
+            summariseLocked(*it);
+            channel.logger_.store(nullptr);
+            sources_.erase(it);
+            out_.flush();
+            return;
+        }
+    }
+}
+
+void DiagnosticLogger::flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Source& source : sources_) {
+        drainLocked(source);
+    }
+    out_.flush();
+}
+
+void DiagnosticLogger::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        wake_.wait_for(lock, interval_);
+        for (const Source& source : sources_) {
+            drainLocked(source);
+        }
+        out_.flush();
+    }
+}
+
+void DiagnosticLogger::drainLocked(const Source& source) {
+    Diagnostic batch[DiagnosticChannel::kRingSize];
+    size_t count = source.channel->drain(batch, DiagnosticChannel::kRingSize);
+    for (size_t i = 0; i < count; ++i) {
+        out_ << "[" << source.label << "] " << kindName(batch[i].kind) << " ";
+        writeHex(out_, batch[i].opcode, 2);
+        out_ << " at ";
+        writeHex(out_, batch[i].pc, 4);
+        out_ << "\n";
+    }
+}
+
+void DiagnosticLogger::summariseLocked(const Source& source) {
+    const DiagnosticChannel& channel = *source.channel;
+    for (const DiagnosticChannel::Entry& entry : channel.table_) {
+        uint32_t key = entry.key.load(std::memory_order_acquire);
+        uint64_t count = entry.count.load(std::memory_order_relaxed);
+        if (key == 0 || count < 2) {
+            continue;
+        }
+        out_ << "[" << source.label << "] " << kindName(static_cast<DiagnosticKind>(key >> 24)) << " ";
+        writeHex(out_, (key >> 16) & 0xFF, 2);
+        out_ << " at ";
+        writeHex(out_, key & 0xFFFF, 4);
+        out_ << " repeated " << count << " times\n";
+    }
+    if (channel.dropped() != 0 || channel.overflow() != 0) {
+        out_ << "[" << source.label << "] " << channel.dropped() << " diagnostics dropped, "
+             << channel.overflow() << " beyond the dedup table\n";
+    }
+}
+
+} // namespace gblator
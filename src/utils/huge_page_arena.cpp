@@ -0,0 +1,140 @@
+//
+// Implementation of the HugePageArena class.
+//
+
+#include "utils/huge_page_arena.h"
+#include <cstdint>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace gblator {
+
+namespace {
+
+size_t roundUp(size_t size, size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+#if defined(__linux__)
+// mbind() without a libnuma dependency; MPOL_BIND from <numaif.h>
+bool bindToNode(void* data, size_t size, int node) {
+#if defined(SYS_mbind)
+    constexpr int kMpolBind = 2;
+    constexpr int kMaxNodes = 1024;
+    unsigned long mask[kMaxNodes / (8 * sizeof(unsigned long))] = {};
+    if (node < 0 || node >= kMaxNodes) {
+        return false;
+    }
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+    return syscall(SYS_mbind, data, size, kMpolBind, mask, kMaxNodes + 1, 0) == 0;
+#else
+    (void)data;
+    (void)size;
+    (void)node;
+    return false;
+#endif
+}
+#endif
+
+} // namespace
+
+HugePageArena::HugePageArena()
+    : data_(nullptr), size_(0), mapping_(nullptr), mappedSize_(0), hugePages_(false), numaBound_(false) {
+}
+
+HugePageArena::~HugePageArena() {
+    unmap();
+}
+
+bool HugePageArena::map(size_t size, int node) {
+    unmap();
+    if (size == 0) {
+        return false;
+    }
+    size = roundUp(size, kHugePageSize);
+#if defined(__linux__)
+    // Explicit huge pages only exist if the administrator reserved them
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mapping != MAP_FAILED) {
+        mapping_ = mapping;
+        mappedSize_ = size;
+        data_ = mapping;
+        hugePages_ = true;
+    } else {
+        // Over-map by one huge page so the block can start on a 2 MiB
+        // boundary, which transparent huge pages require
+        size_t mappedSize = size + kHugePageSize;
+        mapping = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            return false;
+        }
+        mapping_ = mapping;
+        mappedSize_ = mappedSize;
+        uintptr_t start = roundUp(reinterpret_cast<uintptr_t>(mapping), kHugePageSize);
+        data_ = reinterpret_cast<void*>(start);
+#if defined(MADV_HUGEPAGE)
+        hugePages_ = madvise(data_, size, MADV_HUGEPAGE) == 0;
+#endif
+    }
+    size_ = size;
+    if (node >= 0) {
+        numaBound_ = bindToNode(data_, size_, node);
+    }
+    return true;
+#else
+    (void)node;
+    data_ = ::operator new(size, std::align_val_t(kHugePageSize), std::nothrow);
+    if (data_ == nullptr) {
+        return false;
+    }
+    size_ = size;
+    return true;
+#endif
+}
+
+void HugePageArena::unmap() {
+    if (data_ == nullptr) {
+        return;
+    }
+#if defined(__linux__)
+    munmap(mapping_, mappedSize_);
+#else
+    ::operator delete(data_, std::align_val_t(kHugePageSize), std::nothrow);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    mapping_ = nullptr;
+    mappedSize_ = 0;
+    hugePages_ = false;
+    numaBound_ = false;
+}
+
+void* HugePageArena::data() const {
+    return data_;
+}
+
+size_t HugePageArena::size() const {
+    return size_;
+}
+
+bool HugePageArena::hugePages() const {
+    return hugePages_;
+}
+
+bool HugePageArena::numaBound() const {
+    return numaBound_;
+}
+
+bool HugePageArena::contains(const void* pointer) const {
+    const uint8_t* p = static_cast<const uint8_t*>(pointer);
+    const uint8_t* start = static_cast<const uint8_t*>(data_);
+    return data_ != nullptr && p >= start && p < start + size_;
+}
+
+} // namespace gblator
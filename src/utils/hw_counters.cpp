@@ -0,0 +1,141 @@
+//
+// Implementation of the HardwareCounters class.
+//
+
+#include "utils/hw_counters.h"
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace gblator {
+
+namespace {
+
+constexpr size_t kEventCount = static_cast<size_t>(HwEvent::Count);
+
+#if defined(__linux__)
+struct EventConfig {
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr uint64_t cacheReadMiss(uint64_t cache) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+// Indexed by HwEvent
+const EventConfig kEvents[kEventCount] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_L1D)},
+    {PERF_TYPE_HW_CACHE, cacheReadMiss(PERF_COUNT_HW_CACHE_LL)},
+};
+
+int openEvent(const EventConfig& event) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // More events than hardware counters are time-multiplexed; the
+    // enabled and running times allow scaling the counts back up
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+#endif
+
+} // namespace
+
+HardwareCounters::HardwareCounters() : start_() {
+    for (int& fd : fds_) {
+        fd = -1;
+    }
+}
+
+HardwareCounters::~HardwareCounters() {
+    close();
+}
+
+bool HardwareCounters::open() {
+    close();
+#if defined(__linux__)
+    for (size_t i = 0; i < kEventCount; ++i) {
+        fds_[i] = openEvent(kEvents[i]);
+    }
+#endif
+    return isOpen();
+}
+
+void HardwareCounters::close() {
+    for (int& fd : fds_) {
+#if defined(__linux__)
+        if (fd >= 0) {
+            ::close(fd);
+        }
+#endif
+        fd = -1;
+    }
+}
+
+bool HardwareCounters::isOpen() const {
+    for (int fd : fds_) {
+        if (fd >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HardwareCounters::available(HwEvent event) const {
+    return fds_[static_cast<size_t>(event)] >= 0;
+}
+
+uint64_t HardwareCounters::read(size_t index) const {
+#if defined(__linux__)
+    uint64_t data[3]; // value, time enabled, time running
+    if (fds_[index] < 0 || ::read(fds_[index], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) {
+        return 0;
+    }
+    if (data[2] != 0 && data[2] < data[1]) {
+        return static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+    }
+    return data[0];
+#else
+    (void)index;
+    return 0;
+#endif
+}
+
+void HardwareCounters::begin() {
+    for (size_t i = 0; i < kEventCount; ++i) {
+        start_[i] = read(i);
+    }
+}
+
+void HardwareCounters::end(uint64_t emulatedInstructions) {
+    for (size_t i = 0; i < kEventCount; ++i) {
+        uint64_t now = read(i);
+        // Scaling can make a multiplexed count step backwards slightly
+        last_.values[i] = now > start_[i] ? now - start_[i] : 0;
+        total_.values[i] += last_.values[i];
+    }
+    last_.emulatedInstructions = emulatedInstructions;
+    total_.emulatedInstructions += emulatedInstructions;
+}
+
+const HwSample& HardwareCounters::last() const {
+    return last_;
+}
+
+const HwSample& HardwareCounters::total() const {
+    return total_;
+}
+
+} // namespace gblator
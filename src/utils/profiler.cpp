@@ -0,0 +1,105 @@
+//
+// Implementation of the instrumentation zone buffers and trace export.
+//
+
+#include "utils/profiler.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace gblator {
+
+namespace {
+
+struct ProfileEvent {
+    const char* name;
+    uint64_t beginNs;
+    uint64_t endNs;
+};
+
+// Written only by its owning thread; count is published with release
+// ordering so an exporter sees complete events
+struct ProfileRing {
+    std::atomic<uint64_t> count{0};
+    uint32_t threadId = 0;
+    ProfileEvent events[kProfileRingCapacity];
+};
+
+struct ProfileRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ProfileRing>> rings;
+};
+
+// Never destroyed, so threads recording during static destruction are safe
+ProfileRegistry& registry() {
+    static ProfileRegistry* instance = new ProfileRegistry();
+    return *instance;
+}
+
+ProfileRing& threadRing() {
+    thread_local ProfileRing* ring = nullptr;
+    if (ring == nullptr) {
+        ProfileRegistry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.rings.emplace_back(new ProfileRing());
+        ring = reg.rings.back().get();
+        ring->threadId = static_cast<uint32_t>(reg.rings.size());
+    }
+    return *ring;
+}
+
+// Chrome traces use microseconds; keep nanosecond precision as decimals
+void writeMicroseconds(std::ostream& out, uint64_t ns) {
+    uint64_t fraction = ns % 1000;
+    out << ns / 1000 << '.' << static_cast<char>('0' + fraction / 100)
+        << static_cast<char>('0' + fraction / 10 % 10) << static_cast<char>('0' + fraction % 10);
+}
+
+} // namespace
+
+uint64_t profileNow() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void profileRecord(const char* name, uint64_t beginNs, uint64_t endNs) {
+    ProfileRing& ring = threadRing();
+    uint64_t index = ring.count.load(std::memory_order_relaxed);
+    ring.events[index % kProfileRingCapacity] = ProfileEvent{name, beginNs, endNs};
+    ring.count.store(index + 1, std::memory_order_release);
+}
+
+void writeChromeTrace(std::ostream& out) {
+    ProfileRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& ring : reg.rings) {
+        uint64_t count = ring->count.load(std::memory_order_acquire);
+        uint64_t start = count > kProfileRingCapacity ? count - kProfileRingCapacity : 0;
+        for (uint64_t i = start; i < count; ++i) {
+            const ProfileEvent& event = ring->events[i % kProfileRingCapacity];
+            out << (first ? "" : ",") << "\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                << ring->threadId << ",\"ts\":";
+            writeMicroseconds(out, event.beginNs);
+            out << ",\"dur\":";
+            writeMicroseconds(out, event.endNs - event.beginNs);
+            out << '}';
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+}
+
+void clearProfile() {
+    ProfileRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const auto& ring : reg.rings) {
+        ring->count.store(0, std::memory_order_relaxed);
+    }
+}
+
+} // namespace gblator
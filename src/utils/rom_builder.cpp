@@ -0,0 +1,209 @@
+//
+// Implementation of the RomBuilder class and the synthetic ROMs.
+//
+
+#include "utils/rom_builder.h"
+#include <algorithm>
+#include <cstring>
+
+namespace gblator {
+
+namespace {
+
+// Logo checked by the boot ROM before it starts a cartridge
+const uint8_t kNintendoLogo[48] = {
+    0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83, 0x00, 0x0C, 0x00, 0x0D,
+    0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E, 0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99,
+    0xBB, 0xBB, 0x67, 0x63, 0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E,
+};
+
+constexpr uint16_t kProgramStart = 0x0150;
+
+// Emit "LDH A,(80); INC A; LDH (80),A; RETI" to count frames in HRAM
+void emitFrameCounter(RomBuilder& rom) {
+    rom.emit({0xF0, 0x80, 0x3C, 0xE0, 0x80, 0xD9});
+}
+
+// Emit "LD A,1; LDH (FF),A; EI" followed by a HALT loop
+void emitHaltLoop(RomBuilder& rom) {
+    rom.emit({0x3E, 0x01, 0xE0, 0xFF, 0xFB});
+    uint16_t loop = rom.here();
+    rom.emit({0x76});
+    rom.jr(0x18, loop);
+}
+
+} // namespace
+
+RomBuilder::RomBuilder(uint8_t cartType, uint8_t romSizeCode, uint8_t ramSizeCode)
+    : image_((size_t(2) << std::min<uint8_t>(romSizeCode, 8)) * 0x4000, 0x00), position_(0) {
+    image_[0x0147] = cartType;
+    image_[0x0148] = romSizeCode;
+    image_[0x0149] = ramSizeCode;
+    image_[0x014A] = 0x01; // Non-Japanese
+    // Entry point: NOP; JP 0150
+    org(0x0100).emit({0x00, 0xC3, kProgramStart & 0xFF, kProgramStart >> 8});
+    std::memcpy(&image_[0x0104], kNintendoLogo, sizeof(kNintendoLogo));
+    title("GBLATOR");
+    org(kProgramStart);
+}
+
+RomBuilder& RomBuilder::org(size_t offset) {
+    position_ = offset;
+    return *this;
+}
+
+RomBuilder& RomBuilder::emit(std::initializer_list<uint8_t> bytes) {
+    for (uint8_t byte : bytes) {
+        image_.at(position_++) = byte;
+    }
+    return *this;
+}
+
+RomBuilder& RomBuilder::jr(uint8_t opcode, uint16_t target) {
+    // The offset is relative to the address after the two-byte instruction
+    int offset = static_cast<int>(target) - (static_cast<int>(here()) + 2);
+    return emit({opcode, static_cast<uint8_t>(static_cast<int8_t>(offset))});
+}
+
+uint16_t RomBuilder::here() const {
+    if (position_ < 0x4000) {
+        return static_cast<uint16_t>(position_);
+    }
+    return static_cast<uint16_t>(0x4000 + position_ % 0x4000);
+}
+
+RomBuilder& RomBuilder::title(const char* text) {
+    std::fill(image_.begin() + 0x0134, image_.begin() + 0x0144, 0x00);
+    for (size_t i = 0; i < 16 && text[i] != '\0'; ++i) {
+        image_[0x0134 + i] = static_cast<uint8_t>(text[i]);
+    }
+    return *this;
+}
+
+std::vector<uint8_t> RomBuilder::build() const {
+    std::vector<uint8_t> rom = image_;
+    uint8_t headerChecksum = 0;
+    for (size_t i = 0x0134; i <= 0x014C; ++i) {
+        headerChecksum = static_cast<uint8_t>(headerChecksum - rom[i] - 1);
+    }
+    rom[0x014D] = headerChecksum;
+    uint16_t globalChecksum = 0;
+    for (size_t i = 0; i < rom.size(); ++i) {
+        if (i != 0x014E && i != 0x014F) {
+            globalChecksum = static_cast<uint16_t>(globalChecksum + rom[i]);
+        }
+    }
+    rom[0x014E] = static_cast<uint8_t>(globalChecksum >> 8);
+    rom[0x014F] = static_cast<uint8_t>(globalChecksum & 0xFF);
+    return rom;
+}
+
+const char* syntheticWorkloadName(SyntheticWorkload workload) {
+    switch (workload) {
+    case SyntheticWorkload::AluLoop:
+        return "alu_loop";
+    case SyntheticWorkload::MemoryTraffic:
+        return "memory_traffic";
+    case SyntheticWorkload::BankSwitchStorm:
+        return "bank_switch_storm";
+    case SyntheticWorkload::VramUpload:
+        return "vram_upload";
+    case SyntheticWorkload::HaltFrames:
+        return "halt_frames";
+    case SyntheticWorkload::CbBitOps:
+        return "cb_bit_ops";
+    default:
+        return "unknown";
+    }
+}
+
+std::vector<uint8_t> makeSyntheticROM(SyntheticWorkload workload) {
+    switch (workload) {
+    case SyntheticWorkload::AluLoop: {
+        RomBuilder rom;
+        rom.title("ALU LOOP");
+        rom.emit({0x06, 0x00}); // LD B,0
+        uint16_t loop = rom.here();
+        rom.emit({0x80, 0x04, 0xA8, 0x0C, 0x91}); // ADD A,B; INC B; XOR B; INC C; SUB C
+        rom.jr(0x18, loop);
+        return rom.build();
+    }
+    case SyntheticWorkload::MemoryTraffic: {
+        RomBuilder rom;
+        rom.title("MEMORY TRAFFIC");
+        rom.emit({0x21, 0x00, 0xC0}); // LD HL,C000
+        uint16_t loop = rom.here();
+        rom.emit({0x2A, 0x3C, 0x77});  // LD A,(HL+); INC A; LD (HL),A
+        rom.emit({0x7C, 0xFE, 0xD0});  // LD A,H; CP D0
+        rom.jr(0x20, loop);
+        rom.emit({0x26, 0xC0});        // LD H,C0
+        rom.jr(0x18, loop);
+        return rom.build();
+    }
+    case SyntheticWorkload::BankSwitchStorm: {
+        // MBC1 with 8 ROM banks and 32 KiB of RAM; each bank starts with its number
+        RomBuilder rom(0x03, 0x02, 0x03);
+        rom.title("BANK STORM");
+        for (uint8_t bank = 1; bank < 8; ++bank) {
+            rom.org(bank * size_t(0x4000)).emit({bank});
+        }
+        rom.org(kProgramStart);
+        rom.emit({0x1E, 0x01});             // LD E,1
+        uint16_t loop = rom.here();
+        rom.emit({0x7B, 0xEA, 0x00, 0x20}); // LD A,E; LD (2000),A
+        rom.emit({0xFA, 0x00, 0x40});       // LD A,(4000)
+        rom.emit({0x1C, 0x7B, 0xE6, 0x07}); // INC E; LD A,E; AND 7
+        rom.jr(0x20, loop);
+        rom.emit({0x1E, 0x01});             // LD E,1
+        rom.jr(0x18, loop);
+        return rom.build();
+    }
+    case SyntheticWorkload::VramUpload: {
+        RomBuilder rom;
+        rom.title("VRAM UPLOAD");
+        // Six tiles of source data at 1000
+        rom.org(0x1000);
+        for (int i = 0; i < 96; ++i) {
+            rom.emit({static_cast<uint8_t>(i * 29 + 7)});
+        }
+        // VBlank handler: copy the tiles to 8000, then count the frame
+        rom.org(0x0040).emit({0xC3, 0x00, 0x02}); // JP 0200
+        rom.org(0x0200);
+        rom.emit({0x11, 0x00, 0x10});       // LD DE,1000
+        rom.emit({0x21, 0x00, 0x80});       // LD HL,8000
+        rom.emit({0x06, 0x60});             // LD B,96
+        uint16_t copy = rom.here();
+        rom.emit({0x1A, 0x22, 0x13, 0x05}); // LD A,(DE); LD (HL+),A; INC DE; DEC B
+        rom.jr(0x20, copy);
+        emitFrameCounter(rom);
+        rom.org(kProgramStart);
+        emitHaltLoop(rom);
+        return rom.build();
+    }
+    case SyntheticWorkload::HaltFrames: {
+        RomBuilder rom;
+        rom.title("HALT FRAMES");
+        rom.org(0x0040);
+        emitFrameCounter(rom);
+        rom.org(kProgramStart);
+        emitHaltLoop(rom);
+        return rom.build();
+    }
+    case SyntheticWorkload::CbBitOps: {
+        RomBuilder rom;
+        rom.title("CB BIT OPS");
+        rom.emit({0x21, 0x00, 0xC0, 0x3E, 0x5A}); // LD HL,C000; LD A,5A
+        uint16_t loop = rom.here();
+        rom.emit({0xCB, 0x37, 0xCB, 0x47});       // SWAP A; BIT 0,A
+        rom.emit({0xCB, 0xF8, 0xCB, 0x81});       // SET 7,B; RES 0,C
+        rom.emit({0xCB, 0x11, 0xCB, 0x38});       // RL C; SRL B
+        rom.emit({0xCB, 0x06, 0xCB, 0x2A});       // RLC (HL); SRA D
+        rom.jr(0x18, loop);
+        return rom.build();
+    }
+    default:
+        return std::vector<uint8_t>();
+    }
+}
+
+} // namespace gblator
@@ -0,0 +1,93 @@
+//
+// Implementation of the sample statistics.
+//
+
+#include "utils/sample_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace gblator {
+
+namespace {
+
+double median(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    return nearestRankPercentile(samples, 0.5);
+}
+
+} // namespace
+
+double nearestRankPercentile(const std::vector<double>& sorted, double fraction) {
+    size_t rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+double slowerPValue(const std::vector<double>& baseline, const std::vector<double>& current) {
+    if (baseline.empty() || current.empty()) {
+        return 1.0;
+    }
+    const double n1 = static_cast<double>(current.size());
+    const double n2 = static_cast<double>(baseline.size());
+    double u = 0;
+    for (double c : current) {
+        for (double b : baseline) {
+            u += c > b ? 1.0 : (c == b ? 0.5 : 0.0);
+        }
+    }
+    // Tie correction from the pooled samples
+    std::vector<double> pooled(baseline);
+    pooled.insert(pooled.end(), current.begin(), current.end());
+    std::sort(pooled.begin(), pooled.end());
+    double ties = 0;
+    for (size_t i = 0; i < pooled.size();) {
+        size_t j = i;
+        while (j < pooled.size() && pooled[j] == pooled[i]) {
+            ++j;
+        }
+        double t = static_cast<double>(j - i);
+        ties += t * t * t - t;
+        i = j;
+    }
+    const double n = n1 + n2;
+    double variance = n1 * n2 / 12.0 * ((n + 1) - ties / (n * (n - 1)));
+    if (variance <= 0) {
+        return 1.0;
+    }
+    double z = (u - n1 * n2 / 2.0 - 0.5) / std::sqrt(variance);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+SampleComparison compareSamples(const std::vector<double>& baseline, const std::vector<double>& current,
+                                double thresholdPercent, double alpha) {
+    SampleComparison result;
+    result.baselineMedian = median(baseline);
+    result.currentMedian = median(current);
+    result.changePercent = (result.currentMedian / result.baselineMedian - 1.0) * 100.0;
+    double pSlower = slowerPValue(baseline, current);
+    double pFaster = slowerPValue(current, baseline);
+    result.pValue = std::min(pSlower, pFaster);
+    if (result.changePercent > thresholdPercent && pSlower < alpha) {
+        result.verdict = SampleVerdict::Regression;
+    } else if (result.changePercent < -thresholdPercent && pFaster < alpha) {
+        result.verdict = SampleVerdict::Improved;
+    } else if (std::fabs(result.changePercent) > thresholdPercent) {
+        result.verdict = SampleVerdict::Noise;
+    }
+    return result;
+}
+
+const char* sampleVerdictName(SampleVerdict verdict) {
+    switch (verdict) {
+    case SampleVerdict::Regression:
+        return "REGRESSION";
+    case SampleVerdict::Improved:
+        return "improved";
+    case SampleVerdict::Noise:
+        return "noise";
+    default:
+        return "unchanged";
+    }
+}
+
+} // namespace gblator
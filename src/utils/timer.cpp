@@ -4,6 +4,10 @@
 
 #include "utils/timer.h"
 #include "mmu/memory.h"
+#include "core/guest_trace.h"
+#include "core/state.h"
+#include <algorithm>
+#include <climits>
 
 namespace gblator {
 
@@ -35,6 +39,36 @@ int Timer::timerPeriod() const {
     }
 }
 
+void Timer::saveState(StateWriter& writer) const {
+    writer.value(divCounter_);
+    writer.value(timaCounter_);
+}
+
+void Timer::loadState(StateReader& reader) {
+    reader.value(divCounter_);
+    reader.value(timaCounter_);
+}
+
+int Timer::cyclesUntilOverflow() const {
+    int period = timerPeriod();
+    if (period == 0) {
+        return INT_MAX;
+    }
+    // TIMA overflows on the increment after it reaches 0xFF
+    int increments = 0x100 - memory_.readByte(0xFF05);
+    return increments * period - timaCounter_;
+}
+
+int Timer::cyclesUntilNextIncrement() const {
+    int cycles = 256 - divCounter_;
+    int period = timerPeriod();
+    if (period > 0) {
+        cycles = std::min(cycles, period - timaCounter_);
+    }
+    // A shorter period selected mid-count is caught up by the next step
+    return std::max(cycles, 1);
+}
+
 void Timer::step(int cycles) {
     // Update divider; increments at 16384 Hz => 256 cycles per increment【487600738692240†L125-L171】
     divCounter_ += cycles;
@@ -55,6 +89,9 @@ void Timer::step(int cycles) {
                 // Overflow: reload from TMA and request timer interrupt
                 uint8_t tma = memory_.readByte(0xFF06);
                 memory_.writeByte(0xFF05, tma);
+                if (GuestTrace* trace = memory_.trace()) {
+                    trace->record(GuestEvent::TimerOverflow, tma);
+                }
                 // Request timer interrupt (IF bit 2)
                 uint8_t iflags = memory_.readByte(0xFF0F);
                 iflags |= 0x04;
@@ -0,0 +1,83 @@
+//
+// Implementation of the WorkerPool class.
+//
+
+#include "utils/worker_pool.h"
+
+namespace gblator {
+
+WorkerPool::WorkerPool(int threads)
+    : generation_(0), stopping_(false), active_(0), task_(nullptr), context_(nullptr), count_(0), next_(0) {
+    for (int i = 1; i < threads; ++i) {
+        workers_.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    start_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+int WorkerPool::size() const {
+    return static_cast<int>(workers_.size()) + 1;
+}
+
+void WorkerPool::run(size_t count, Task task, void* context) {
+    if (workers_.empty() || count <= 1) {
+        // Nothing to share; run inline
+        for (size_t i = 0; i < count; ++i) {
+            task(context, i);
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = task;
+        context_ = context;
+        count_ = count;
+        next_.store(0, std::memory_order_relaxed);
+        active_ = workers_.size();
+        ++generation_;
+    }
+    start_.notify_all();
+    drain();
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return active_ == 0; });
+}
+
+void WorkerPool::drain() {
+    for (;;) {
+        size_t index = next_.fetch_add(1, std::memory_order_relaxed);
+        if (index >= count_) {
+            return;
+        }
+        task_(context_, index);
+    }
+}
+
+void WorkerPool::workerLoop() {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_.wait(lock, [&]() { return stopping_ || generation_ != seen; });
+            if (stopping_) {
+                return;
+            }
+            seen = generation_;
+        }
+        drain();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
+
+} // namespace gblator
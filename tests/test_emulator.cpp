@@ -12,15 +12,52 @@
 #include <fstream>
 #include <vector>
 #include <cstdint>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 // Define private as public to access internal state of CPU for testing
 #define private public
+#include "capi/gblator_c.h"
 #include "cpu/cpu.h"
 #include "mmu/memory.h"
 #include "utils/timer.h"
 #include "ppu/ppu.h"
 #include "joypad/joypad.h"
 #include "apu/apu.h"
+#include "core/core.h"
+#include "core/determinism_audit.h"
+#include "core/engine_select.h"
+#include "core/guest_trace.h"
+#include "core/input_latency.h"
+#include "core/instance_pool.h"
+#include "core/state_diff.h"
+#include "env/vector_env.h"
+#include "explore/explorer.h"
+#include "server/env_server.h"
+#include "server/fork_server.h"
+#include "sched/cycle_scheduler.h"
+#include "sched/edf_scheduler.h"
+#include "serial/link_cable.h"
+#include "serial/link_session.h"
+#include "utils/rom_builder.h"
+#include "utils/sample_stats.h"
+#include "utils/diagnostics.h"
+#include "utils/profiler.h"
 #undef private
 
 using namespace gblator;
@@ -54,6 +91,175 @@ static void writeROM(const std::string& path, const std::vector<uint8_t>& rom) {
     out.close();
 }
 
+// Allocation audit: every global operator new and, with glibc, every C
+// allocation function in the process (library code included) bumps this
+// counter, so a test can assert that a code path performs no heap
+// allocations. Sanitizers bring their own allocator, so there only
+// operator new is counted.
+static std::atomic<size_t> allocationCount(0);
+
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || __has_feature(memory_sanitizer)
+#define GBLATOR_SANITIZED_ALLOCATOR 1
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define GBLATOR_SANITIZED_ALLOCATOR 1
+#endif
+
+#if defined(__GLIBC__) && !defined(GBLATOR_SANITIZED_ALLOCATOR)
+#define GBLATOR_AUDIT_MALLOC 1
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* p, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+}
+#endif
+
+static void* countedMalloc(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+#if defined(GBLATOR_AUDIT_MALLOC)
+    return __libc_malloc(size);
+#else
+    return std::malloc(size);
+#endif
+}
+
+static void* countedAlignedAlloc(std::size_t alignment, std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+#if defined(GBLATOR_AUDIT_MALLOC)
+    return __libc_memalign(alignment, size);
+#else
+    // aligned_alloc() wants a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+#if defined(GBLATOR_AUDIT_MALLOC)
+// Replacing the C allocation functions in the executable interposes them
+// for the whole process; memory still comes from glibc, so free() is kept
+extern "C" {
+
+void* malloc(std::size_t size) noexcept {
+    return countedMalloc(size);
+}
+
+void* calloc(std::size_t count, std::size_t size) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, std::size_t size) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(p, size);
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size) noexcept {
+    return countedAlignedAlloc(alignment, size);
+}
+
+int posix_memalign(void** out, std::size_t alignment, std::size_t size) noexcept {
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void* p = countedAlignedAlloc(alignment, size);
+    if (p == nullptr) {
+        return ENOMEM;
+    }
+    *out = p;
+    return 0;
+}
+
+} // extern "C"
+#endif
+
+void* operator new(std::size_t size) {
+    if (void* p = countedMalloc(size != 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return countedMalloc(size != 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    if (void* p = countedAlignedAlloc(static_cast<std::size_t>(alignment), size != 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return countedAlignedAlloc(static_cast<std::size_t>(alignment), size != 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept {
+    return operator new(size, alignment, tag);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
 // Test loading immediate values into registers using LD r,d8 instructions
 static void test_ld_immediate() {
     std::cout << "Running test_ld_immediate..." << std::endl;
@@ -71,9 +277,7 @@ static void test_ld_immediate() {
         rom[0x0148] = 0x00; // 32 KiB (2 banks)
         rom[0x0149] = 0x00; // No RAM
     }
-    const std::string romPath = "test_ld_immediate.gb";
-    writeROM(romPath, rom);
-    bool ok = mem.loadROM(romPath);
+    bool ok = mem.loadROM(rom);
     ASSERT_EQ(ok, true, "loadROM() succeeds");
     CPU cpu(mem);
     cpu.reset();
@@ -104,9 +308,7 @@ static void test_add_instruction() {
         rom[0x0148] = 0x00;
         rom[0x0149] = 0x00;
     }
-    const std::string romPath = "test_add.gb";
-    writeROM(romPath, rom);
-    mem.loadROM(romPath);
+    mem.loadROM(rom, RomOwnership::Borrow);
     CPU cpu(mem);
     cpu.reset();
     cpu.step(); // LD B
@@ -115,6 +317,43 @@ static void test_add_instruction() {
     ASSERT_EQ(cpu.a_, 0x08, "ADD A,B adds B to A (3+5=8)");
 }
 
+// Test CB-prefixed instructions on registers and on (HL), with their cycles
+static void test_cb_instructions() {
+    std::cout << "Running test_cb_instructions..." << std::endl;
+    Memory mem;
+    RomBuilder builder;
+    builder.emit({0xCB, 0x37});  // SWAP A
+    builder.emit({0xCB, 0x7F});  // BIT 7,A
+    builder.emit({0xCB, 0x10});  // RL B
+    builder.emit({0xCB, 0xC6});  // SET 0,(HL)
+    builder.emit({0xCB, 0x4E});  // BIT 1,(HL)
+    builder.emit({0xCB, 0x3F});  // SRL A
+    std::vector<uint8_t> rom = builder.build();
+    mem.loadROM(rom.data(), rom.size());
+    CPU cpu(mem);
+    cpu.reset();
+    cpu.pc_ = 0x150;
+    cpu.a_ = 0x1E;
+    cpu.b_ = 0x80;
+    cpu.setHL(0xC000);
+    mem.writeByte(0xC000, 0x02);
+    ASSERT_EQ(cpu.step(), 2, "SWAP A takes two cycles");
+    ASSERT_EQ(cpu.a_, 0xE1, "SWAP A exchanges the nibbles");
+    cpu.step();
+    ASSERT_EQ(cpu.getFlag(CPU::Z_FLAG), false, "BIT 7,A clears Z when the bit is set");
+    ASSERT_EQ(cpu.getFlag(CPU::H_FLAG), true, "BIT sets H");
+    cpu.step();
+    ASSERT_EQ(cpu.b_, 0x00, "RL B shifts out bit 7");
+    ASSERT_EQ(cpu.getFlag(CPU::C_FLAG) && cpu.getFlag(CPU::Z_FLAG), true, "RL B sets carry and zero");
+    ASSERT_EQ(cpu.step(), 4, "SET 0,(HL) takes four cycles");
+    ASSERT_EQ(mem.readByte(0xC000), 0x03, "SET 0,(HL) sets the bit in memory");
+    ASSERT_EQ(cpu.step(), 3, "BIT 1,(HL) takes three cycles");
+    ASSERT_EQ(cpu.getFlag(CPU::Z_FLAG), false, "BIT 1,(HL) sees the bit");
+    cpu.step();
+    ASSERT_EQ(cpu.a_, 0x70, "SRL A shifts right");
+    ASSERT_EQ(cpu.getFlag(CPU::C_FLAG), true, "SRL A moves bit 0 into carry");
+}
+
 // Test the timer: DIV increments and TIMA overflow triggers interrupt
 static void test_timer() {
     std::cout << "Running test_timer..." << std::endl;
@@ -180,9 +419,7 @@ static void test_memory_bank_switch() {
         rom[0x0148] = 0x01; // 64 KiB (4 banks)
         rom[0x0149] = 0x00; // No RAM
     }
-    const std::string romPath = "test_mbc1.gb";
-    writeROM(romPath, rom);
-    bool ok = mem.loadROM(romPath);
+    bool ok = mem.loadROM(rom);
     ASSERT_EQ(ok, true, "loadROM() succeeds for MBC1");
     // Default ROM bank for 4000-7FFF should be bank 1 (value 0x11)
     uint8_t val = mem.readByte(0x4000);
@@ -197,6 +434,54 @@ static void test_memory_bank_switch() {
     ASSERT_EQ(val, 0x13, "After bank switch to 3, reading 0x4000 yields bank3 value (0x13)");
 }
 
+// Test loading ROM images from borrowed buffers and file descriptors
+static void test_rom_loading() {
+    std::cout << "Running test_rom_loading..." << std::endl;
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    Memory copied;
+    Memory borrowed;
+    ASSERT_EQ(copied.loadROM(rom), true, "loadROM(span) copies the image");
+    ASSERT_EQ(borrowed.loadROM(rom, RomOwnership::Borrow), true, "loadROM(span) borrows the image");
+    ASSERT_EQ(borrowed.romData_.empty(), true, "A borrowed image is not copied");
+    rom[0x0200] = 0x5A;
+    ASSERT_EQ(borrowed.readByte(0x0200), 0x5A, "A borrowed image is read in place");
+    ASSERT_EQ(copied.readByte(0x0200), 0x00, "A copied image is independent of the buffer");
+    ASSERT_EQ(copied.loadROM(std::span<const uint8_t>()), false, "An empty image is rejected");
+    ASSERT_EQ(copied.readByte(0x0150), 0x3E, "A rejected load keeps the previous image");
+#if defined(__linux__)
+    // Through a pipe, as a batch runner would hand it to a child
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0, "pipe() succeeds");
+    std::thread writer([&]() {
+        size_t done = 0;
+        while (done < rom.size()) {
+            ssize_t n = write(fds[1], rom.data() + done, rom.size() - done);
+            if (n <= 0) {
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+        close(fds[1]);
+    });
+    GameBoy gb;
+    bool ok = gb.loadROMFromFd(fds[0]);
+    writer.join();
+    close(fds[0]);
+    ASSERT_EQ(ok, true, "GameBoy::loadROMFromFd() reads a pipe to the end");
+    ASSERT_EQ(gb.memory().readByte(0x0200), 0x5A, "The image read from the pipe is complete");
+    // From an open regular file, whose offset is left alone
+    FILE* file = std::tmpfile();
+    std::fwrite(rom.data(), 1, rom.size(), file);
+    std::fflush(file);
+    Memory fromFile;
+    ASSERT_EQ(fromFile.loadROMFromFd(fileno(file)), true, "loadROMFromFd() reads a regular file");
+    ASSERT_EQ(fromFile.romSize_, rom.size(), "The whole file is read");
+    ASSERT_EQ(std::ftell(file) == static_cast<long>(rom.size()), true, "The file offset is not moved");
+    std::fclose(file);
+    ASSERT_EQ(fromFile.loadROMFromFd(-1), false, "An invalid descriptor is rejected");
+#endif
+}
+
 // Test joypad input handling and register behaviour
 static void test_joypad() {
     std::cout << "Running test_joypad..." << std::endl;
@@ -222,13 +507,1110 @@ static void test_joypad() {
     ASSERT_EQ(joyp, static_cast<uint8_t>(0xDB), "Pressing Up yields JOYP=0xDB when directions selected");
 }
 
+// Program that sends `value` over the serial port with the given SC
+// start value, waits for the transfer and stores the byte received in FF80
+static std::vector<uint8_t> makeSerialROM(uint8_t value, uint8_t control) {
+    RomBuilder builder;
+    builder.emit({0x3E, value});         // LD A,value
+    builder.emit({0xE0, 0x01});          // LDH (SB),A
+    builder.emit({0x3E, control});       // LD A,control
+    builder.emit({0xE0, 0x02});          // LDH (SC),A
+    uint16_t wait = builder.here();
+    builder.emit({0xF0, 0x02});          // LDH A,(SC)
+    builder.emit({0xCB, 0x7F});          // BIT 7,A
+    builder.jr(0x20, wait);              // JR NZ,wait
+    builder.emit({0xF0, 0x01});          // LDH A,(SB)
+    builder.emit({0xE0, 0x80});          // LDH (0x80),A
+    builder.jr(0x18, builder.here());    // JR to itself
+    return builder.build();
+}
+
+// Test serial transfers alone and between two consoles on a link cable
+static void test_serial_link() {
+    std::cout << "Running test_serial_link..." << std::endl;
+    // Without a cable the internal clock transfer receives 0xFF
+    std::vector<uint8_t> masterRom = makeSerialROM(0x42, 0x81);
+    GameBoy alone;
+    alone.loadROM(masterRom);
+    alone.runFrame();
+    ASSERT_EQ(alone.memory().readByte(0xFF80), 0xFF, "An unconnected transfer receives 0xFF");
+    ASSERT_EQ(alone.memory().readByte(0xFF0F) & 0x08, 0x08, "Transfer completion requests the serial interrupt");
+    ASSERT_EQ(alone.serial().transfers(), 1u, "One transfer completes");
+    // With the cable, the bytes cross over
+    std::vector<uint8_t> slaveRom = makeSerialROM(0x99, 0x80);
+    GameBoy master;
+    GameBoy slave;
+    master.loadROM(masterRom);
+    slave.loadROM(slaveRom);
+    {
+        LinkCable cable(master, slave);
+        cable.runFrame();
+        cable.runFrame();
+        ASSERT_EQ(cable.exchanges(), 1u, "One byte is exchanged");
+        ASSERT_EQ(cable.slices() < 40, true, "Consoles run in slices, not in lockstep");
+        ASSERT_EQ(master.frameCycle() < Serial::kTransferCycles, true, "Frames end together");
+    }
+    ASSERT_EQ(master.memory().readByte(0xFF80), 0x99, "The master receives the slave's byte");
+    ASSERT_EQ(slave.memory().readByte(0xFF80), 0x42, "The slave receives the master's byte");
+    ASSERT_EQ(master.counters().frames, 2u, "The cable completes the master's frames");
+    ASSERT_EQ(slave.counters().frames, 2u, "The cable completes the slave's frames");
+    // A halted console waiting for the serial interrupt is skipped ahead to it
+    RomBuilder builder;
+    builder.org(0x58).emit({0x3C, 0xD9});             // Serial handler: INC A; RETI
+    builder.org(0x150);
+    builder.emit({0x3E, 0x08, 0xE0, 0xFF});           // IE = serial
+    builder.emit({0x3E, 0x81, 0xE0, 0x02});           // Start an internal clock transfer
+    builder.emit({0xAF, 0xFB, 0x76});                 // XOR A; EI; HALT
+    builder.emit({0xE0, 0x80});                       // LDH (0x80),A
+    builder.jr(0x18, builder.here());
+    std::vector<uint8_t> haltRom = builder.build();
+    GameBoy halted;
+    halted.loadROM(haltRom);
+    halted.runFrame();
+    ASSERT_EQ(halted.memory().readByte(0xFF80), 1, "The serial interrupt wakes the halted CPU");
+    ASSERT_EQ(halted.idleCycles() + 16 > static_cast<uint64_t>(Serial::kTransferCycles), true,
+              "The wait for the transfer is skipped");
+}
+
+// Test that a link session over a socket corrects a misprediction by rolling back
+static void test_link_session() {
+#if defined(__linux__)
+    std::cout << "Running test_link_session..." << std::endl;
+    std::vector<uint8_t> masterRom = makeSerialROM(0x42, 0x81);
+    std::vector<uint8_t> slaveRom = makeSerialROM(0x99, 0x80);
+    GameBoy master;
+    GameBoy slave;
+    master.loadROM(masterRom);
+    slave.loadROM(slaveRom);
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0, "socketpair() succeeds");
+    LinkSession masterLink;
+    LinkSession slaveLink;
+    // Both ends wait for the other's hello
+    bool slaveOk = false;
+    std::thread slaveThread([&]() { slaveOk = slaveLink.attach(fds[1], slave); });
+    bool masterOk = masterLink.attach(fds[0], master);
+    slaveThread.join();
+    ASSERT_EQ(masterOk && slaveOk, true, "Both ends agree on the configuration");
+    // Frames alternate on one thread, so the master always runs a frame
+    // without the slave's records for it and predicts them
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(masterLink.runFrame(), true, "Master frame runs");
+        ASSERT_EQ(slaveLink.runFrame(), true, "Slave frame runs");
+    }
+    ASSERT_EQ(master.memory().readByte(0xFF80), 0x99, "The master ends up with the slave's byte");
+    ASSERT_EQ(slave.memory().readByte(0xFF80), 0x42, "The slave receives the master's byte");
+    ASSERT_EQ(masterLink.stats().rollbacks, 1u, "The master rolls back once, for the mispredicted transfer");
+    ASSERT_EQ(masterLink.stats().predictedSlices, masterLink.stats().slices, "The master predicts every slice");
+    ASSERT_EQ(masterLink.stats().corrections > 0, true, "The master corrects the records that changed");
+    ASSERT_EQ(slaveLink.stats().rollbacks, 0u, "The corrections do not affect the slave's exchanges");
+    ASSERT_EQ(slaveLink.stats().stalls, 0u, "Neither end waits within the window");
+    slaveLink.close();
+    ASSERT_EQ(masterLink.runFrame(), false, "A closed peer ends the session");
+    ASSERT_EQ(masterLink.isOpen(), false, "The session is closed");
+    // Slices longer than a transfer would delay completions further
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0, "socketpair() succeeds");
+    LinkSessionConfig coarse;
+    coarse.slicesPerFrame = 12;
+    ASSERT_EQ(masterLink.attach(fds[0], master, coarse), false, "Slices over one transfer time are rejected");
+    close(fds[1]);
+#endif
+}
+
+// Test engine lookup, the batched engine's equivalence, trials from a snapshot and the per-ROM cache
+static void test_engine_select() {
+    std::cout << "Running test_engine_select..." << std::endl;
+    CpuEngine engine = CpuEngine::Count;
+    ASSERT_EQ(parseCpuEngine("interpreter", engine), true, "The interpreter is found by name");
+    ASSERT_EQ(engine == CpuEngine::Interpreter, true, "parseCpuEngine() returns the named engine");
+    ASSERT_EQ(parseCpuEngine("warp", engine), false, "Unknown engine names are rejected");
+    ASSERT_EQ(EngineSelector::availableEngines().front() == CpuEngine::Interpreter, true,
+              "The interpreter is always available and listed first");
+
+    // Every workload, and a transfer on the unlinked serial port, ends in
+    // the same state with either engine
+    std::vector<std::vector<uint8_t>> roms;
+    for (int i = 0; i < static_cast<int>(SyntheticWorkload::Count); ++i) {
+        roms.push_back(makeSyntheticROM(static_cast<SyntheticWorkload>(i)));
+    }
+    roms.push_back(makeSerialROM(0x42, 0x81));
+    bool same = true;
+    for (const std::vector<uint8_t>& image : roms) {
+        std::vector<uint8_t> states[2];
+        for (int e = 0; e < 2; ++e) {
+            GameBoy console;
+            console.loadROM(image, RomOwnership::Borrow);
+            console.setEngine(e == 0 ? CpuEngine::Interpreter : CpuEngine::Batched);
+            for (int i = 0; i < 20; ++i) {
+                console.runFrame();
+            }
+            states[e].resize(console.stateSize());
+            console.saveState(states[e].data(), states[e].size());
+        }
+        same = same && states[0] == states[1];
+    }
+    ASSERT_EQ(same, true, "The batched engine matches the interpreter");
+
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    GameBoy gb;
+    gb.loadROM(rom);
+    for (int i = 0; i < 3; ++i) {
+        gb.runFrame();
+    }
+    std::vector<uint8_t> snapshot(gb.stateSize());
+    gb.saveState(snapshot.data(), snapshot.size());
+    uint8_t vblanks = gb.memory().readByte(0xFF80);
+    EngineSelector selector(4);
+    EngineTrial first;
+    EngineTrial second;
+    ASSERT_EQ(selector.trial(rom, snapshot, CpuEngine::Interpreter, first), true, "A trial runs the engine");
+    selector.trial(rom, snapshot, CpuEngine::Batched, second);
+    ASSERT_EQ(first.stateHash == second.stateHash, true, "Trials from the same snapshot end in the same state");
+    ASSERT_EQ(first.bestFrameNs > 0, true, "A trial is timed");
+    ASSERT_EQ(gb.memory().readByte(0xFF80), vblanks, "Trials leave the console alone");
+
+    EngineChoice choice = selector.select(gb);
+    bool agreeing = choice.trials.size() == EngineSelector::availableEngines().size();
+    for (const EngineTrial& trial : choice.trials) {
+        agreeing = agreeing && trial.agrees;
+    }
+    ASSERT_EQ(agreeing, true, "Every available engine is tried and agrees");
+    ASSERT_EQ(gb.engine() == choice.engine, true, "The chosen engine is applied");
+    ASSERT_EQ(choice.cached, false, "The first selection for a ROM is not cached");
+    const std::string cachePath = (std::filesystem::temp_directory_path() / "gblator_test_engine_cache.txt").string();
+    ASSERT_EQ(selector.saveCache(cachePath), true, "The cache is written");
+    EngineSelector reloaded;
+    ASSERT_EQ(reloaded.loadCache(cachePath), true, "The cache is read back");
+    EngineChoice again = reloaded.select(gb);
+    ASSERT_EQ(again.cached, true, "A ROM in the cache skips the trial");
+    ASSERT_EQ(again.engine == choice.engine, true, "The cached engine is the one chosen");
+    ASSERT_EQ(again.romHash == choice.romHash, true, "The cache is keyed by the ROM hash");
+    std::remove(cachePath.c_str());
+    ASSERT_EQ(reloaded.loadCache(cachePath), true, "A missing cache file is not an error");
+}
+
+// Test that a halted CPU is woken by VBlank and the idle cycles are skipped
+static void test_halt_idle_skip() {
+    std::cout << "Running test_halt_idle_skip..." << std::endl;
+    std::vector<uint8_t> rom(0x8000, 0x00);
+    // VBlank handler: INC B; RETI
+    rom[0x40] = 0x04;
+    rom[0x41] = 0xD9;
+    size_t pc = 0x100;
+    rom[pc++] = 0x3E; rom[pc++] = 0x01; // LD A,0x01
+    rom[pc++] = 0xE0; rom[pc++] = 0xFF; // LDH (0xFF),A -> IE = VBlank
+    rom[pc++] = 0xFB;                  // EI
+    rom[pc++] = 0x76;                  // HALT
+    rom[pc++] = 0x18; rom[pc++] = 0xFD; // JR -3 (back to HALT)
+    GameBoy gb;
+    bool ok = gb.loadROM(rom, RomOwnership::Borrow);
+    ASSERT_EQ(ok, true, "GameBoy::loadROM() succeeds");
+    gb.runFrame();
+    gb.runFrame();
+    ASSERT_EQ(gb.cpu().b_, 2, "VBlank handler runs once per frame while halted");
+    ASSERT_EQ(gb.idleCycles() > static_cast<uint64_t>(GameBoy::kCyclesPerFrame), true,
+              "Halted cycles are skipped rather than stepped");
+    ASSERT_EQ(gb.cpu().halted(), true, "CPU returns to HALT after the handler");
+}
+
+// Records (cycle, elapsed) each time it wakes
+GBLATOR_TASKS_BEGIN
+static ComponentTask recordingTask(CycleScheduler& scheduler, int period, std::vector<std::pair<uint64_t, int>>& log) {
+    for (;;) {
+        int elapsed = co_await scheduler.sleep(period);
+        log.emplace_back(scheduler.now(), elapsed);
+    }
+}
+
+// Keeps a buffer larger than the arena alive across its sleeps
+static ComponentTask oversizedTask(CycleScheduler& scheduler) {
+    std::array<uint8_t, CycleScheduler::kArenaSize> buffer{};
+    for (;;) {
+        buffer[co_await scheduler.sleep(1) % buffer.size()]++;
+    }
+}
+GBLATOR_TASKS_END
+
+// Test timestamp-ordered resumption of coroutine tasks and the components they drive
+static void test_cycle_scheduler() {
+    std::cout << "Running test_cycle_scheduler..." << std::endl;
+    CycleScheduler scheduler;
+    std::vector<std::pair<uint64_t, int>> slow;
+    std::vector<std::pair<uint64_t, int>> fast;
+    ASSERT_EQ(scheduler.spawn(recordingTask(scheduler, 10, slow)), true, "A task is spawned");
+    ASSERT_EQ(scheduler.spawn(recordingTask(scheduler, 4, fast)), true, "A second task is spawned");
+    ASSERT_EQ(scheduler.arenaUsed() > 0 && scheduler.arenaUsed() <= CycleScheduler::kArenaSize, true,
+              "Frames come from the inline arena");
+    scheduler.advance(3);
+    ASSERT_EQ(fast.empty() && slow.empty(), true, "No task runs before it is due");
+    scheduler.advance(21);
+    ASSERT_EQ(fast.size(), 5u, "A task runs at every due cycle passed");
+    ASSERT_EQ(fast[2].first == 12 && fast[2].second == 4, true, "A task resumes at its own timestamp");
+    ASSERT_EQ(slow.size(), 2u, "Tasks are independent");
+    ASSERT_EQ(slow[1].first == 20 && slow[1].second == 10, true, "Elapsed cycles are those slept");
+    scheduler.invalidate();
+    ASSERT_EQ(slow.back().first == 21 && slow.back().second == 1, true, "invalidate() catches tasks up early");
+    scheduler.advance(23);
+    ASSERT_EQ(slow.back().first == 23 && slow.back().second == 2, true, "...and resumes them after the write");
+    size_t used = scheduler.arenaUsed();
+    scheduler.advance(1000);
+    ASSERT_EQ(scheduler.arenaUsed(), used, "Resuming never allocates");
+
+    // LY and the STAT mode match stepping the PPU after every instruction
+    std::vector<uint8_t> rom(0x8000, 0x00);
+    rom[0x100] = 0x18; rom[0x101] = 0xFE; // JR -2 (3 cycles)
+    GameBoy gb;
+    gb.loadROM(rom, RomOwnership::Borrow);
+    ASSERT_EQ(gb.scheduler_.count_, 3, "The PPU, timer and APU run as tasks");
+    bool live = true;
+    for (int i = 0; i < gb.scheduler_.count_; ++i) {
+        live = live && gb.scheduler_.slots_[i].handle && !gb.scheduler_.slots_[i].handle.done();
+    }
+    ASSERT_EQ(live, true, "Every component task is suspended in the scheduler");
+    CycleScheduler small;
+    ASSERT_EQ(small.spawn(oversizedTask(small)), false, "A frame larger than the arena is refused");
+    gb.run(1000);
+    int line = (3000 / 114) % 154;
+    int dot = (3000 % 114) * 4;
+    ASSERT_EQ(gb.memory().readByte(0xFF44), line, "LY is current between events");
+    ASSERT_EQ(gb.memory().readByte(0xFF41) & 0x03, dot < 80 ? 2 : dot < 252 ? 3 : 0, "STAT mode is current");
+    gb.memory().writeByte(0xFF07, 0x05); // TAC: enabled, 16 clocks per increment
+    gb.run(4);
+    ASSERT_EQ(gb.memory().readByte(0xFF05), 3, "A TAC write reschedules the timer");
+}
+
+// Test that a frame rendered from VRAM reaches the front buffer at VBlank
+static void test_ppu_framebuffer() {
+    std::cout << "Running test_ppu_framebuffer..." << std::endl;
+    Memory mem;
+    PPU ppu(mem);
+    ppu.reset();
+    // Tile 0 row 0: colour 1 in every pixel; map 9800 is all tile 0
+    mem.writeByte(0x8000, 0xFF);
+    mem.writeByte(0x8001, 0x00);
+    mem.writeByte(0xFF47, 0xE4); // BGP identity palette
+    mem.writeByte(0xFF40, 0x91); // LCD on, 8000 tile data, BG on
+    ppu.step(114 * 144);
+    const uint8_t* fb = ppu.frameBuffer();
+    ASSERT_EQ(ppu.frameCount(), 1u, "One frame completed at VBlank");
+    ASSERT_EQ(fb[0], 1, "Tile row 0 renders colour 1");
+    ASSERT_EQ(fb[PPU::kScreenWidth], 0, "Tile row 1 renders colour 0");
+    ASSERT_EQ(fb[8 * PPU::kScreenWidth + 9], 1, "Next tile row 0 renders colour 1");
+}
+
+// Test that loading a save state reproduces the same execution
+static void test_save_state_roundtrip() {
+    std::cout << "Running test_save_state_roundtrip..." << std::endl;
+    std::vector<uint8_t> rom(0x8000, 0x00);
+    size_t pc = 0x100;
+    rom[pc++] = 0x3C;                  // loop: INC A
+    rom[pc++] = 0xE0; rom[pc++] = 0x80; // LDH (0x80),A
+    rom[pc++] = 0x04;                  // INC B
+    rom[pc++] = 0x18; rom[pc++] = 0xFA; // JR loop
+    GameBoy gb;
+    bool ok = gb.loadROM(rom.data(), rom.size());
+    ASSERT_EQ(ok, true, "GameBoy::loadROM(buffer) succeeds");
+    gb.runFrame();
+    std::vector<uint8_t> state(gb.stateSize());
+    ok = gb.saveState(state.data(), state.size());
+    ASSERT_EQ(ok, true, "saveState() succeeds");
+    gb.runFrame();
+    uint8_t a = gb.cpu().a_;
+    uint16_t statePc = gb.cpu().pc_;
+    uint8_t hram = gb.memory().readByte(0xFF80);
+    ok = gb.loadState(state.data(), state.size());
+    ASSERT_EQ(ok, true, "loadState() succeeds");
+    gb.runFrame();
+    ASSERT_EQ(gb.cpu().a_, a, "A matches after replaying from state");
+    ASSERT_EQ(gb.cpu().pc_, statePc, "PC matches after replaying from state");
+    ASSERT_EQ(gb.memory().readByte(0xFF80), hram, "HRAM matches after replaying from state");
+    ok = gb.loadState(state.data(), state.size() - 1);
+    ASSERT_EQ(ok, false, "loadState() rejects a truncated state");
+    ok = gb.saveState(state.data(), state.size() - 1);
+    ASSERT_EQ(ok, false, "saveState() rejects a short buffer");
+
+    // A state for a cartridge with other RAM is rejected before anything is loaded
+    std::vector<StateSection> layout = gb.stateLayout();
+    size_t eramField = 0;
+    for (const StateSection& section : layout) {
+        if (std::string(section.name) == "Cartridge RAM size") {
+            eramField = section.offset;
+        }
+    }
+    ASSERT_EQ(eramField > 0, true, "The layout locates the cartridge RAM size");
+    state[eramField] ^= 0x01;
+    std::vector<uint8_t> current(gb.stateSize());
+    gb.saveState(current.data(), current.size());
+    ok = gb.loadState(state.data(), state.size());
+    ASSERT_EQ(ok, false, "loadState() rejects a cartridge RAM size mismatch");
+    std::vector<uint8_t> after(gb.stateSize());
+    gb.saveState(after.data(), after.size());
+    ASSERT_EQ(after == current, true, "A rejected state leaves the machine untouched");
+}
+
+// Test the state layout, the region-by-region diff and the determinism audit
+static void test_state_diff() {
+    std::cout << "Running test_state_diff..." << std::endl;
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    GameBoy gb;
+    gb.loadROM(rom, RomOwnership::Borrow);
+    gb.runFrame();
+    std::vector<StateSection> layout = gb.stateLayout();
+    bool contiguous = !layout.empty() && layout.front().offset == 0;
+    for (size_t i = 1; i < layout.size(); ++i) {
+        contiguous = contiguous && layout[i].offset == layout[i - 1].offset + layout[i - 1].size;
+    }
+    ASSERT_EQ(contiguous, true, "The layout sections are contiguous");
+    ASSERT_EQ(layout.back().offset + layout.back().size == gb.stateSize(), true, "The layout covers the state");
+
+    std::vector<uint8_t> before(gb.stateSize());
+    gb.saveState(before.data(), before.size());
+    gb.memory().writeByte(0xD010, 0x5A);
+    gb.memory().writeByte(0xD011, 0xA5);
+    gb.cpu().b_ ^= 0xFF;
+    std::vector<uint8_t> after(gb.stateSize());
+    gb.saveState(after.data(), after.size());
+    StateDiff diff = diffStates(layout, before, after);
+    ASSERT_EQ(diff.comparable, true, "States of one cartridge are comparable");
+    bool wram = false;
+    bool cpu = false;
+    for (const StateSectionDiff& changes : diff.sections) {
+        const StateSection& section = changes.section;
+        if (std::string(section.name) == "WRAM") {
+            wram = section.bank == 1 && changes.ranges.size() == 1 &&
+                   section.address + static_cast<int>(changes.ranges[0].offset) == 0xD010 &&
+                   changes.ranges[0].size == 2;
+        } else if (std::string(section.name) == "CPU") {
+            cpu = changes.bytes == 1;
+        }
+    }
+    ASSERT_EQ(wram, true, "A WRAM write is reported at its bank and address");
+    ASSERT_EQ(cpu, true, "A register change is reported in the CPU section");
+    std::ostringstream report;
+    writeStateDiff(diff, report);
+    ASSERT_EQ(report.str().find("WRAM bank 1: 2 bytes in 1 range\n  D010-D011") != std::string::npos, true,
+              "The report names the bank and address range");
+    ASSERT_EQ(diffStates(layout, before, before).bytes, 0u, "A state equals itself");
+
+    std::vector<uint8_t> x(40, 7);
+    for (size_t i : {size_t(15), size_t(16), size_t(17), size_t(39)}) {
+        std::vector<uint8_t> y = x;
+        y[i] = 8;
+        ASSERT_EQ(findDifference(x.data(), y.data(), 0, x.size()), i, "findDifference() finds each position");
+    }
+    ASSERT_EQ(findDifference(x.data(), x.data(), 0, x.size()), x.size(), "Equal buffers have no difference");
+
+    std::vector<uint8_t> inputs(10, 0);
+    AuditResult audit = auditDeterminism(rom, inputs);
+    ASSERT_EQ(audit.ok, true, "The audit runs");
+    ASSERT_EQ(audit.divergedFrame, -1, "Two replays of the same inputs agree");
+    ASSERT_EQ(audit.hashes.size(), 10u, "One state hash per frame");
+
+    AuditConfig config;
+    config.frames = 10;
+    config.beforeFrame = [](int run, GameBoy& console, int frame) {
+        if (run == 1 && frame == 3) {
+            console.memory().writeByte(0xC123, 0x42);
+        }
+    };
+    audit = auditDeterminism(rom, inputs, config);
+    ASSERT_EQ(audit.divergedFrame, 3, "The audit stops at the diverging frame");
+    bool found = false;
+    for (const StateSectionDiff& changes : audit.diff.sections) {
+        for (const StateDiffRange& range : changes.ranges) {
+            found = found || changes.section.address + static_cast<int>(range.offset) == 0xC123;
+        }
+    }
+    ASSERT_EQ(found, true, "The audit diff contains the diverging address");
+}
+
+// Test the C interface end to end through the gblator_c shared library
+static void test_c_api() {
+    std::cout << "Running test_c_api..." << std::endl;
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    ASSERT_EQ(gblator_api_version(), static_cast<uint32_t>(GBLATOR_C_API_VERSION), "The library reports the header's version");
+    gblator_instance* gb = gblator_create();
+    ASSERT_EQ(gb != nullptr, true, "gblator_create() returns an instance");
+    ASSERT_EQ(gblator_load_rom(gb, rom.data(), rom.size()), 1, "gblator_load_rom() succeeds");
+    gblator_step_frames(gb, 2);
+    size_t hramSize = 0;
+    uint8_t* hram = gblator_memory_region(gb, GBLATOR_REGION_HRAM, &hramSize);
+    ASSERT_EQ(hram != nullptr && hramSize > 0, true, "HRAM is exposed");
+    ASSERT_EQ(hram[0], 2, "gblator_step_frames() runs the frames");
+    ASSERT_EQ(gblator_framebuffer(gb) != nullptr, true, "The framebuffer is exposed");
+
+    std::vector<uint8_t> state(gblator_state_size(gb));
+    ASSERT_EQ(gblator_save_state(gb, state.data(), state.size()), 1, "gblator_save_state() succeeds");
+    ASSERT_EQ(gblator_save_state(gb, state.data(), state.size() - 1), 0, "A short state buffer is rejected");
+    gblator_step_frames(gb, 3);
+    ASSERT_EQ(hram[0], 5, "The counter advances");
+    ASSERT_EQ(gblator_load_state(gb, state.data(), state.size()), 1, "gblator_load_state() succeeds");
+    ASSERT_EQ(hram[0], 2, "Loading the state restores memory");
+    ASSERT_EQ(gblator_load_state(gb, state.data(), state.size() - 1), 0, "A truncated state is rejected");
+
+    gblator_counters counters;
+    gblator_get_counters(gb, &counters);
+    ASSERT_EQ(counters.frames >= 5, true, "Counters are copied out");
+    char text[8];
+    size_t length = gblator_counters_text(gb, GBLATOR_COUNTERS_JSON, text, sizeof(text));
+    ASSERT_EQ(length > sizeof(text) && std::strlen(text) == sizeof(text) - 1, true,
+              "Counter text is truncated and terminated");
+
+    // A borrowed image is shared, not copied
+    gblator_instance* borrowed = gblator_create();
+    ASSERT_EQ(gblator_load_rom_borrowed(borrowed, rom.data(), rom.size()), 1,
+              "gblator_load_rom_borrowed() succeeds");
+    ASSERT_EQ(gblator_load_rom_borrowed(borrowed, nullptr, rom.size()), 0, "A null image is rejected");
+    gblator_step_frames(borrowed, 2);
+    ASSERT_EQ(gblator_memory_region(borrowed, GBLATOR_REGION_HRAM, nullptr)[0], 2,
+              "A borrowed ROM runs");
+    gblator_destroy(borrowed);
+
+#if defined(__linux__)
+    // The image fits in the pipe buffer, so it can be written up front
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0, "A pipe is created");
+    bool written = write(fds[1], rom.data(), rom.size()) == static_cast<ssize_t>(rom.size());
+    close(fds[1]);
+    ASSERT_EQ(written, true, "The ROM is written to the pipe");
+    ASSERT_EQ(gblator_load_rom_fd(gb, fds[0]), 1, "gblator_load_rom_fd() succeeds");
+    close(fds[0]);
+    ASSERT_EQ(gblator_memory_region(gb, GBLATOR_REGION_HRAM, nullptr)[0], 0, "Loading a ROM resets");
+    gblator_step_frames(gb, 1);
+    ASSERT_EQ(gblator_memory_region(gb, GBLATOR_REGION_HRAM, nullptr)[0], 1, "A ROM read from a descriptor runs");
+#endif
+    ASSERT_EQ(gblator_load_rom_fd(gb, -1), 0, "A bad descriptor is rejected");
+    gblator_destroy(gb);
+    gblator_destroy(nullptr);
+}
+
+// Test batched stepping, observation layout and auto-reset in VectorEnv
+static void test_vector_env() {
+    std::cout << "Running test_vector_env..." << std::endl;
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    // Draw a visible pattern first: tile 0 row 0 uses colour 3
+    size_t pc = 0x100;
+    rom[pc++] = 0x3E; rom[pc++] = 0xFF;                   // LD A,0xFF
+    rom[pc++] = 0xEA; rom[pc++] = 0x00; rom[pc++] = 0x80; // LD (0x8000),A
+    rom[pc++] = 0xEA; rom[pc++] = 0x01; rom[pc++] = 0x80; // LD (0x8001),A
+    rom[pc++] = 0x3E; rom[pc++] = 0x01;                   // LD A,0x01
+    rom[pc++] = 0xE0; rom[pc++] = 0xFF;                   // LDH (0xFF),A -> IE = VBlank
+    rom[pc++] = 0xFB;                                     // EI
+    rom[pc++] = 0x76;                                     // HALT
+    rom[pc++] = 0x18; rom[pc++] = 0xFD;                   // JR -3 (back to HALT)
+    EnvConfig config;
+    config.numEnvs = 4;
+    config.numThreads = 2;
+    config.rewardAddress = 0xFF80;
+    config.maxEpisodeFrames = 2;
+    VectorEnv env;
+    bool ok = env.open(rom.data(), rom.size(), config);
+    ASSERT_EQ(ok, true, "VectorEnv::open() boots every environment");
+    ASSERT_EQ(env.size(), 4u, "VectorEnv holds the requested environments");
+    std::vector<uint8_t> actions(env.size(), 0);
+    ok = env.step(actions.data(), actions.size());
+    ASSERT_EQ(ok, true, "step() accepts one action per environment");
+    ASSERT_EQ(env.step(actions.data(), 3), false, "step() rejects a short action array");
+    size_t frameBytes = static_cast<size_t>(env.width()) * env.height();
+    ASSERT_EQ(env.observations()[3 * frameBytes], 3, "Last observation is rendered in place");
+    ASSERT_EQ(env.rewards()[0], 1.0f, "Reward is the change of the reward byte");
+    ASSERT_EQ(env.dones()[0], 0, "Episode continues before the frame limit");
+    env.step(actions.data(), actions.size());
+    ASSERT_EQ(env.dones()[2], 1, "Episode ends at the frame limit");
+    ASSERT_EQ(env.env(2).memory().readByte(0xFF80), 0, "Finished episode restarts from the start state");
+}
+
+// Test the shared-memory environment server against an in-process client
+static void test_env_server() {
+#if defined(__linux__)
+    std::cout << "Running test_env_server..." << std::endl;
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    EnvConfig config;
+    config.numEnvs = 3;
+    config.rewardAddress = 0xFF80;
+    config.maxEpisodeFrames = 3;
+    const std::string name = "/gblator_test_" + std::to_string(getpid());
+    EnvServer server;
+    bool ok = server.open(name, rom.data(), rom.size(), config);
+    ASSERT_EQ(ok, true, "EnvServer::open() creates the segment");
+    // Nobody serves the segment yet; the reset stays queued for the server
+    EnvClient unanswered;
+    ASSERT_EQ(unanswered.connect(name, 20), true, "A client can map an idle segment");
+    ASSERT_EQ(unanswered.reset(), false, "A request times out when the server does not answer");
+    unanswered.disconnect();
+    std::thread serverThread([&server]() { server.serve(); });
+    EnvClient client;
+    ok = client.connect(name);
+    ASSERT_EQ(ok, true, "EnvClient::connect() maps the segment");
+    ASSERT_EQ(client.numEnvs(), 3u, "Client sees every environment");
+    for (size_t i = 0; i < client.numEnvs(); ++i) {
+        client.actions()[i] = 0;
+    }
+    ASSERT_EQ(client.step(), true, "The server answers a step");
+    ASSERT_EQ(client.rewards()[1], 1.0f, "Reward is the per-step change of the reward byte");
+    ASSERT_EQ(client.dones()[1], 0, "Episode continues before the frame limit");
+    client.step();
+    client.step();
+    ASSERT_EQ(client.dones()[2], 1, "Episode ends at the frame limit");
+    client.shutdown();
+    serverThread.join();
+    client.disconnect();
+    server.close();
+#endif
+}
+
+// Test that forked jobs replay inputs from the warmed-up machine
+static void test_fork_server() {
+#if defined(__linux__)
+    std::cout << "Running test_fork_server..." << std::endl;
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    ForkServerConfig config;
+    config.warmupFrames = 5;
+    ForkServer server;
+    bool ok = server.open(rom.data(), rom.size(), config);
+    ASSERT_EQ(ok, true, "ForkServer::open() loads and warms up the ROM");
+    const std::string inputPath = "test_fork_inputs.bin";
+    writeROM(inputPath, std::vector<uint8_t>(4, 0x00)); // four frames, no buttons
+    std::istringstream in(inputPath + "\n" + inputPath + "\nmissing_inputs.bin\n");
+    std::ostringstream out;
+    server.serve(in, out);
+    std::istringstream replies(out.str());
+    std::string first, second, third;
+    std::getline(replies, first);
+    std::getline(replies, second);
+    std::getline(replies, third);
+    ASSERT_EQ(first.compare(0, 7, "exit 0 "), 0, "Job child exits cleanly");
+    std::istringstream fields(first);
+    std::string word;
+    int code = -1, frames = 0;
+    fields >> word >> code >> frames;
+    ASSERT_EQ(frames, 4, "One hash is reported per input frame");
+    ASSERT_EQ(first == second, true, "Jobs start from the same warmed-up state");
+    ASSERT_EQ(third.compare(0, 8, "exit 2 0"), 0, "Unreadable input is reported by exit status");
+    ASSERT_EQ(out.fill(), ' ', "Replies restore the stream's fill character");
+    ASSERT_EQ((out.flags() & std::ios::basefield) == std::ios::dec, true, "Replies restore the number base");
+#endif
+}
+
+// Test that scheduled instances advance one frame per period and are
+// released again after remove()
+static void test_edf_scheduler() {
+    std::cout << "Running test_edf_scheduler..." << std::endl;
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    GameBoy gbs[3];
+    for (GameBoy& gb : gbs) {
+        gb.loadROM(rom.data(), rom.size());
+    }
+    EdfScheduler scheduler(2, false);
+    std::atomic<int> callbacks(0);
+    int ids[3];
+    auto start = EdfScheduler::Clock::now();
+    for (int i = 0; i < 3; ++i) {
+        ids[i] = scheduler.add(gbs[i], [&callbacks](GameBoy&) { ++callbacks; });
+    }
+    // Wait for a few frames of every instance; the timeout only guards
+    // against a hang on a heavily loaded machine
+    auto timeout = start + std::chrono::seconds(10);
+    bool ran = false;
+    while (!ran && EdfScheduler::Clock::now() < timeout) {
+        std::this_thread::sleep_for(EdfScheduler::framePeriod());
+        ran = true;
+        for (int id : ids) {
+            ran = ran && scheduler.stats(id).framesRun >= 3;
+        }
+    }
+    for (int id : ids) {
+        scheduler.remove(id);
+    }
+    auto elapsed = EdfScheduler::Clock::now() - start;
+    ASSERT_EQ(ran, true, "Every instance runs");
+    // The first frame is released immediately, then one per period
+    uint64_t limit = static_cast<uint64_t>(elapsed / EdfScheduler::framePeriod()) + 1;
+    uint64_t total = 0;
+    bool paced = true;
+    for (int id : ids) {
+        EdfStats stats = scheduler.stats(id);
+        total += stats.framesRun;
+        paced = paced && stats.framesRun <= limit;
+    }
+    ASSERT_EQ(paced, true, "Each instance runs at most one frame per period");
+    ASSERT_EQ(static_cast<uint64_t>(callbacks.load()), total, "Frame callback runs after every frame");
+    uint64_t before = scheduler.stats(ids[0]).framesRun;
+    std::this_thread::sleep_for(EdfScheduler::framePeriod() * 2);
+    ASSERT_EQ(scheduler.stats(ids[0]).framesRun, before, "Removed instances are no longer run");
+}
+
+// Test that pooled instances are handed out per core and recycled by reset
+static void test_instance_pool() {
+    std::cout << "Running test_instance_pool..." << std::endl;
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    InstancePoolConfig config;
+    config.cores = 2;
+    config.instancesPerCore = 2;
+    InstancePool pool;
+    bool ok = pool.open(rom.data(), rom.size(), config);
+    ASSERT_EQ(ok, true, "InstancePool::open() constructs every instance");
+    GameBoy* first = pool.acquire(0);
+    GameBoy* second = pool.acquire(0);
+    ASSERT_EQ(first != nullptr && second != nullptr && first != second, true, "A core hands out distinct instances");
+    ASSERT_EQ(pool.acquire(0) == nullptr, true, "An exhausted core returns nullptr");
+    ASSERT_EQ(pool.available(1), static_cast<size_t>(2), "Other cores keep their own free lists");
+    first->runFrame();
+    first->runFrame();
+    ASSERT_EQ(first->memory().readByte(0xFF80), 2, "Pooled instance runs the ROM");
+    ASSERT_EQ(first->memory().romData_.empty() && second->memory().romData_.empty(), true,
+              "Pooled instances borrow the pool's ROM image");
+    ASSERT_EQ(first->memory().romImage().data() == second->memory().romImage().data(), true,
+              "Every instance reads the same ROM copy");
+    pool.release(first);
+    GameBoy* recycled = pool.acquire(0);
+    ASSERT_EQ(recycled == first, true, "Released instance returns to its home core");
+    ASSERT_EQ(recycled->memory().readByte(0xFF80), 0, "Released instance is reset");
+    pool.release(recycled);
+    pool.release(second);
+}
+
+// Test that exploration grows the archive deterministically
+static void test_explorer() {
+    std::cout << "Running test_explorer..." << std::endl;
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    ExploreConfig config;
+    config.burstsPerGeneration = 4;
+    config.burstFrames = 10;
+    config.maxCellsPerBurst = 8;
+    config.cellAddresses.push_back(0xFF80); // VBlank counter: one new cell per frame
+    Explorer explorer;
+    bool ok = explorer.open(rom.data(), rom.size(), config);
+    ASSERT_EQ(ok, true, "Explorer::open() seeds the archive");
+    ASSERT_EQ(explorer.cellCount(), static_cast<size_t>(1), "Archive starts with the start cell");
+    explorer.runGeneration();
+    ASSERT_EQ(explorer.cellCount(), static_cast<size_t>(9), "Bursts add each new cell once");
+    GameBoy gb;
+    gb.loadROM(rom.data(), rom.size());
+    gb.loadState(explorer.cellState(8), explorer.stateSize());
+    ASSERT_EQ(static_cast<uint64_t>(gb.memory().readByte(0xFF80)), explorer.cell(8).frames,
+              "Cell state matches the frames recorded for it");
+    for (int i = 0; i < 4; ++i) {
+        explorer.runGeneration();
+    }
+    config.numThreads = 2;
+    Explorer threaded;
+    threaded.open(rom.data(), rom.size(), config);
+    for (int i = 0; i < 5; ++i) {
+        threaded.runGeneration();
+    }
+    bool same = threaded.cellCount() == explorer.cellCount();
+    for (size_t i = 0; same && i < explorer.cellCount(); ++i) {
+        same = threaded.cell(i).key == explorer.cell(i).key;
+    }
+    ASSERT_EQ(same, true, "Archive does not depend on the thread count");
+    ASSERT_EQ(explorer.framesRun(), static_cast<uint64_t>(5 * 4 * 10), "Frames run are counted");
+}
+
+// Test that the performance counters track frames and render as text
+static void test_perf_counters() {
+    std::cout << "Running test_perf_counters..." << std::endl;
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    GameBoy gb;
+    gb.loadROM(rom.data(), rom.size());
+    for (int i = 0; i < 3; ++i) {
+        gb.runFrame();
+    }
+    PerfCounters counters = gb.counters();
+    ASSERT_EQ(counters.frames, static_cast<uint64_t>(3), "Frames are counted");
+    ASSERT_EQ(counters.interrupts, static_cast<uint64_t>(3), "One VBlank interrupt per frame is counted");
+    ASSERT_EQ(counters.cycles >= static_cast<uint64_t>(3 * GameBoy::kCyclesPerFrame), true,
+              "Emulated cycles cover every frame");
+    ASSERT_EQ(counters.instructions > 0 && counters.idleSkipCycles > 0, true,
+              "Instructions and skipped halt cycles are counted");
+    gb.memory().writeByte(0xFF46, 0xC0);
+    ASSERT_EQ(gb.counters().dmaTransfers, static_cast<uint64_t>(1), "OAM DMA is counted");
+    std::ostringstream json;
+    writeCountersJson(gb.counters(), json);
+    ASSERT_EQ(json.str().find("\"frames\":3") != std::string::npos, true, "JSON includes the frame count");
+    std::ostringstream prometheus;
+    writeCountersPrometheus(gb.counters(), prometheus, "instance=\"0\"");
+    ASSERT_EQ(prometheus.str().find("gblator_frames_total{instance=\"0\"} 3\n") != std::string::npos, true,
+              "Prometheus text includes labelled counters");
+}
+
+// Host counters are optional: either they measure frames or everything reads zero
+static void test_hw_counters() {
+    std::cout << "Running test_hw_counters..." << std::endl;
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    GameBoy gb;
+    gb.loadROM(rom.data(), rom.size());
+    bool enabled = gb.enableHardwareCounters();
+    for (int i = 0; i < 2; ++i) {
+        gb.runFrame();
+    }
+    PerfCounters counters = gb.counters();
+    ASSERT_EQ(counters.frames, static_cast<uint64_t>(2), "Frames run with or without host counters");
+    if (enabled && gb.hardwareCounters().available(HwEvent::Instructions)) {
+        ASSERT_EQ(counters.hostInstructions > 0, true, "Host instructions are measured");
+        ASSERT_EQ(gb.hardwareCounters().last().emulatedInstructions > 0, true,
+                  "Emulated instructions of the frame are recorded");
+    } else {
+        ASSERT_EQ(counters.hostInstructions + counters.hostCycles, static_cast<uint64_t>(0),
+                  "Unavailable host counters read zero");
+        ASSERT_EQ(counters.hostIpcLastFrame == 0.0, true, "Unavailable host counters give no IPC");
+    }
+    gb.disableHardwareCounters();
+    ASSERT_EQ(gb.hardwareCounters().isOpen(), false, "Host counters can be closed");
+    std::ostringstream json;
+    writeCountersJson(counters, json);
+    ASSERT_EQ(json.str().find("\"branch_misses_per_instruction\":") != std::string::npos, true,
+              "JSON includes the per-instruction ratios");
+}
+
+// Test that recorded zones are exported as Chrome trace events
+static void test_profiler_trace() {
+    std::cout << "Running test_profiler_trace..." << std::endl;
+    clearProfile();
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    GameBoy gb;
+    gb.loadROM(rom.data(), rom.size());
+    gb.runFrame();
+    std::ostringstream frameTrace;
+    writeChromeTrace(frameTrace);
+#if defined(GBLATOR_PROFILE)
+    ASSERT_EQ(frameTrace.str().find("\"name\":\"ppu_line\"") != std::string::npos, true,
+              "Profiling builds record PPU line zones");
+#else
+    ASSERT_EQ(frameTrace.str().find("\"ph\"") == std::string::npos, true,
+              "Zones compile to nothing without GBLATOR_PROFILE");
+#endif
+    clearProfile();
+    profileRecord("test_zone", 5000, 7500);
+    std::ostringstream trace;
+    writeChromeTrace(trace);
+    ASSERT_EQ(trace.str().find("\"name\":\"test_zone\",\"ph\":\"X\"") != std::string::npos, true,
+              "Zone is exported as a complete event");
+    ASSERT_EQ(trace.str().find("\"ts\":5.000,\"dur\":2.500") != std::string::npos, true,
+              "Times are exported in microseconds");
+    clearProfile();
+}
+
+// Test that guest events are recorded with their cycle and filtered
+static void test_guest_trace() {
+    std::cout << "Running test_guest_trace..." << std::endl;
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    GameBoy gb;
+    gb.loadROM(rom.data(), rom.size());
+    GuestTrace trace(256);
+    trace.setMask(guestEventBit(GuestEvent::InterruptRequested) | guestEventBit(GuestEvent::InterruptServiced) |
+                  guestEventBit(GuestEvent::IoWrite));
+    trace.watchRegister(0xFF7F); // never written by this ROM
+    gb.setTrace(&trace);
+    gb.runFrame();
+    gb.runFrame();
+    size_t requests = 0, services = 0;
+    uint64_t requestCycle = 0, serviceCycle = 0;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        const GuestEventRecord& event = trace.at(i);
+        if (event.type == GuestEvent::InterruptRequested && event.value == 0) {
+            ++requests;
+            requestCycle = event.cycle;
+        } else if (event.type == GuestEvent::InterruptServiced && event.value == 0) {
+            ++services;
+            serviceCycle = event.cycle;
+        }
+    }
+    ASSERT_EQ(requests, static_cast<size_t>(2), "VBlank request is traced once per frame");
+    ASSERT_EQ(services, static_cast<size_t>(2), "VBlank service is traced once per frame");
+    // VBlank starts at LY 144 of each frame; the halted CPU services it right away
+    ASSERT_EQ(requestCycle, static_cast<uint64_t>(GameBoy::kCyclesPerFrame + 144 * 114),
+              "Request is stamped with the VBlank cycle despite the idle skip");
+    ASSERT_EQ(serviceCycle, requestCycle, "Service follows the request without delay");
+    ASSERT_EQ(trace.size(), static_cast<size_t>(4), "Filtered kinds are not recorded");
+    std::ostringstream json;
+    trace.writePerfettoJson(json);
+    ASSERT_EQ(json.str().find("\"name\":\"service VBlank\"") != std::string::npos, true,
+              "Timeline exports as trace events");
+    gb.setTrace(nullptr);
+}
+
+// Inputs are followed from the Joypad through a P1 read to a changed frame
+static void test_input_latency() {
+    std::cout << "Running test_input_latency..." << std::endl;
+    // Copy P1 (action buttons selected) into BGP in a loop, so pressing A
+    // changes the shade of every background pixel
+    std::vector<uint8_t> rom(0x8000, 0x00);
+    const uint8_t program[] = {
+        0x3E, 0x20, // LD A,0x20
+        0xE0, 0x00, // LDH (00),A
+        0xF0, 0x00, // LDH A,(00)
+        0xE0, 0x47, // LDH (47),A
+        0x18, 0xF6, // JR -10
+    };
+    std::copy(program, program + sizeof(program), rom.begin() + 0x100);
+    GameBoy gb;
+    gb.loadROM(rom.data(), rom.size());
+    InputLatency probe(64, 2);
+    gb.setLatencyProbe(&probe);
+    for (int i = 0; i < 3; ++i) {
+        gb.runFrame();
+    }
+    gb.joypad().setButtons(1 << Joypad::A);
+    for (int i = 0; i < 3; ++i) {
+        gb.runFrame();
+    }
+    LatencyDistribution read = probe.distribution(LatencyStage::InputToRead);
+    LatencyDistribution frame = probe.distribution(LatencyStage::InputToFrame);
+    ASSERT_EQ(read.samples, static_cast<uint64_t>(1), "The first observing P1 read is recorded");
+    ASSERT_EQ(read.maxFrames > 0.0, true, "The read is the guest's, made after the press");
+    ASSERT_EQ(gb.memory().readByte(0xFF00), 0xEE, "P1 reflects a press made after the group was selected");
+    ASSERT_EQ(probe.distribution(LatencyStage::InputToRead).samples, static_cast<uint64_t>(1),
+              "Host reads of P1 are not observations");
+    ASSERT_EQ(frame.samples, static_cast<uint64_t>(1), "The first changed frame is recorded");
+    ASSERT_EQ(frame.maxFrames > 0.0 && frame.maxFrames <= 2.0, true, "The changed frame follows within two frames");
+    ASSERT_EQ(read.maxFrames <= frame.maxFrames && read.maxUs <= frame.maxUs, true, "The read precedes the frame");
+
+    // A direction is not selected by the guest: never observed, times out
+    gb.joypad().setButtons((1 << Joypad::A) | (1 << Joypad::Right));
+    for (int i = 0; i < 3; ++i) {
+        gb.runFrame();
+    }
+    ASSERT_EQ(probe.inputs(), static_cast<uint64_t>(2), "Every change of the buttons is an input");
+    ASSERT_EQ(probe.timedOut(), static_cast<uint64_t>(1), "An input without visible effect times out");
+    ASSERT_EQ(probe.distribution(LatencyStage::InputToRead).samples, static_cast<uint64_t>(1),
+              "Reads of the other group do not observe the input");
+    std::ostringstream json;
+    probe.writeJson(json);
+    ASSERT_EQ(json.str().find("\"input_to_frame\":{\"samples\":1") != std::string::npos, true,
+              "JSON reports the distributions");
+    gb.setLatencyProbe(nullptr);
+}
+
+// Test that memory access statistics count CPU accesses by region
+static void test_memory_access_stats() {
+    std::cout << "Running test_memory_access_stats..." << std::endl;
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    GameBoy gb;
+    gb.loadROM(rom.data(), rom.size());
+    gb.runFrame();
+    const MemoryAccessStats& stats = gb.memory().accessStats();
+    ASSERT_EQ(accessRegion(0xE123) == AccessRegion::Echo && accessRegion(0xFFFF) == AccessRegion::IE, true,
+              "Addresses decode to their regions");
+#if defined(GBLATOR_MEMORY_STATS)
+    ASSERT_EQ(stats.writes[static_cast<int>(AccessRegion::IE)], static_cast<uint64_t>(1),
+              "The ROM's single IE write is counted");
+    // Interrupt dispatch pushes PC (two bytes below SP=FFFE) and the
+    // handler increments FF80
+    ASSERT_EQ(stats.writes[static_cast<int>(AccessRegion::HRAM)], static_cast<uint64_t>(3),
+              "Stack pushes and the handler's HRAM increment are counted");
+    ASSERT_EQ(stats.ioWrites[0x44], static_cast<uint64_t>(0), "PPU register updates are not counted");
+#else
+    ASSERT_EQ(stats.reads[static_cast<int>(AccessRegion::ROM0)], static_cast<uint64_t>(0),
+              "Accesses are not counted without GBLATOR_MEMORY_STATS");
+#endif
+    std::ostringstream json;
+    writeAccessStatsJson(stats, 1, json);
+    ASSERT_EQ(json.str().find("\"WRAM0\":{\"reads\":") != std::string::npos, true, "Statistics export as JSON");
+}
+
+// Test that the steady-state hot paths perform no heap allocations
+static void test_allocation_audit() {
+    std::cout << "Running test_allocation_audit..." << std::endl;
+    // The audit must see every allocation path, not just plain operator new
+    struct alignas(64) CacheLine {
+        uint8_t bytes[64];
+    };
+    size_t counted = allocationCount.load();
+    CacheLine* volatile line = new CacheLine();
+    delete line;
+    ASSERT_EQ(allocationCount.load() - counted, static_cast<size_t>(1), "Aligned operator new is counted");
+#if defined(GBLATOR_AUDIT_MALLOC)
+    counted = allocationCount.load();
+    void* volatile block = std::malloc(32);
+    std::free(block);
+    void* aligned = nullptr;
+    ASSERT_EQ(posix_memalign(&aligned, 64, 64), 0, "posix_memalign() succeeds");
+    std::free(aligned);
+    ASSERT_EQ(allocationCount.load() - counted, static_cast<size_t>(2), "C allocation functions are counted");
+#endif
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    GameBoy gb;
+    gb.loadROM(rom.data(), rom.size());
+    std::vector<uint8_t> state(gb.stateSize());
+    // Warm-up: first calls may set up lazily created resources
+    gb.runFrame();
+    gb.saveState(state.data(), state.size());
+    gb.loadState(state.data(), state.size());
+
+    size_t before = allocationCount.load();
+    for (int i = 0; i < 5; ++i) {
+        gb.runFrame();
+    }
+    ASSERT_EQ(allocationCount.load() - before, static_cast<size_t>(0), "runFrame() does not allocate");
+    before = allocationCount.load();
+    for (int i = 0; i < 5; ++i) {
+        gb.saveState(state.data(), state.size());
+        gb.loadState(state.data(), state.size());
+    }
+    ASSERT_EQ(allocationCount.load() - before, static_cast<size_t>(0), "Save and load state do not allocate");
+
+    EnvConfig config;
+    config.numEnvs = 4;
+    config.numThreads = 2;
+    config.rewardAddress = 0xFF80;
+    config.maxEpisodeFrames = 3;
+    VectorEnv env;
+    env.open(rom.data(), rom.size(), config);
+    std::vector<uint8_t> actions(4, 0);
+    env.step(actions.data(), actions.size());
+    before = allocationCount.load();
+    uint32_t checksum = 0;
+    for (int i = 0; i < 5; ++i) {
+        env.step(actions.data(), actions.size());
+        checksum += env.observations()[0] + static_cast<uint32_t>(env.rewards()[0]) + env.dones()[0];
+    }
+    ASSERT_EQ(allocationCount.load() - before, static_cast<size_t>(0),
+              "Stepping and extracting observations (with episode resets) does not allocate");
+    (void)checksum;
+}
+
+// Unimplemented opcodes are deduplicated per PC, counted and logged once
+static void test_diagnostics() {
+    std::cout << "Running test_diagnostics..." << std::endl;
+    std::vector<uint8_t> rom(0x8000, 0x00);
+    rom[0x100] = 0xD3;                    // No such opcode
+    rom[0x101] = 0xDD;                    // No such opcode
+    rom[0x102] = 0x18; rom[0x103] = 0xFC; // JR -4
+    GameBoy gb;
+    gb.loadROM(rom.data(), rom.size());
+    DiagnosticChannel& channel = gb.cpu().diagnostics();
+    gb.runFrame();
+    size_t before = allocationCount.load();
+    gb.runFrame();
+    ASSERT_EQ(allocationCount.load() - before, static_cast<size_t>(0), "Reporting unimplemented opcodes does not allocate");
+    ASSERT_EQ(channel.distinct(), static_cast<size_t>(2), "One entry per (opcode, PC)");
+    uint64_t repeats = channel.count(DiagnosticKind::UnimplementedOpcode, 0xD3, 0x100);
+    ASSERT_EQ(repeats > 1000, true, "Repeats are counted");
+    ASSERT_EQ(channel.count(DiagnosticKind::UnimplementedOpcode, 0xDD, 0x101), repeats,
+              "Each opcode is reported at its own address");
+
+    std::ostringstream log;
+    {
+        DiagnosticLogger logger(log, std::chrono::hours(1));
+        logger.attach(channel, "test");
+        logger.flush();
+        ASSERT_EQ(log.str() == "[test] Unimplemented opcode 0xD3 at 0x0100\n"
+                               "[test] Unimplemented opcode 0xDD at 0x0101\n",
+                  true, "First occurrences are logged once");
+    }
+    ASSERT_EQ(log.str().find("0xD3 at 0x0100 repeated") != std::string::npos, true,
+              "Repeat counts are summarised on detach");
+    Diagnostic drained[4];
+    ASSERT_EQ(channel.drain(drained, 4), static_cast<size_t>(0), "The ring is empty after logging");
+}
+
+// Every synthetic ROM is a valid cartridge that runs its workload
+static void test_synthetic_roms() {
+    std::cout << "Running test_synthetic_roms..." << std::endl;
+    for (int i = 0; i < static_cast<int>(SyntheticWorkload::Count); ++i) {
+        SyntheticWorkload workload = static_cast<SyntheticWorkload>(i);
+        std::string name = syntheticWorkloadName(workload);
+        std::vector<uint8_t> rom = makeSyntheticROM(workload);
+        uint8_t headerChecksum = 0;
+        for (size_t j = 0x134; j <= 0x14C; ++j) {
+            headerChecksum = static_cast<uint8_t>(headerChecksum - rom[j] - 1);
+        }
+        ASSERT_EQ(rom[0x14D], headerChecksum, name + " has a valid header checksum");
+        GameBoy gb;
+        ASSERT_EQ(gb.loadROM(rom.data(), rom.size()), true, name + " loads");
+        gb.runFrame();
+        gb.runFrame();
+        ASSERT_EQ(gb.cpu().diagnostics().distinct(), static_cast<size_t>(0), name + " uses only implemented opcodes");
+        ASSERT_EQ(gb.counters().instructions > 0, true, name + " executes its program");
+    }
+    GameBoy gb;
+    std::vector<uint8_t> rom = makeSyntheticROM(SyntheticWorkload::HaltFrames);
+    gb.loadROM(rom.data(), rom.size());
+    gb.runFrame();
+    gb.runFrame();
+    ASSERT_EQ(gb.memory().readByte(0xFF80), 2, "halt_frames counts one VBlank per frame");
+    ASSERT_EQ(gb.idleCycles() > static_cast<uint64_t>(GameBoy::kCyclesPerFrame), true, "halt_frames mostly idles");
+    rom = makeSyntheticROM(SyntheticWorkload::BankSwitchStorm);
+    gb.loadROM(rom.data(), rom.size());
+    gb.runFrame();
+    ASSERT_EQ(gb.counters().bankSwitches > 1000, true, "bank_switch_storm switches banks");
+    rom = makeSyntheticROM(SyntheticWorkload::VramUpload);
+    gb.loadROM(rom.data(), rom.size());
+    gb.runFrame();
+    gb.runFrame();
+    ASSERT_EQ(gb.memory().readByte(0x8001), rom[0x1001], "vram_upload copies tiles to VRAM");
+    ASSERT_EQ(gb.memory().readByte(0xFF80) > 0, true, "vram_upload counts frames");
+}
+
+// Known answers for the percentile and Mann-Whitney regression gate
+static void test_sample_stats() {
+    std::cout << "Running test_sample_stats..." << std::endl;
+    auto near = [](double a, double b) { return std::fabs(a - b) < 1e-6; };
+    std::vector<double> sorted = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    ASSERT_EQ(near(nearestRankPercentile(sorted, 0.5), 5), true, "The median of ten is the fifth value");
+    ASSERT_EQ(near(nearestRankPercentile(sorted, 0.95), 10), true, "p95 of ten is the largest value");
+    ASSERT_EQ(near(nearestRankPercentile(sorted, 0.0), 1), true, "p0 is the smallest value");
+    ASSERT_EQ(near(nearestRankPercentile({7}, 0.99), 7), true, "A single sample is every percentile");
+
+    std::vector<double> low = {1, 2, 3, 4, 5, 6, 7, 8};
+    std::vector<double> high = {11, 12, 13, 14, 15, 16, 17, 18};
+    ASSERT_EQ(near(slowerPValue(low, low), 0.5210632), true, "Identical samples are not significant");
+    ASSERT_EQ(near(slowerPValue(std::vector<double>(8, 5.0), std::vector<double>(8, 5.0)), 1.0), true,
+              "All-tied samples give p = 1");
+    ASSERT_EQ(near(slowerPValue(low, high), 0.0004696), true, "Fully separated samples are significant");
+    ASSERT_EQ(near(slowerPValue(high, low), 0.9996790), true, "The test is one-sided");
+    ASSERT_EQ(near(slowerPValue({1, 2, 2, 3}, {2, 3, 3, 4}), 0.0860169), true, "Ties are corrected for");
+    ASSERT_EQ(near(slowerPValue({1}, {2}), 0.5), true, "One sample each is never significant");
+    ASSERT_EQ(near(slowerPValue({1, 2, 3}, {4, 5, 6}), 0.0404278), true, "Three samples each");
+    ASSERT_EQ(near(slowerPValue({}, {1, 2}), 1.0), true, "An empty side gives p = 1");
+
+    SampleComparison c = compareSamples(low, high, 5.0, 0.01);
+    ASSERT_EQ(c.verdict == SampleVerdict::Regression, true, "A significant slowdown is a regression");
+    ASSERT_EQ(near(c.baselineMedian, 4) && near(c.currentMedian, 14), true, "Medians are nearest-rank");
+    ASSERT_EQ(near(c.changePercent, 250), true, "The change is relative to the baseline median");
+    ASSERT_EQ(compareSamples(high, low, 5.0, 0.01).verdict == SampleVerdict::Improved, true,
+              "A significant speedup is an improvement");
+    ASSERT_EQ(compareSamples(low, low, 5.0, 0.01).verdict == SampleVerdict::Unchanged, true,
+              "Identical samples are unchanged");
+    ASSERT_EQ(compareSamples({1, 2, 3}, {4, 5, 6}, 5.0, 0.01).verdict == SampleVerdict::Noise, true,
+              "A large change with too few samples is noise");
+}
+
 int main() {
     test_ld_immediate();
     test_add_instruction();
+    test_cb_instructions();
     test_timer();
     test_ppu();
     test_memory_bank_switch();
+    test_rom_loading();
+    test_engine_select();
     test_joypad();
+    test_serial_link();
+    test_link_session();
+    test_halt_idle_skip();
+    test_cycle_scheduler();
+    test_ppu_framebuffer();
+    test_save_state_roundtrip();
+    test_state_diff();
+    test_c_api();
+    test_vector_env();
+    test_env_server();
+    test_fork_server();
+    test_edf_scheduler();
+    test_instance_pool();
+    test_explorer();
+    test_perf_counters();
+    test_hw_counters();
+    test_profiler_trace();
+    test_guest_trace();
+    test_input_latency();
+    test_memory_access_stats();
+    test_allocation_audit();
+    test_diagnostics();
+    test_synthetic_roms();
+    test_sample_stats();
     std::cout << testsPassed << " tests passed, " << testsFailed << " tests failed." << std::endl;
     return testsFailed;
 }
\ No newline at end of file